@@ -1,14 +1,18 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace defgen
 {
 
-/// MSVC COFF `.obj` or GNU-style ELF relocatable (`.o`). `Auto` picks by file extension: `.o` -> ELF, otherwise COFF.
+/// MSVC COFF `.obj` / `.lib` or GNU-style ELF relocatable `.o` / `.a` (`.lib` and `.a` are read as archives). `Auto`
+/// picks by file extension: `.o` and `.a` -> ELF, otherwise COFF.
 enum class ObjectFormat
 {
     Auto,
@@ -16,6 +20,18 @@ enum class ObjectFormat
     Elf
 };
 
+/// How object bytes are brought into memory before parsing.
+enum class LoadMode
+{
+    /// Map the whole file; only the pages the parser touches are faulted in.
+    Mapped,
+    /// Positioned reads of just the headers, section table, symbol table and string table; section payload is never read.
+    Ranged,
+    /// Linux io_uring: hundreds of whole-file open/statx/read operations in flight, parsed as they complete.
+    /// Falls back to `Mapped` when io_uring is unavailable (other platforms, old kernels, seccomp).
+    Batched
+};
+
 struct GenerateOptions
 {
     /// Substrings; if any match an export name, that name is omitted (same idea as legacy `DefBuildIgnores.txt` lines).
@@ -26,6 +42,41 @@ struct GenerateOptions
     std::string library_basename;
     /// First line of the file, e.g. `;ObjectCount=42` or `//ObjectCount=42`, for incremental rebuild fingerprints.
     std::optional<std::string> object_count_line;
+    /// Append ` ExportHash=<32 hex digits>` to the first line (or emit `;ExportHash=` / `//ExportHash=` as the first line
+    /// when there is no `object_count_line`): a 128-bit hash of every line after it. Whether an existing export file is
+    /// current can then be decided from its first line alone; see `ExportCompare`.
+    bool export_hash_in_header = false;
+    /// Ordinal database (empty = export by name). With a `.def` output every export is written as `name @N NONAME`:
+    /// the DLL gets no name table entry for it and importers bind by ordinal. Each name keeps the ordinal it was first
+    /// given; new names get the next free ordinals and the database is rewritten (temp file + rename). Ordinals of
+    /// names that disappear stay reserved, so more than 65535 exports over the database's lifetime fail with
+    /// `Errc::InvalidArgument`. Not used for EMD output.
+    std::filesystem::path ordinal_database;
+    /// Exact names that keep their export name in ordinal mode (`name @N`), e.g. for `GetProcAddress` by name.
+    std::vector<std::string> named_exports;
+    LoadMode load_mode = LoadMode::Mapped;
+    /// Files kept in flight by `LoadMode::Batched`.
+    unsigned io_queue_depth = 256;
+    /// Parser threads for `Mapped` / `Ranged` loading (0 = hardware concurrency). Output and the reported first failing
+    /// object are identical for every thread count.
+    unsigned thread_count = 1;
+    /// Per-object symbol cache file (empty = no cache). Objects whose path, size and mtime match an entry are served from
+    /// it without being opened; when only size/mtime differ, an unchanged XXH64 of the ranges the last parse fetched
+    /// (headers, section, symbol and string tables) still avoids the parse, and reads no more than the parse would.
+    /// Rewritten (temp file + rename) after a successful run that changed it; a cache that cannot be written is ignored.
+    std::filesystem::path symbol_cache_path;
+    /// Read `<object>.sym` (see `extract_symbol_sidecar`) instead of the object when the sidecar's recorded size and
+    /// mtime still match the object; its sorted names are merged without interning or sorting. Objects without a
+    /// current sidecar are loaded as usual.
+    bool use_symbol_sidecars = false;
+    /// Content-addressed symbol store shared between machines (empty = none), e.g. a network share used by a build farm.
+    /// Objects the local cache cannot serve are looked up by their first and last bytes and confirmed by hashing the
+    /// ranges the entry's parse fetched; parsed objects are published to it. Entries are written with temp file + rename
+    /// and never modified in place, so no locking is needed.
+    std::filesystem::path shared_cache_dir;
+    /// Size bound of the shared store (0 = unbounded). After publishing, the least recently used entries of the touched
+    /// subdirectories are evicted; see `trim_shared_symbol_cache` for a full pass.
+    std::uint64_t shared_cache_max_bytes = 0;
 };
 
 struct GenerateOutput
@@ -33,11 +84,61 @@ struct GenerateOutput
     std::vector<std::string> lines;
 };
 
+/// How the symbol cache served an object.
+enum class CacheOutcome
+{
+    /// No cache configured.
+    None,
+    /// Path, size and mtime matched: the object was not opened.
+    Hit,
+    /// Size or mtime changed but the headers and tables the last parse fetched hash the same: those were read, not parsed.
+    ContentHit,
+    /// Not in the local cache, but found in the shared store and its fetched ranges hash the same: read, not parsed.
+    SharedHit,
+    /// Parsed (and the ranges it fetched hashed for the next run).
+    Miss
+};
+
+struct ObjectStats
+{
+    std::uint64_t file_size = 0;
+    /// Bytes the loader fetched for this object (with `LoadMode::Ranged`, actual I/O volume).
+    std::uint64_t bytes_read = 0;
+    CacheOutcome cache = CacheOutcome::None;
+    /// Served from its `.sym` sidecar (the object itself was only stat'ed).
+    bool sidecar = false;
+};
+
+struct GenerateStats
+{
+    /// One entry per input object, in `object_files` order.
+    std::vector<ObjectStats> objects;
+    std::uint64_t total_file_size = 0;
+    std::uint64_t total_bytes_read = 0;
+    /// Loader that actually ran (`Batched` reports `Mapped` after a fallback).
+    LoadMode load_mode = LoadMode::Mapped;
+    std::size_t cache_hits = 0;
+    std::size_t cache_content_hits = 0;
+    std::size_t cache_misses = 0;
+    std::size_t sidecar_hits = 0;
+    std::size_t shared_cache_hits = 0;
+    /// Entries this run published to (and evicted from) the shared store.
+    std::size_t shared_cache_writes = 0;
+    std::size_t shared_cache_evictions = 0;
+    /// True when this run rewrote the symbol cache; `cache_error` says why a needed rewrite failed (the result is still valid).
+    bool cache_written = false;
+    std::string cache_error;
+    /// Exports given an ordinal for the first time (ordinal mode; the database was rewritten when non-zero).
+    std::size_t ordinals_added = 0;
+};
+
 enum class Errc
 {
     Ok = 0,
     Io = 1,
-    Parse = 2
+    Parse = 2,
+    /// A request that does not fit the current state (e.g. adding an object twice).
+    InvalidArgument = 3
 };
 
 struct GenerateResult
@@ -45,14 +146,328 @@ struct GenerateResult
     Errc ec = Errc::Ok;
     std::string message;
     GenerateOutput out;
+    GenerateStats stats;
+};
+
+/// Receives generated export text one line at a time (without the newline), in file order.
+class ExportSink
+{
+  public:
+    virtual ~ExportSink() = default;
+    virtual void line(std::string_view text) = 0;
+};
+
+/// How an existing export file is found equal to new text.
+enum class ExportCompare
+{
+    /// When the new first line carries an export hash (`GenerateOptions::export_hash_in_header`), only the first line of
+    /// the existing file is read: equal header, equal file. Otherwise as `Full`.
+    Header,
+    /// Byte-for-byte compare of the whole file (verify mode).
+    Full
+};
+
+/// Streams export text to `path` through one large buffer, without holding the lines. The text goes to a uniquely named
+/// temporary file next to `path` that `commit` renames into place, so readers never see a partial file. While the text
+/// equals the existing file it is only compared, not written: an unchanged file keeps its bytes and timestamp.
+class ExportFileWriter final : public ExportSink
+{
+  public:
+    explicit ExportFileWriter(std::filesystem::path path, ExportCompare compare = ExportCompare::Header,
+                              std::size_t buffer_size = std::size_t{1} << 20);
+    /// Removes the temporary file unless `commit` succeeded.
+    ~ExportFileWriter() override;
+    ExportFileWriter(const ExportFileWriter&) = delete;
+    ExportFileWriter& operator=(const ExportFileWriter&) = delete;
+
+    void line(std::string_view text) override;
+
+    /// Flush and replace `path`. `unchanged` is true when the text equals the existing file (nothing was written). False
+    /// with `err` if writing or renaming failed; `path` is then untouched.
+    [[nodiscard]] bool commit(bool& unchanged, std::string& err);
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
 };
 
 /// Read object files, collect public symbols, and build `.def` (or ELF-style export block) lines.
 [[nodiscard]] GenerateResult generate_def(const std::vector<std::filesystem::path>& object_files, ObjectFormat format,
                                           const GenerateOptions& options = {});
 
-/// Line-by-line compare with an existing file; avoids rewriting when identical.
-[[nodiscard]] bool def_file_matches(const std::filesystem::path& def_path, const std::vector<std::string>& new_lines);
+/// Same as above, but the text is streamed into `sink` instead of `GenerateResult::out` (left empty). Nothing reaches
+/// the sink when loading fails.
+[[nodiscard]] GenerateResult generate_def(const std::vector<std::filesystem::path>& object_files, ObjectFormat format,
+                                          const GenerateOptions& options, ExportSink& sink);
+
+/// Target of the export object and import library built from a `.def` (`write_export_object`, `write_import_library`).
+struct ExportObjectOptions
+{
+    /// `IMAGE_FILE_MACHINE_AMD64` (0x8664) or `IMAGE_FILE_MACHINE_I386` (0x14c).
+    std::uint16_t machine = 0x8664;
+    /// File name of the DLL (e.g. `engine.dll`), recorded in the export directory.
+    std::string dll_name;
+};
+
+/// Write the COFF export object (`.exp`) `link.exe` would build from the `.def` at `def_path`; an up-to-date one is left
+/// alone (`unchanged`). `Errc::Parse` for an entry it cannot express, `Errc::InvalidArgument` for another machine.
+[[nodiscard]] Errc write_export_object(const std::filesystem::path& def_path, const std::filesystem::path& exp_path,
+                                       const ExportObjectOptions& options, bool& unchanged, std::string& message);
+
+/// Write the import library `lib.exe /DEF:` would build from the `.def` at `def_path`, so importers can link before the
+/// DLL does; an up-to-date one is left alone (`unchanged`). Same errors as `write_export_object`.
+[[nodiscard]] Errc write_import_library(const std::filesystem::path& def_path, const std::filesystem::path& lib_path,
+                                        const ExportObjectOptions& options, bool& unchanged, std::string& message);
+
+/// What the linker takes from the COFF inputs themselves rather than from its command line.
+struct CoffLinkInputs
+{
+    /// Machine (`IMAGE_FILE_MACHINE_*`) of the first input that is a COFF object (or archive member); 0 if none is.
+    std::uint16_t machine = 0;
+    /// Some object's `.drectve` section passes `/EXPORT:`: the linker exports (and imports by) names the `.def` may
+    /// not list, or lists without their `DATA` type.
+    bool export_directives = false;
+};
+
+/// Read `CoffLinkInputs` from the file headers of `object_files`, and with `read_directives` also from every object's
+/// `.drectve` section (each section table is then read). Unreadable files are skipped.
+[[nodiscard]] CoffLinkInputs inspect_coff_inputs(const std::vector<std::filesystem::path>& object_files, bool read_directives);
+
+/// Target of the ELF interface stub built from an EMD file (`write_elf_stub`).
+struct ElfStubOptions
+{
+    /// `EM_X86_64` (62), `EM_AARCH64` (183), `EM_386` (3) or `EM_ARM` (40); little-endian.
+    std::uint16_t machine = 62;
+    /// `DT_SONAME` (empty = none); give the real module the same one.
+    std::string soname;
+};
+
+/// Write a link-only ELF shared object exporting the functions listed in the EMD at `emd_path`; an up-to-date one is left
+/// alone (`unchanged`). `Errc::Parse` for a bad or duplicate entry, `Errc::InvalidArgument` for another machine.
+[[nodiscard]] Errc write_elf_stub(const std::filesystem::path& emd_path, const std::filesystem::path& stub_path,
+                                  const ElfStubOptions& options, bool& unchanged, std::string& message);
+
+/// Running totals of an interface fingerprint, kept in `<fingerprint>.stats`.
+struct FingerprintStats
+{
+    /// Runs that found the interface as it was: each one spared every module linked against this one a relink.
+    std::uint64_t relinks_avoided = 0;
+    /// Runs that wrote a new fingerprint (including the first).
+    std::uint64_t updates = 0;
+};
+
+/// Write a hash of the exports in `export_path` (a `.def`, or an EMD for `ObjectFormat::Elf`) and `target` to
+/// `fingerprint_path`, rewriting it only when the hash changes (`unchanged`); `stats` receives the running totals.
+[[nodiscard]] Errc write_interface_fingerprint(const std::filesystem::path& export_path, ObjectFormat format,
+                                               const std::filesystem::path& fingerprint_path, std::string_view target, bool& unchanged,
+                                               FingerprintStats& stats, std::string& message);
+
+struct SharedCacheStats
+{
+    std::size_t entries = 0;
+    std::uint64_t bytes = 0;
+    std::size_t evicted = 0;
+    std::uint64_t evicted_bytes = 0;
+};
+
+/// Report the size of the shared symbol store at `dir` and, with `max_bytes != 0`, evict least recently used entries
+/// (and temporary files abandoned by crashed writers) until it fits. Safe while other processes use the store.
+[[nodiscard]] bool trim_shared_symbol_cache(const std::filesystem::path& dir, std::uint64_t max_bytes, SharedCacheStats& out,
+                                            std::string& err);
+
+/// Parse `object` and write its function and data names, sorted, to the sidecar `sidecar` (empty = `<object>.sym`),
+/// along with the object's size and mtime. Meant to run right after each compile, so that `generate_def` with
+/// `use_symbol_sidecars` merges small pre-sorted files instead of opening objects. `Errc::Parse` if the object cannot be
+/// read or parsed, `Errc::Io` if it changed meanwhile or the sidecar cannot be written.
+[[nodiscard]] Errc extract_symbol_sidecar(const std::filesystem::path& object, ObjectFormat format, const std::filesystem::path& sidecar,
+                                          std::string& message);
+
+/// Export set updated one object at a time; `snapshot` equals `generate_def` over the current objects. Not thread-safe.
+class ExportSetBuilder
+{
+  public:
+    /// Only the output-shaping options and `load_mode` are used (snapshots export by name).
+    explicit ExportSetBuilder(ObjectFormat format = ObjectFormat::Auto, GenerateOptions options = {});
+    ~ExportSetBuilder();
+
+    ExportSetBuilder(ExportSetBuilder&&) noexcept;
+    ExportSetBuilder& operator=(ExportSetBuilder&&) noexcept;
+    ExportSetBuilder(const ExportSetBuilder&) = delete;
+    ExportSetBuilder& operator=(const ExportSetBuilder&) = delete;
+
+    /// `Errc::InvalidArgument` if `path` is already in the set, `Errc::Parse` if it cannot be parsed (set unchanged).
+    [[nodiscard]] Errc add_object(const std::filesystem::path& path, std::string& message);
+    /// Re-parse `path` and apply the difference to its previous symbols (adds it if it is not in the set yet).
+    [[nodiscard]] Errc update_object(const std::filesystem::path& path, std::string& message);
+    /// Drop `path` and every symbol only it contributed. False if it was not in the set.
+    bool remove_object(const std::filesystem::path& path);
+
+    [[nodiscard]] bool contains(const std::filesystem::path& path) const;
+    [[nodiscard]] std::size_t object_count() const;
+    /// Exported (non-ignored) function names currently in the set.
+    [[nodiscard]] std::size_t export_count() const;
+
+    /// Replace `options.object_count_line` for later snapshots (e.g. to track the current object count).
+    void set_object_count_line(std::optional<std::string> line);
+
+    [[nodiscard]] GenerateOutput snapshot() const;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+struct WatchOptions
+{
+    /// Directories to watch recursively, spelled the way the link names its objects.
+    std::vector<std::filesystem::path> directories;
+    /// Export file to keep current; `<output>.manifest` is written next to it, in the proxy's format.
+    std::filesystem::path output;
+    /// `Coff` watches `.obj`, `Elf` watches `.o`, `Auto` both.
+    ObjectFormat format = ObjectFormat::Coff;
+    /// `object_count_line` and the ordinal options are ignored (the output exports by name).
+    GenerateOptions options;
+    /// When non-empty, the first line is this prefix followed by the current object count (`;ObjectCount=`).
+    std::string object_count_prefix;
+    /// Quiet time after a writer closes an object before it is parsed.
+    unsigned debounce_ms = 100;
+};
+
+struct WatchStats
+{
+    std::size_t objects = 0;
+    std::size_t exports = 0;
+    std::size_t parses = 0;
+    /// Objects that were rewritten with identical content (same XXH64) and therefore not parsed again.
+    std::size_t unchanged = 0;
+    std::size_t parse_failures = 0;
+    std::size_t outputs_written = 0;
+    /// Most recent parse failure; the object keeps its previous symbols until it is written again.
+    std::string last_error;
+};
+
+/// Keeps an export file and its input manifest current while a build writes objects (Linux inotify).
+class ExportWatcher
+{
+  public:
+    explicit ExportWatcher(WatchOptions options);
+    ~ExportWatcher();
+    ExportWatcher(const ExportWatcher&) = delete;
+    ExportWatcher& operator=(const ExportWatcher&) = delete;
+
+    /// Start watching, parse every object already present and write the output if it differs.
+    [[nodiscard]] bool start(std::string& err);
+    /// Wait up to `timeout_ms` for events and rewrite the output if settled objects changed it. False on a fatal error.
+    [[nodiscard]] bool poll(int timeout_ms, std::string& err);
+
+    [[nodiscard]] const WatchStats& stats() const;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+/// One input object as recorded in an input manifest.
+struct ManifestEntry
+{
+    /// Generic UTF-8 spelling of the path, as passed in.
+    std::string path;
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    /// XXH64 of the whole file.
+    std::uint64_t content_hash = 0;
+};
+
+/// Sidecar record of what an export file was generated from: a fingerprint of the settings that shape the output and
+/// the sorted, de-duplicated set of input objects with their size, mtime and content hash.
+struct InputManifest
+{
+    std::uint64_t settings_hash = 0;
+    std::vector<ManifestEntry> entries;
+};
+
+struct ManifestCheck
+{
+    /// Same settings, same input set, same content: the export file does not need to be regenerated.
+    bool unchanged = false;
+    /// `current` differs from the file on disk (new inputs, or objects that were touched without changing), so it
+    /// should be written back even when `unchanged` is true.
+    bool stale = false;
+    /// First difference found, for logging (empty when unchanged).
+    std::string reason;
+    /// Manifest describing the inputs as they are now; write it after a successful regeneration.
+    InputManifest current;
+};
+
+/// Fingerprint of everything besides the objects that affects `generate_def` output for these options.
+[[nodiscard]] std::uint64_t manifest_settings_hash(ObjectFormat format, const GenerateOptions& options);
+
+/// Compare `object_files` with the manifest at `manifest_path` in one pass. Objects whose size and mtime match their
+/// entry are not opened; the others are hashed, so a touched but identical object does not count as a change while a
+/// swapped object with the same count does. A missing or unreadable manifest is reported as changed.
+[[nodiscard]] ManifestCheck check_input_manifest(const std::filesystem::path& manifest_path,
+                                                 const std::vector<std::filesystem::path>& object_files, std::uint64_t settings_hash);
+
+/// Write `manifest` to `manifest_path` (temporary file + rename).
+[[nodiscard]] bool write_input_manifest(const std::filesystem::path& manifest_path, const InputManifest& manifest, std::string& err);
+
+/// Resident export server (`defgend`): keeps each object's function names in memory between requests, keyed by path,
+/// size and mtime, and evicts least recently used objects beyond `memory_budget`. Serves one client at a time.
+struct DaemonOptions
+{
+    /// Unix domain socket path, or named pipe name on Windows (empty = `default_daemon_endpoint()`).
+    std::filesystem::path endpoint;
+    /// Approximate bytes of resident symbol data to keep.
+    std::uint64_t memory_budget = std::uint64_t{1} << 30;
+    /// Parser threads for objects that are not resident (0 = hardware concurrency).
+    unsigned thread_count = 0;
+};
+
+struct DaemonStats
+{
+    std::size_t resident_objects = 0;
+    std::uint64_t resident_bytes = 0;
+    std::uint64_t memory_budget = 0;
+    std::size_t evictions = 0;
+    /// Generate requests served since start.
+    std::size_t requests = 0;
+};
+
+struct DaemonResult
+{
+    /// `Errc::Io` when no daemon answered (the caller should fall back to `generate_def`).
+    Errc ec = Errc::Ok;
+    std::string message;
+    /// The output equals `current_output`; `out` is left empty.
+    bool unchanged = false;
+    GenerateOutput out;
+    /// Objects served from memory vs. parsed for this request.
+    std::size_t objects_resident = 0;
+    std::size_t objects_parsed = 0;
+};
+
+/// `$XDG_RUNTIME_DIR/defgen.sock` (else `/tmp/defgen-<uid>.sock`); `\\.\pipe\defgen-<user>` on Windows.
+[[nodiscard]] std::filesystem::path default_daemon_endpoint();
+
+/// Listen on `options.endpoint` and serve requests until a client asks the daemon to stop. False (with `err`) if the
+/// endpoint cannot be opened, e.g. because another daemon already listens on it.
+[[nodiscard]] bool run_daemon(const DaemonOptions& options, std::string& err);
+
+/// Ask the daemon at `endpoint` for the `generate_def` output of `object_files`. Only the output-shaping fields of
+/// `options` are used. When `current_output` names an existing export file whose lines equal the result, the daemon
+/// answers `unchanged` without sending the lines.
+[[nodiscard]] DaemonResult query_daemon(const std::filesystem::path& endpoint, const std::vector<std::filesystem::path>& object_files,
+                                        ObjectFormat format, const GenerateOptions& options,
+                                        const std::filesystem::path& current_output = {});
+
+[[nodiscard]] bool query_daemon_stats(const std::filesystem::path& endpoint, DaemonStats& out, std::string& err);
+
+[[nodiscard]] bool stop_daemon(const std::filesystem::path& endpoint, std::string& err);
+
+/// Line-by-line compare with an existing file; avoids rewriting when identical. When the first new line carries an export
+/// hash, only the first line of the file is compared unless `compare` is `ExportCompare::Full`.
+[[nodiscard]] bool def_file_matches(const std::filesystem::path& def_path, const std::vector<std::string>& new_lines,
+                                    ExportCompare compare = ExportCompare::Header);
 
 /// True if the first line of `def_path` equals `expected` (after opening the file).
 [[nodiscard]] bool def_first_line_is(const std::filesystem::path& def_path, std::string_view expected);
@@ -0,0 +1,1220 @@
+// SPDX-License-Identifier: MIT
+// defgen benchmarks, one mode per optimization. Runs anywhere; ELF objects and `.a` archives work as inputs too.
+//   edata (default)  export list by name and by stable ordinal (NONAME): size of the PE export table (.edata) each
+//                    would produce, generation time, and whether ordinals survive a relink with one object less.
+//   loaders          generate_def with each LoadMode, with the inputs evicted from the page cache and warm.
+//   kernels          each compiled is_identifier kernel against the original std::isalnum loop, by name length.
+//   sort             sort_names against std::sort on synthetic MSVC-mangled names.
+//   daemon           defgend request latency over a large synthetic object set, cold and with nothing changed.
+//   lib              a multi-hundred-MB synthetic .lib read through its linker member index, walked, and extracted.
+//   archives         GNU `.a` archives, by default every one in the system library directories.
+
+#include "defgen/defgen.hpp"
+#include "ar_archive.hpp"
+#include "coff_writer.hpp"
+#include "name_kernels.hpp"
+#include "name_sort.hpp"
+#include "symbol_pool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+namespace ar = defgen::detail::ar;
+
+namespace
+{
+
+void print_usage()
+{
+    std::printf("usage:\n"
+                "  defgen-bench [edata] [--elf] [--named <names.txt>] [--dll <name.dll>] <objects>...\n"
+                "  defgen-bench loaders [--elf] [--threads <n>] [--repeat <n>] <objects>...\n"
+                "  defgen-bench kernels [<names.txt>]\n"
+                "  defgen-bench sort [--count <n>] [--threads <n>]\n"
+                "  defgen-bench daemon [--objects <n>] [--repeat <n>]\n"
+                "  defgen-bench lib [--members <n>] [--code-kib <n>] [--repeat <n>]\n"
+                "  defgen-bench archives [--repeat <n>] [<archives>...]\n");
+}
+
+[[nodiscard]] double ms_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Evict `files` from the page cache so the next load reads them from the disk. Linux only (`posix_fadvise`); false
+/// elsewhere, where "cold" runs are as warm as the others.
+bool drop_cached(const std::vector<fs::path>& files)
+{
+#if defined(__linux__)
+    for (const fs::path& file : files)
+    {
+        const int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            // Dirty pages are not dropped, so a freshly written input is flushed first.
+            ::fdatasync(fd);
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+    }
+    return true;
+#else
+    (void)files;
+    return false;
+#endif
+}
+
+/// Sizes of the export data `link.exe` would lay out for a `.def`.
+struct EdataSize
+{
+    std::size_t exports = 0;
+    std::size_t named = 0;
+    /// IMAGE_EXPORT_DIRECTORY, export address table, name pointer table, ordinal table, name strings, DLL name.
+    std::uint64_t directory = 0;
+    std::uint64_t address_table = 0;
+    std::uint64_t name_pointers = 0;
+    std::uint64_t name_ordinals = 0;
+    std::uint64_t name_strings = 0;
+    std::uint64_t dll_name = 0;
+
+    [[nodiscard]] std::uint64_t total() const
+    {
+        return directory + address_table + name_pointers + name_ordinals + name_strings + dll_name;
+    }
+};
+
+/// Lay out `.edata` for the `EXPORTS` lines of a `.def` (`name`, `name @N` or `name @N NONAME`). Exports without an
+/// ordinal are numbered after the highest explicit one, as the linker does.
+[[nodiscard]] EdataSize measure_edata(const std::vector<std::string>& lines, std::string_view dll)
+{
+    EdataSize size;
+    std::uint32_t lowest = 0xFFFF;
+    std::uint32_t highest = 0;
+    std::size_t implicit = 0;
+    bool body = false;
+    for (const std::string& line : lines)
+    {
+        if (!body)
+        {
+            body = line == "EXPORTS";
+            continue;
+        }
+        const std::size_t at = line.find(" @");
+        const std::string_view name = std::string_view(line).substr(0, at);
+        size.exports++;
+        if (at == std::string::npos)
+        {
+            implicit++;
+        }
+        else
+        {
+            const auto ordinal = static_cast<std::uint32_t>(std::strtoul(line.c_str() + at + 2, nullptr, 10));
+            lowest = std::min(lowest, ordinal);
+            highest = std::max(highest, ordinal);
+        }
+        if (line.find(" NONAME") == std::string::npos)
+        {
+            size.named++;
+            size.name_strings += name.size() + 1;
+        }
+    }
+    if (highest == 0)
+    {
+        lowest = 1;
+    }
+    const std::uint64_t slots = highest == 0 ? implicit : highest - lowest + 1 + implicit;
+    size.directory = 40;
+    size.address_table = 4 * slots;
+    size.name_pointers = 4 * size.named;
+    size.name_ordinals = 2 * size.named;
+    size.dll_name = dll.size() + 1;
+    return size;
+}
+
+void print_edata(const char* title, const EdataSize& s)
+{
+    std::printf("%-22s %8zu exports, %8zu named: %10llu bytes (EAT %llu, name pointers %llu, ordinals %llu, strings %llu)\n", title,
+                s.exports, s.named, static_cast<unsigned long long>(s.total()), static_cast<unsigned long long>(s.address_table),
+                static_cast<unsigned long long>(s.name_pointers), static_cast<unsigned long long>(s.name_ordinals),
+                static_cast<unsigned long long>(s.name_strings));
+}
+
+/// `name -> ordinal` of the `name @N ...` lines.
+[[nodiscard]] std::unordered_map<std::string, std::uint32_t> ordinal_map(const std::vector<std::string>& lines)
+{
+    std::unordered_map<std::string, std::uint32_t> out;
+    for (const std::string& line : lines)
+    {
+        const std::size_t at = line.find(" @");
+        if (at != std::string::npos)
+        {
+            out.emplace(line.substr(0, at), static_cast<std::uint32_t>(std::strtoul(line.c_str() + at + 2, nullptr, 10)));
+        }
+    }
+    return out;
+}
+
+[[nodiscard]] bool run(const std::vector<fs::path>& objects, defgen::ObjectFormat format, const defgen::GenerateOptions& options,
+                       std::vector<std::string>& lines, double& ms, std::size_t* added = nullptr)
+{
+    const auto start = std::chrono::steady_clock::now();
+    defgen::GenerateResult gr = defgen::generate_def(objects, format, options);
+    ms = ms_since(start);
+    if (gr.ec != defgen::Errc::Ok)
+    {
+        std::printf("defgen-bench: %s\n", gr.message.c_str());
+        return false;
+    }
+    lines = std::move(gr.out.lines);
+    if (added != nullptr)
+    {
+        *added = gr.stats.ordinals_added;
+    }
+    return true;
+}
+
+int bench_edata(int argc, char* argv[])
+{
+    defgen::ObjectFormat format = defgen::ObjectFormat::Auto;
+    fs::path named_list;
+    std::string dll = "module.dll";
+    std::vector<fs::path> objects;
+    for (int i = 0; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--elf") == 0)
+        {
+            format = defgen::ObjectFormat::Elf;
+        }
+        else if (std::strcmp(arg, "--named") == 0 && i + 1 < argc)
+        {
+            named_list = argv[++i];
+        }
+        else if (std::strcmp(arg, "--dll") == 0 && i + 1 < argc)
+        {
+            dll = argv[++i];
+        }
+        else if (arg[0] == '-')
+        {
+            print_usage();
+            return 2;
+        }
+        else
+        {
+            objects.emplace_back(arg);
+        }
+    }
+    if (objects.empty())
+    {
+        print_usage();
+        return 2;
+    }
+
+    defgen::GenerateOptions by_name;
+    defgen::GenerateOptions by_ordinal;
+    std::error_code ec;
+    by_ordinal.ordinal_database = fs::temp_directory_path(ec) / "defgen-bench.ordinals";
+    fs::remove(by_ordinal.ordinal_database, ec);
+    std::ifstream named(named_list);
+    std::string line;
+    while (!named_list.empty() && std::getline(named, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            by_ordinal.named_exports.push_back(line);
+        }
+    }
+
+    std::vector<std::string> name_lines;
+    std::vector<std::string> first_lines;
+    std::vector<std::string> second_lines;
+    double name_ms = 0;
+    double first_ms = 0;
+    double second_ms = 0;
+    std::size_t added = 0;
+    std::size_t readded = 0;
+    bool ok = run(objects, format, by_name, name_lines, name_ms) && run(objects, format, by_ordinal, first_lines, first_ms, &added) &&
+              run(objects, format, by_ordinal, second_lines, second_ms, &readded);
+    if (ok)
+    {
+        const EdataSize names = measure_edata(name_lines, dll);
+        const EdataSize ordinals = measure_edata(first_lines, dll);
+        print_edata("by name:", names);
+        print_edata("by ordinal (NONAME):", ordinals);
+        std::printf("export table shrinks by %.1f%% (%llu -> %llu bytes)\n",
+                    names.total() == 0 ? 0.0 : 100.0 - 100.0 * static_cast<double>(ordinals.total()) / static_cast<double>(names.total()),
+                    static_cast<unsigned long long>(names.total()), static_cast<unsigned long long>(ordinals.total()));
+        std::printf("generate: by name %.1f ms, ordinals assigned %.1f ms (%zu new), ordinals reused %.1f ms (%zu new, output %s)\n",
+                    name_ms, first_ms, added, second_ms, readded, second_lines == first_lines ? "identical" : "DIFFERENT");
+
+        if (objects.size() > 1)
+        {
+            // Relink without the last object: every export that is still there must keep its ordinal.
+            std::vector<std::string> fewer_lines;
+            double fewer_ms = 0;
+            const std::vector<fs::path> fewer(objects.begin(), objects.end() - 1);
+            ok = run(fewer, format, by_ordinal, fewer_lines, fewer_ms);
+            if (ok)
+            {
+                const auto before = ordinal_map(first_lines);
+                std::size_t kept = 0;
+                std::size_t moved = 0;
+                for (const auto& [name, ordinal] : ordinal_map(fewer_lines))
+                {
+                    const auto it = before.find(name);
+                    (it != before.end() && it->second == ordinal ? kept : moved)++;
+                }
+                std::printf("relink without %s: %zu exports kept their ordinal, %zu moved\n", objects.back().filename().string().c_str(),
+                            kept, moved);
+                ok = moved == 0;
+            }
+        }
+    }
+    fs::remove(by_ordinal.ordinal_database, ec);
+    return ok ? 0 : 1;
+}
+
+[[nodiscard]] const char* load_mode_name(defgen::LoadMode mode)
+{
+    switch (mode)
+    {
+    case defgen::LoadMode::Ranged:
+        return "ranged";
+    case defgen::LoadMode::Batched:
+        return "batched";
+    default:
+        return "mapped";
+    }
+}
+
+/// Best of `repeat` runs of `generate_def` in each load mode, cold (inputs evicted before every run) and warm. Every
+/// run must produce the same lines, which are left in `lines`.
+[[nodiscard]] bool time_load_modes(const std::vector<fs::path>& objects, defgen::ObjectFormat format, defgen::GenerateOptions options,
+                                   int repeat, std::vector<std::string>& lines)
+{
+    std::uint64_t total_bytes = 0;
+    for (const fs::path& object : objects)
+    {
+        std::error_code ec;
+        total_bytes += fs::file_size(object, ec);
+    }
+    std::printf("%zu inputs, %.1f MiB%s\n", objects.size(), static_cast<double>(total_bytes) / (1 << 20),
+                drop_cached({}) ? "" : " (page cache cannot be dropped here: cold = warm)");
+
+    lines.clear();
+    for (const defgen::LoadMode mode : {defgen::LoadMode::Mapped, defgen::LoadMode::Ranged, defgen::LoadMode::Batched})
+    {
+        options.load_mode = mode;
+        double best[2] = {0, 0};
+        std::uint64_t bytes_read = 0;
+        defgen::LoadMode used = mode;
+        for (int warm = 0; warm < 2; warm++)
+        {
+            for (int r = warm == 0 ? 0 : -1; r < repeat; r++)
+            {
+                if (warm == 0)
+                {
+                    drop_cached(objects);
+                }
+                const auto start = std::chrono::steady_clock::now();
+                defgen::GenerateResult gr = defgen::generate_def(objects, format, options);
+                const double ms = ms_since(start);
+                if (gr.ec != defgen::Errc::Ok)
+                {
+                    std::printf("defgen-bench: %s\n", gr.message.c_str());
+                    return false;
+                }
+                if (lines.empty())
+                {
+                    lines = std::move(gr.out.lines);
+                }
+                else if (gr.out.lines != lines)
+                {
+                    std::printf("defgen-bench: %s output DIFFERENT from mapped\n", load_mode_name(mode));
+                    return false;
+                }
+                bytes_read = gr.stats.total_bytes_read;
+                used = gr.stats.load_mode;
+                // The extra warm run (r == -1) only fills the cache.
+                if (r >= 0 && (best[warm] == 0 || ms < best[warm]))
+                {
+                    best[warm] = ms;
+                }
+            }
+        }
+        std::printf("%-8s cold %9.1f ms, warm %9.1f ms, read %9.1f MiB%s\n", load_mode_name(mode), best[0], best[1],
+                    static_cast<double>(bytes_read) / (1 << 20), used == mode ? "" : " (fell back to mapped)");
+    }
+    std::printf("%zu lines of output\n", lines.size());
+    return true;
+}
+
+int bench_loaders(int argc, char* argv[])
+{
+    defgen::ObjectFormat format = defgen::ObjectFormat::Auto;
+    defgen::GenerateOptions options;
+    int repeat = 3;
+    std::vector<fs::path> objects;
+    for (int i = 0; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "--elf") == 0)
+        {
+            format = defgen::ObjectFormat::Elf;
+        }
+        else if (std::strcmp(arg, "--threads") == 0 && i + 1 < argc)
+        {
+            options.thread_count = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(arg, "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg[0] == '-')
+        {
+            print_usage();
+            return 2;
+        }
+        else
+        {
+            objects.emplace_back(arg);
+        }
+    }
+    if (objects.empty())
+    {
+        print_usage();
+        return 2;
+    }
+    std::vector<std::string> lines;
+    return time_load_modes(objects, format, options, repeat, lines) ? 0 : 1;
+}
+
+/// x64 COFF object with one `.text` section of `code_bytes` and a function per entry of `functions` (static ones when
+/// `local`), as a compiled translation unit looks to the parsers.
+[[nodiscard]] std::vector<std::uint8_t> synthetic_object(const std::vector<std::string>& functions, std::size_t code_bytes,
+                                                         bool local = false)
+{
+    using namespace defgen::detail;
+    using namespace defgen::coff;
+    std::vector<std::uint8_t> out;
+    SCoffImage::SCoffHeader header{};
+    header.machine = IMAGE_FILE_MACHINE_AMD64;
+    header.nSections = 1;
+    // Objects with a zero time stamp are skipped as placeholders.
+    header.timeStamp = 1;
+    header.pSymbols = static_cast<std::uint32_t>(sizeof(header) + sizeof(SCoffImage::SCoffSection) + code_bytes);
+    header.nSymbols = static_cast<std::uint32_t>(functions.size());
+    append_record(out, header);
+    SCoffImage::SCoffSection text{};
+    std::memcpy(text.szName, ".text", 5);
+    text.dwSize = static_cast<std::uint32_t>(code_bytes);
+    text.pData = static_cast<std::uint32_t>(sizeof(header) + sizeof(text));
+    text.flags = IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ;
+    append_record(out, text);
+    out.resize(out.size() + code_bytes, 0xCC);
+    std::string strings(sizeof(std::uint32_t), '\0');
+    for (const std::string& name : functions)
+    {
+        SCoffImage::SCoffSymbol symbol{};
+        set_coff_name(symbol.szName, name, strings);
+        symbol.nSection = 1;
+        symbol.nType = IMAGE_SYM_DTYPE_FUNCTION;
+        symbol.nStorageClass = local ? IMAGE_SYM_CLASS_STATIC : IMAGE_SYM_CLASS_EXTERNAL;
+        append_record(out, symbol);
+    }
+    append_string_table(out, strings);
+    return out;
+}
+
+/// `count` mangled function names unique to `module`.
+[[nodiscard]] std::vector<std::string> module_functions(std::string_view module, std::size_t count)
+{
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        std::string name = "?";
+        name += module;
+        name += "_function_";
+        name += std::to_string(i);
+        name += "@Module@@YAXH@Z";
+        names.push_back(std::move(name));
+    }
+    return names;
+}
+
+[[nodiscard]] bool write_bytes(const fs::path& path, const std::vector<std::uint8_t>& bytes)
+{
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(f);
+}
+
+/// Names laid out back to back, as in a string table.
+struct NameSet
+{
+    std::string label;
+    std::string bytes;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> names;
+
+    void add(std::string_view name)
+    {
+        names.emplace_back(static_cast<std::uint32_t>(bytes.size()), static_cast<std::uint32_t>(name.size()));
+        bytes += name;
+        bytes += '\0';
+    }
+};
+
+/// `count` identifiers of `min_length` to `max_length` characters (the shape `is_identifier` sees: `_`-prefixed C names).
+[[nodiscard]] NameSet identifier_names(std::size_t min_length, std::size_t max_length, std::size_t count)
+{
+    static constexpr char kAlphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+    NameSet set;
+    set.label = std::to_string(min_length);
+    if (max_length != min_length)
+    {
+        set.label += '-';
+        set.label += std::to_string(max_length);
+    }
+    set.label += " bytes";
+    std::string name;
+    std::uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        const std::size_t length = min_length + (state >> 33) % (max_length - min_length + 1);
+        name.assign(1, '_');
+        while (name.size() < length)
+        {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            name += kAlphabet[(state >> 33) % (sizeof(kAlphabet) - 1)];
+        }
+        set.add(name);
+    }
+    return set;
+}
+
+/// The classification `get_export_name` did before the kernels: `std::isalnum` per byte.
+bool identifier_isalnum(const char* s, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        if (!std::isalnum(static_cast<unsigned char>(s[i])) && s[i] != '_')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Best of five passes over `set`, in nanoseconds per name.
+[[nodiscard]] double time_kernel(defgen::detail::IdentifierKernel kernel, const NameSet& set, std::size_t& accepted)
+{
+    const std::size_t passes = std::max<std::size_t>(1, 4'000'000 / std::max<std::size_t>(1, set.names.size()));
+    double best = 0;
+    for (int round = 0; round < 5; round++)
+    {
+        accepted = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t pass = 0; pass < passes; pass++)
+        {
+            for (const auto& [offset, size] : set.names)
+            {
+                accepted += kernel(set.bytes.data() + offset, size) ? 1 : 0;
+            }
+        }
+        const double ns = ms_since(start) * 1e6 / static_cast<double>(passes * set.names.size());
+        best = round == 0 ? ns : std::min(best, ns);
+    }
+    return best;
+}
+
+/// Every `is_identifier` kernel the CPU runs, on synthetic names of several lengths (or the names in a file), against
+/// the original `std::isalnum` loop. All kernels must accept the same names.
+int bench_kernels(int argc, char* argv[])
+{
+    using defgen::detail::SimdLevel;
+    std::vector<NameSet> sets;
+    if (argc == 1 && argv[0][0] != '-')
+    {
+        NameSet set;
+        set.label = fs::path(argv[0]).filename().string();
+        std::ifstream in(argv[0]);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            set.add(line);
+        }
+        if (set.names.empty())
+        {
+            std::printf("defgen-bench: no names in %s\n", argv[0]);
+            return 1;
+        }
+        sets.push_back(std::move(set));
+    }
+    else if (argc != 0)
+    {
+        print_usage();
+        return 2;
+    }
+    else
+    {
+        // Typical C names first, then fixed lengths.
+        sets.push_back(identifier_names(4, 40, 10000));
+        for (const std::size_t length : {6, 12, 24, 48, 96, 256})
+        {
+            sets.push_back(identifier_names(length, length, 10000));
+        }
+    }
+
+    // The original loop first: every speedup is against it, and every kernel must accept the same names.
+    std::vector<std::pair<const char*, defgen::detail::IdentifierKernel>> columns = {{"isalnum", identifier_isalnum}};
+    static constexpr std::pair<SimdLevel, const char*> kLevels[] = {
+        {SimdLevel::Scalar, "scalar"}, {SimdLevel::Sse42, "sse4.2"}, {SimdLevel::Avx512, "avx512"}};
+    for (const auto& [level, name] : kLevels)
+    {
+        if (const defgen::detail::IdentifierKernel kernel = defgen::detail::identifier_kernel(level))
+        {
+            columns.emplace_back(name, kernel);
+        }
+    }
+    std::printf("%-12s", "ns/name");
+    for (const auto& [name, kernel] : columns)
+    {
+        std::printf("%16s", name);
+    }
+    std::printf("\n");
+    bool ok = true;
+    for (const NameSet& set : sets)
+    {
+        std::printf("%-12s", set.label.c_str());
+        double baseline = 0;
+        std::size_t baseline_accepted = 0;
+        for (const auto& [name, kernel] : columns)
+        {
+            std::size_t accepted = 0;
+            const double ns = time_kernel(kernel, set, accepted);
+            if (kernel == identifier_isalnum)
+            {
+                baseline = ns;
+                baseline_accepted = accepted;
+                std::printf("%16.2f", ns);
+            }
+            else
+            {
+                std::printf("%8.2f (%4.1fx)", ns, baseline / ns);
+                ok = ok && accepted == baseline_accepted;
+            }
+        }
+        std::printf("\n");
+    }
+    std::printf("default: %s\n", kLevels[static_cast<int>(defgen::detail::simd_level())].second);
+    if (!ok)
+    {
+        std::printf("defgen-bench: kernels DISAGREE with std::isalnum\n");
+    }
+    return ok ? 0 : 1;
+}
+
+/// `count` distinct MSVC-mangled member function names, `?<method>@<class>@<namespace>@@<signature>`, in a shuffled
+/// order: 50 methods per class, so names share long prefixes as in a real C++ DLL.
+[[nodiscard]] std::vector<std::string> mangled_names(std::size_t count)
+{
+    static constexpr const char* kVerbs[] = {"Get", "Set", "Update", "Create", "Destroy", "Find", "Insert", "Remove", "Is", "On"};
+    static constexpr const char* kNouns[] = {"Value", "Count", "Name", "Handle", "State", "Buffer", "Child", "Parent", "Size", "Index",
+                                             "Flags", "Owner", "Target", "Range", "Entry", "Layer", "Style", "Event", "Frame", "Node"};
+    static constexpr const char* kNamespaces[] = {"Engine", "Render", "Physics", "Audio", "Ui", "Net", "Script", "Core"};
+    static constexpr const char* kSignatures[] = {"QEAAXXZ", "QEBAHXZ", "QEAAX_N@Z", "QEAAXH@Z", "QEBA_NXZ", "UEAAXAEBV0@@Z"};
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const std::size_t cls = i / 50;
+        const std::size_t method = (cls * 7 + i % 50) % 200;
+        std::string name = "?";
+        name += kVerbs[method % 10];
+        name += kNouns[method / 10];
+        name += "@C";
+        name += kNouns[cls % 20];
+        name += "Controller";
+        name += std::to_string(cls / 20);
+        name += '@';
+        name += kNamespaces[cls % 8];
+        name += "@@";
+        name += kSignatures[i % 6];
+        names.push_back(std::move(name));
+    }
+    std::uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (std::size_t i = names.size(); i > 1; i--)
+    {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        std::swap(names[i - 1], names[(state >> 33) % i]);
+    }
+    return names;
+}
+
+/// Best of three runs of `sort` on a fresh copy of `input`, in milliseconds; the last result is left in `out`.
+template <typename T, typename Sort> [[nodiscard]] double time_sort(const std::vector<T>& input, std::vector<T>& out, Sort&& sort)
+{
+    double best = 0;
+    for (int round = 0; round < 3; round++)
+    {
+        out = input;
+        const auto start = std::chrono::steady_clock::now();
+        sort(out);
+        const double ms = ms_since(start);
+        best = round == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+/// `sort_names` (one thread and `--threads`) against `std::sort` on the interned handles and on `std::string`, over
+/// synthetic mangled names. All must give the same order.
+int bench_sort(int argc, char* argv[])
+{
+    std::size_t count = 1'000'000;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+        {
+            count = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threads = std::max(1u, static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10)));
+        }
+        else
+        {
+            print_usage();
+            return 2;
+        }
+    }
+
+    const std::vector<std::string> names = mangled_names(count);
+    defgen::detail::SymbolPool pool;
+    defgen::detail::SymbolCollector collector(pool);
+    std::uint64_t bytes = 0;
+    for (const std::string& name : names)
+    {
+        collector.add(name, defgen::detail::SymbolFunction);
+        bytes += name.size();
+    }
+    const std::vector<defgen::detail::SymbolHandle>& handles = collector.funcs;
+    std::printf("%zu names, %.1f bytes on average\n", handles.size(), static_cast<double>(bytes) / static_cast<double>(names.size()));
+
+    std::vector<std::string> strings;
+    const double string_ms = time_sort(names, strings, [](std::vector<std::string>& v) { std::sort(v.begin(), v.end()); });
+    std::vector<defgen::detail::SymbolHandle> by_view;
+    const double view_ms = time_sort(handles, by_view, [](std::vector<defgen::detail::SymbolHandle>& v) {
+        std::sort(v.begin(), v.end(), [](defgen::detail::SymbolHandle a, defgen::detail::SymbolHandle b) { return a->view() < b->view(); });
+    });
+    std::vector<defgen::detail::SymbolHandle> sorted;
+    const double serial_ms =
+        time_sort(handles, sorted, [](std::vector<defgen::detail::SymbolHandle>& v) { defgen::detail::sort_names(v, 1); });
+    bool ok = sorted == by_view;
+    std::vector<defgen::detail::SymbolHandle> parallel;
+    const double parallel_ms =
+        time_sort(handles, parallel, [threads](std::vector<defgen::detail::SymbolHandle>& v) { defgen::detail::sort_names(v, threads); });
+    ok = ok && parallel == by_view;
+    for (std::size_t i = 0; ok && i < strings.size(); i++)
+    {
+        ok = strings[i] == by_view[i]->view();
+    }
+
+    char parallel_label[32];
+    std::snprintf(parallel_label, sizeof(parallel_label), "sort_names, %u threads", threads);
+    std::printf("%-24s %8.1f ms\n", "std::sort, std::string", string_ms);
+    std::printf("%-24s %8.1f ms\n", "std::sort, handles", view_ms);
+    std::printf("%-24s %8.1f ms (%.1fx)\n", "sort_names, 1 thread", serial_ms, view_ms / serial_ms);
+    std::printf("%-24s %8.1f ms (%.1fx)\n", parallel_label, parallel_ms, view_ms / parallel_ms);
+    if (!ok)
+    {
+        std::printf("defgen-bench: sort orders DIFFER\n");
+    }
+    return ok ? 0 : 1;
+}
+
+/// Median of `values` (sorted in place).
+[[nodiscard]] double median(std::vector<double>& values)
+{
+    std::sort(values.begin(), values.end());
+    return values.empty() ? 0 : values[values.size() / 2];
+}
+
+/// An in-process daemon over `--objects` synthetic objects (4 functions each): the first request, which parses
+/// everything, then `--repeat` requests with nothing changed (answered `unchanged`), then requests with one object
+/// rewritten; `generate_def` over the same objects for comparison.
+int bench_daemon(int argc, char* argv[])
+{
+    std::size_t count = 50'000;
+    int repeat = 20;
+    for (int i = 0; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+        {
+            count = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else
+        {
+            print_usage();
+            return 2;
+        }
+    }
+
+    std::error_code ec;
+    const fs::path dir = fs::temp_directory_path(ec) / "defgen-bench-daemon";
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir, ec);
+    std::vector<fs::path> objects;
+    objects.reserve(count);
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const std::string module = "m" + std::to_string(i);
+        objects.push_back(dir / (module + ".obj"));
+        if (!write_bytes(objects.back(), synthetic_object(module_functions(module, 4), 256)))
+        {
+            std::printf("defgen-bench: cannot write %s\n", objects.back().string().c_str());
+            return 1;
+        }
+    }
+    std::printf("%zu objects written to %s in %.0f ms\n", count, dir.string().c_str(), ms_since(start));
+
+    defgen::DaemonOptions daemon_options;
+    daemon_options.endpoint = defgen::default_daemon_endpoint();
+    daemon_options.endpoint += "-bench";
+    std::string daemon_err;
+    std::thread daemon([&] {
+        if (!defgen::run_daemon(daemon_options, daemon_err))
+        {
+            std::printf("defgen-bench: %s\n", daemon_err.c_str());
+        }
+    });
+    defgen::DaemonStats daemon_stats;
+    std::string err;
+    for (int attempt = 0; attempt < 500 && !defgen::query_daemon_stats(daemon_options.endpoint, daemon_stats, err); attempt++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // The same request `defgend query` sends.
+    defgen::GenerateOptions options;
+    options.object_count_line = ";ObjectCount=" + std::to_string(count);
+    options.export_hash_in_header = true;
+    const fs::path def_path = dir / "exports.def";
+    bool ok = true;
+    auto query = [&](double& ms, bool expect_unchanged, std::size_t expect_parsed) {
+        const auto t0 = std::chrono::steady_clock::now();
+        defgen::DaemonResult r = defgen::query_daemon(daemon_options.endpoint, objects, defgen::ObjectFormat::Coff, options, def_path);
+        ms = ms_since(t0);
+        if (r.ec != defgen::Errc::Ok)
+        {
+            std::printf("defgen-bench: %s\n", r.message.c_str());
+            ok = false;
+        }
+        else if (r.unchanged != expect_unchanged || r.objects_parsed != expect_parsed)
+        {
+            std::printf("defgen-bench: expected %s with %zu parsed, got %s with %zu\n", expect_unchanged ? "unchanged" : "changed",
+                        expect_parsed, r.unchanged ? "unchanged" : "changed", r.objects_parsed);
+            ok = false;
+        }
+        else if (!r.unchanged)
+        {
+            std::ofstream f(def_path, std::ios::binary | std::ios::trunc);
+            for (const std::string& line : r.out.lines)
+            {
+                f << line << '\n';
+            }
+        }
+    };
+
+    double first_ms = 0;
+    query(first_ms, false, count);
+    std::vector<double> unchanged_ms;
+    for (int r = 0; ok && r < repeat; r++)
+    {
+        query(unchanged_ms.emplace_back(), true, 0);
+    }
+    std::vector<double> changed_ms;
+    for (int r = 0; ok && r < repeat; r++)
+    {
+        // A new function each time, so the export file changes and the rewritten object is parsed again.
+        std::vector<std::string> functions = module_functions("m0", 4);
+        functions.push_back("?rebuilt_" + std::to_string(r) + "@Module@@YAXH@Z");
+        ok = write_bytes(objects[0], synthetic_object(functions, 256));
+        query(changed_ms.emplace_back(), false, 1);
+    }
+
+    double generate_ms = 0;
+    if (ok)
+    {
+        start = std::chrono::steady_clock::now();
+        const defgen::GenerateResult gr = defgen::generate_def(objects, defgen::ObjectFormat::Coff, options);
+        generate_ms = ms_since(start);
+        ok = gr.ec == defgen::Errc::Ok;
+    }
+    if (!defgen::stop_daemon(daemon_options.endpoint, err))
+    {
+        std::printf("defgen-bench: %s\n", err.c_str());
+    }
+    daemon.join();
+    fs::remove_all(dir, ec);
+    if (!ok)
+    {
+        return 1;
+    }
+    std::printf("first request (parse all)   %9.1f ms\n", first_ms);
+    std::printf("nothing changed             %9.1f ms median, %.1f ms best of %d\n", median(unchanged_ms),
+                *std::min_element(unchanged_ms.begin(), unchanged_ms.end()), repeat);
+    std::printf("one object rewritten        %9.1f ms median\n", median(changed_ms));
+    std::printf("generate_def (no daemon)    %9.1f ms\n", generate_ms);
+    return 0;
+}
+
+/// Member of a synthetic static library. Its bytes are rebuilt when needed, so a multi-hundred-MB library is never
+/// held in memory.
+struct LibraryMember
+{
+    std::string name;
+    std::vector<std::string> functions;
+    /// Static functions only: no index entry points at the member.
+    bool local = false;
+    std::size_t code_bytes = 0;
+
+    [[nodiscard]] std::vector<std::uint8_t> bytes() const { return synthetic_object(functions, code_bytes, local); }
+};
+
+void append_ar_header(std::string& out, const std::string& name, std::uint64_t size)
+{
+    char header[ar::kHeaderSize + 1];
+    std::snprintf(header, sizeof(header), "%-16s%-12s%-6s%-6s%-8s%-10llu`\n", name.c_str(), "0", "", "", "644",
+                  static_cast<unsigned long long>(size));
+    out.append(header, ar::kHeaderSize);
+}
+
+void append_be32(std::string& out, std::uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        out += static_cast<char>((value >> shift) & 0xFF);
+    }
+}
+
+void append_le(std::string& out, std::uint32_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+/// Write `members` in the `lib.exe` layout: the first (SysV) and second linker members when `indexed`, the long name
+/// member, then the objects.
+[[nodiscard]] bool write_library(const fs::path& path, const std::vector<LibraryMember>& members, bool indexed)
+{
+    std::vector<std::uint64_t> sizes;
+    std::string long_names;
+    std::vector<std::string> member_names;
+    for (const LibraryMember& member : members)
+    {
+        sizes.push_back(member.bytes().size());
+        member_names.push_back("/" + std::to_string(long_names.size()));
+        long_names += member.name;
+        long_names += '\0';
+    }
+
+    // (name, member index) of every public symbol, in member order and in name order.
+    std::vector<std::pair<std::string_view, std::uint32_t>> symbols;
+    for (std::uint32_t i = 0; i < members.size(); i++)
+    {
+        for (const std::string& name : members[i].functions)
+        {
+            if (!members[i].local)
+            {
+                symbols.emplace_back(name, i);
+            }
+        }
+    }
+    std::vector<std::pair<std::string_view, std::uint32_t>> sorted = symbols;
+    std::sort(sorted.begin(), sorted.end());
+    std::uint64_t name_bytes = 0;
+    for (const auto& symbol : symbols)
+    {
+        name_bytes += symbol.first.size() + 1;
+    }
+
+    const std::uint64_t first_size = 4 + 4 * symbols.size() + name_bytes;
+    const std::uint64_t second_size = 4 + 4 * members.size() + 4 + 2 * symbols.size() + name_bytes;
+    std::uint64_t at = ar::kSignatureSize + ar::kHeaderSize + long_names.size() + (long_names.size() & 1);
+    if (indexed)
+    {
+        at += 2 * ar::kHeaderSize + first_size + (first_size & 1) + second_size + (second_size & 1);
+    }
+    std::vector<std::uint32_t> offsets;
+    for (const std::uint64_t size : sizes)
+    {
+        offsets.push_back(static_cast<std::uint32_t>(at));
+        at += ar::kHeaderSize + size + (size & 1);
+    }
+    if (at > 0xFFFFFFFFull)
+    {
+        std::printf("defgen-bench: a .lib cannot exceed 4 GB\n");
+        return false;
+    }
+
+    std::string text = "!<arch>\n";
+    if (indexed)
+    {
+        append_ar_header(text, "/", first_size);
+        append_be32(text, static_cast<std::uint32_t>(symbols.size()));
+        for (const auto& symbol : symbols)
+        {
+            append_be32(text, offsets[symbol.second]);
+        }
+        for (const auto& symbol : symbols)
+        {
+            text += symbol.first;
+            text += '\0';
+        }
+        text.resize(text.size() + (first_size & 1), '\n');
+        append_ar_header(text, "/", second_size);
+        append_le(text, static_cast<std::uint32_t>(members.size()), 4);
+        for (const std::uint32_t offset : offsets)
+        {
+            append_le(text, offset, 4);
+        }
+        append_le(text, static_cast<std::uint32_t>(sorted.size()), 4);
+        for (const auto& symbol : sorted)
+        {
+            append_le(text, symbol.second + 1, 2);
+        }
+        for (const auto& symbol : sorted)
+        {
+            text += symbol.first;
+            text += '\0';
+        }
+        text.resize(text.size() + (second_size & 1), '\n');
+    }
+    append_ar_header(text, "//", long_names.size());
+    text += long_names;
+    text.resize(text.size() + (long_names.size() & 1), '\n');
+
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f.write(text.data(), static_cast<std::streamsize>(text.size()));
+    for (std::size_t i = 0; i < members.size(); i++)
+    {
+        text.clear();
+        append_ar_header(text, member_names[i], sizes[i]);
+        const std::vector<std::uint8_t> bytes = members[i].bytes();
+        text.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        text.resize(text.size() + (bytes.size() & 1), '\n');
+        f.write(text.data(), static_cast<std::streamsize>(text.size()));
+    }
+    return static_cast<bool>(f);
+}
+
+/// A synthetic static library of `--members` objects that define 100 functions each and as many that only have static
+/// functions, `--code-kib` of code per object: `generate_def` over it with its linker member index, over the same
+/// library without one (walked member by member), and over the members as separate objects.
+int bench_lib(int argc, char* argv[])
+{
+    std::size_t count = 2000;
+    std::size_t code_kib = 100;
+    int repeat = 3;
+    for (int i = 0; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--members") == 0 && i + 1 < argc)
+        {
+            count = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--code-kib") == 0 && i + 1 < argc)
+        {
+            code_kib = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else
+        {
+            print_usage();
+            return 2;
+        }
+    }
+
+    std::vector<LibraryMember> members;
+    for (std::size_t i = 0; i < 2 * count; i++)
+    {
+        LibraryMember& member = members.emplace_back();
+        member.local = i % 2 == 1;
+        member.name = "synthetic_module_" + std::to_string(i) + ".obj";
+        member.functions = module_functions("m" + std::to_string(i), member.local ? 20 : 100);
+        member.code_bytes = code_kib * 1024;
+    }
+
+    std::error_code ec;
+    const fs::path dir = fs::temp_directory_path(ec) / "defgen-bench-lib";
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir / "objects", ec);
+    const auto start = std::chrono::steady_clock::now();
+    bool ok = write_library(dir / "indexed.lib", members, true) && write_library(dir / "walked.lib", members, false);
+    std::vector<fs::path> objects;
+    for (std::size_t i = 0; ok && i < members.size(); i++)
+    {
+        objects.push_back(dir / "objects" / members[i].name);
+        ok = write_bytes(objects.back(), members[i].bytes());
+    }
+    if (!ok)
+    {
+        std::printf("defgen-bench: cannot write to %s\n", dir.string().c_str());
+        fs::remove_all(dir, ec);
+        return 1;
+    }
+    std::printf("%zu members written to %s in %.0f ms\n", members.size(), dir.string().c_str(), ms_since(start));
+
+    std::vector<std::string> indexed;
+    std::vector<std::string> walked;
+    std::vector<std::string> extracted;
+    std::printf("\nwith linker member index: ");
+    ok = time_load_modes({dir / "indexed.lib"}, defgen::ObjectFormat::Coff, {}, repeat, indexed);
+    std::printf("\nwithout index (walked): ");
+    ok = ok && time_load_modes({dir / "walked.lib"}, defgen::ObjectFormat::Coff, {}, repeat, walked);
+    std::printf("\nextracted members: ");
+    ok = ok && time_load_modes(objects, defgen::ObjectFormat::Coff, {}, repeat, extracted);
+    if (ok && (walked != indexed || extracted != indexed))
+    {
+        std::printf("defgen-bench: library and object outputs DIFFER\n");
+        ok = false;
+    }
+    fs::remove_all(dir, ec);
+    return ok ? 0 : 1;
+}
+
+/// `generate_def` (ELF) over GNU archives in every load mode; by default every `.a` in the system library directories.
+/// Archives the parser rejects on their own (LLVM bitcode members, a truncated file, ...) are reported and left out.
+int bench_archives(int argc, char* argv[])
+{
+    int repeat = 3;
+    std::vector<fs::path> candidates;
+    for (int i = 0; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (argv[i][0] == '-')
+        {
+            print_usage();
+            return 2;
+        }
+        else
+        {
+            candidates.emplace_back(argv[i]);
+        }
+    }
+    if (candidates.empty())
+    {
+        for (const char* dir : {"/usr/lib/x86_64-linux-gnu", "/usr/lib/aarch64-linux-gnu", "/usr/lib64", "/usr/lib", "/usr/local/lib"})
+        {
+            std::error_code ec;
+            for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+            {
+                if (it->path().extension() == ".a" && it->is_regular_file(ec))
+                {
+                    candidates.push_back(it->path());
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+    }
+    if (candidates.empty())
+    {
+        print_usage();
+        return 2;
+    }
+
+    std::vector<fs::path> archives;
+    for (const fs::path& candidate : candidates)
+    {
+        const defgen::GenerateResult gr = defgen::generate_def({candidate}, defgen::ObjectFormat::Elf, {});
+        if (gr.ec == defgen::Errc::Ok)
+        {
+            archives.push_back(candidate);
+        }
+        else
+        {
+            std::printf("skipped %s: %s\n", candidate.string().c_str(), gr.message.c_str());
+        }
+    }
+    if (archives.empty())
+    {
+        return 1;
+    }
+    std::vector<std::string> lines;
+    return time_load_modes(archives, defgen::ObjectFormat::Elf, {}, repeat, lines) ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && std::strcmp(argv[1], "loaders") == 0)
+    {
+        return bench_loaders(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "kernels") == 0)
+    {
+        return bench_kernels(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "sort") == 0)
+    {
+        return bench_sort(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "daemon") == 0)
+    {
+        return bench_daemon(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "lib") == 0)
+    {
+        return bench_lib(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "archives") == 0)
+    {
+        return bench_archives(argc - 2, argv + 2);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "edata") == 0)
+    {
+        return bench_edata(argc - 2, argv + 2);
+    }
+    return bench_edata(argc - 1, argv + 1);
+}
@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: MIT
+// Resident defgen server: keeps parsed per-object symbol tables in memory between link invocations, so a proxy
+// (or `defgend query`) only pays for a stat per object when nothing changed. `defgend watch` instead keeps an export
+// file current while the build is still compiling.
+
+#include "defgen/defgen.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+void print_usage()
+{
+    std::printf("usage:\n"
+                "  defgend [serve] [--endpoint <path>] [--memory-mb <n>] [--threads <n>]\n"
+                "  defgend query [--endpoint <path>] [--elf [--stub <lib.so>] | --ordinals] [--ignore <substring>]...\n"
+                "                [--fingerprint <file>] -o <out.def|out.emd> <objects>...\n"
+                "  defgend watch [--elf [--stub <lib.so>]] [--ignore <substring>]... [--debounce-ms <n>]\n"
+                "                [--fingerprint <file>] -o <out.def|out.emd> <directories>...\n"
+                "  defgend cache [--max-mb <n>] <shared cache directory>\n"
+                "  defgend status [--endpoint <path>]\n"
+                "  defgend stop [--endpoint <path>]\n");
+}
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void on_stop_signal(int) { stop_requested = 1; }
+
+/// Non-empty lines of `path` in the current working directory. Same files the proxy reads (`DefBuildIgnores.txt`,
+/// `DefNamedExports.txt`), so daemon and proxy-generated output use identical settings.
+void load_name_list(const char* path, std::vector<std::string>& out)
+{
+    std::ifstream f(path);
+    std::string line;
+    while (std::getline(f, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (!line.empty())
+        {
+            out.push_back(line);
+        }
+    }
+}
+
+[[nodiscard]] int write_lines(const fs::path& path, const std::vector<std::string>& lines)
+{
+    defgen::ExportFileWriter writer(path);
+    for (const auto& line : lines)
+    {
+        writer.line(line);
+    }
+    bool unchanged = false;
+    std::string err;
+    if (!writer.commit(unchanged, err))
+    {
+        std::printf("Can't create '%s' (%s)\n", path.string().c_str(), err.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+/// Bring the ELF interface stub `stub_path` in line with the EMD at `emd_path`; the stub's file name is its soname.
+[[nodiscard]] int write_stub(const fs::path& emd_path, const fs::path& stub_path)
+{
+    defgen::ElfStubOptions options;
+    options.soname = stub_path.filename().string();
+    bool unchanged = false;
+    std::string err;
+    if (defgen::write_elf_stub(emd_path, stub_path, options, unchanged, err) != defgen::Errc::Ok)
+    {
+        std::printf("DEFGEN: %s\n", err.c_str());
+        return 1;
+    }
+    if (!unchanged)
+    {
+        std::printf("DEFGEN: Write stub '%s'\n", stub_path.string().c_str());
+    }
+    return 0;
+}
+
+/// Bring the interface fingerprint `fingerprint_path` in line with the export file `out_path`. Only a changed interface
+/// is reported; `quiet` also drops the relinks-avoided line (watch mode, which runs this on every update).
+[[nodiscard]] int write_fingerprint(const fs::path& out_path, const fs::path& fingerprint_path, bool elf, bool quiet)
+{
+    bool unchanged = false;
+    defgen::FingerprintStats stats;
+    std::string err;
+    if (defgen::write_interface_fingerprint(out_path, elf ? defgen::ObjectFormat::Elf : defgen::ObjectFormat::Coff, fingerprint_path,
+                                            elf ? "elf " + out_path.stem().string() : "coff", unchanged, stats, err) != defgen::Errc::Ok)
+    {
+        std::printf("DEFGEN: %s\n", err.c_str());
+        return 1;
+    }
+    if (!unchanged)
+    {
+        std::printf("DEFGEN: Write fingerprint '%s'\n", fingerprint_path.string().c_str());
+    }
+    else if (!quiet)
+    {
+        std::printf("DEFGEN: Interface unchanged, %llu relink(s) avoided so far\n", static_cast<unsigned long long>(stats.relinks_avoided));
+    }
+    return 0;
+}
+
+/// Same settings as the MSVC proxy: `ObjectCount` and `ExportHash` first line, for EMD the output stem as the library name,
+/// and with `ordinals` (`LINK_EXPORT_ALL_ORDINALS=1` for the proxy) `<out>.ordinals` as the ordinal database.
+[[nodiscard]] int run_query(const fs::path& endpoint, const fs::path& out_path, const fs::path& stub_path,
+                            const fs::path& fingerprint_path, const std::vector<fs::path>& objects, bool elf, bool ordinals,
+                            std::vector<std::string> ignores)
+{
+    defgen::GenerateOptions opt;
+    opt.ignore_substrings = std::move(ignores);
+    opt.elf_style_export_block = elf;
+    if (elf && out_path.has_stem())
+    {
+        opt.library_basename = out_path.stem().string();
+    }
+    opt.object_count_line = (elf ? "//ObjectCount=" : ";ObjectCount=") + std::to_string(objects.size());
+    opt.export_hash_in_header = true;
+    if (ordinals && !elf)
+    {
+        opt.ordinal_database = out_path;
+        opt.ordinal_database += ".ordinals";
+        load_name_list("DefNamedExports.txt", opt.named_exports);
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const defgen::DaemonResult r =
+        defgen::query_daemon(endpoint, objects, elf ? defgen::ObjectFormat::Elf : defgen::ObjectFormat::Coff, opt, out_path);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    if (r.ec != defgen::Errc::Ok)
+    {
+        std::printf("DEFGEN: %s\n", r.message.c_str());
+        return 1;
+    }
+    std::printf("DEFGEN: %zu resident, %zu parsed, %.2f ms\n", r.objects_resident, r.objects_parsed, ms);
+    if (r.unchanged)
+    {
+        std::printf("DEFGEN: No new exports (unchanged)\n");
+    }
+    else
+    {
+        std::printf("DEFGEN: Write '%s'\n", out_path.string().c_str());
+        if (write_lines(out_path, r.out.lines) != 0)
+        {
+            return 1;
+        }
+    }
+    if (!fingerprint_path.empty() && write_fingerprint(out_path, fingerprint_path, elf, false) != 0)
+    {
+        return 1;
+    }
+    return stub_path.empty() ? 0 : write_stub(out_path, stub_path);
+}
+
+/// Keep `out_path` and its manifest (and `stub_path` and `fingerprint_path`, if set) current until interrupted; the proxy
+/// then finds nothing to regenerate.
+[[nodiscard]] int run_watch(const fs::path& out_path, const fs::path& stub_path, const fs::path& fingerprint_path,
+                            const std::vector<fs::path>& directories, bool elf, std::vector<std::string> ignores, unsigned debounce_ms)
+{
+    defgen::WatchOptions wo;
+    wo.directories = directories;
+    wo.output = out_path;
+    wo.format = elf ? defgen::ObjectFormat::Elf : defgen::ObjectFormat::Coff;
+    wo.options.ignore_substrings = std::move(ignores);
+    wo.options.elf_style_export_block = elf;
+    if (elf && out_path.has_stem())
+    {
+        wo.options.library_basename = out_path.stem().string();
+    }
+    wo.options.export_hash_in_header = true;
+    wo.object_count_prefix = elf ? "//ObjectCount=" : ";ObjectCount=";
+    wo.debounce_ms = debounce_ms;
+
+    defgen::ExportWatcher watcher(std::move(wo));
+    std::string err;
+    if (!watcher.start(err))
+    {
+        std::printf("defgend: %s\n", err.c_str());
+        return 1;
+    }
+    std::signal(SIGINT, on_stop_signal);
+    std::signal(SIGTERM, on_stop_signal);
+
+    std::size_t written = 0;
+    std::size_t failures = 0;
+    for (bool first = true; stop_requested == 0; first = false)
+    {
+        const defgen::WatchStats& st = watcher.stats();
+        if (first || st.outputs_written != written)
+        {
+            std::printf("DEFGEN: %zu objects, %zu exports, %zu parsed, %zu unchanged -> '%s'\n", st.objects, st.exports, st.parses,
+                        st.unchanged, out_path.string().c_str());
+            written = st.outputs_written;
+            if (!fingerprint_path.empty())
+            {
+                (void)write_fingerprint(out_path, fingerprint_path, elf, true);
+            }
+            if (!stub_path.empty())
+            {
+                (void)write_stub(out_path, stub_path);
+            }
+        }
+        if (st.parse_failures != failures)
+        {
+            std::printf("DEFGEN: %s\n", st.last_error.c_str());
+            failures = st.parse_failures;
+        }
+        std::fflush(stdout);
+        if (!watcher.poll(500, err))
+        {
+            std::printf("defgend: %s\n", err.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string command = "serve";
+    int first = 1;
+    if (argc > 1 && argv[1][0] != '-')
+    {
+        command = argv[1];
+        first = 2;
+    }
+
+    defgen::DaemonOptions options;
+    options.endpoint = defgen::default_daemon_endpoint();
+    fs::path out_path;
+    fs::path stub_path;
+    fs::path fingerprint_path;
+    bool elf = false;
+    bool ordinals = false;
+    std::vector<std::string> ignores;
+    load_name_list("DefBuildIgnores.txt", ignores);
+    unsigned debounce_ms = 100;
+    std::uint64_t cache_max_bytes = 0;
+    std::vector<fs::path> objects;
+    for (int i = first; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(arg, "--endpoint") == 0 && has_value)
+        {
+            options.endpoint = argv[++i];
+        }
+        else if (std::strcmp(arg, "--memory-mb") == 0 && has_value)
+        {
+            options.memory_budget = std::strtoull(argv[++i], nullptr, 10) << 20;
+        }
+        else if (std::strcmp(arg, "--threads") == 0 && has_value)
+        {
+            options.thread_count = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(arg, "-o") == 0 && has_value)
+        {
+            out_path = argv[++i];
+        }
+        else if (std::strcmp(arg, "--stub") == 0 && has_value)
+        {
+            stub_path = argv[++i];
+        }
+        else if (std::strcmp(arg, "--fingerprint") == 0 && has_value)
+        {
+            fingerprint_path = argv[++i];
+        }
+        else if (std::strcmp(arg, "--elf") == 0)
+        {
+            elf = true;
+        }
+        else if (std::strcmp(arg, "--ordinals") == 0)
+        {
+            ordinals = true;
+        }
+        else if (std::strcmp(arg, "--debounce-ms") == 0 && has_value)
+        {
+            debounce_ms = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(arg, "--max-mb") == 0 && has_value)
+        {
+            cache_max_bytes = std::strtoull(argv[++i], nullptr, 10) << 20;
+        }
+        else if (std::strcmp(arg, "--ignore") == 0 && has_value)
+        {
+            ignores.emplace_back(argv[++i]);
+        }
+        else if (arg[0] == '-')
+        {
+            print_usage();
+            return 2;
+        }
+        else
+        {
+            objects.emplace_back(arg);
+        }
+    }
+
+    if (!stub_path.empty() && !elf)
+    {
+        print_usage();
+        return 2;
+    }
+
+    std::string err;
+    if (command == "serve")
+    {
+        std::printf("defgend: listening on %s\n", options.endpoint.string().c_str());
+        std::fflush(stdout);
+        if (!defgen::run_daemon(options, err))
+        {
+            std::printf("defgend: %s\n", err.c_str());
+            return 1;
+        }
+        return 0;
+    }
+    if (command == "query" && !out_path.empty())
+    {
+        return run_query(options.endpoint, out_path, stub_path, fingerprint_path, objects, elf, ordinals, std::move(ignores));
+    }
+    if (command == "watch" && !out_path.empty() && !objects.empty())
+    {
+        return run_watch(out_path, stub_path, fingerprint_path, objects, elf, std::move(ignores), debounce_ms);
+    }
+    if (command == "cache" && objects.size() == 1)
+    {
+        defgen::SharedCacheStats stats;
+        if (!defgen::trim_shared_symbol_cache(objects.front(), cache_max_bytes, stats, err))
+        {
+            std::printf("defgend: %s\n", err.c_str());
+            return 1;
+        }
+        std::printf("entries: %zu\nbytes:   %llu\nevicted: %zu (%llu bytes)\n", stats.entries, static_cast<unsigned long long>(stats.bytes),
+                    stats.evicted, static_cast<unsigned long long>(stats.evicted_bytes));
+        return 0;
+    }
+    if (command == "status")
+    {
+        defgen::DaemonStats stats;
+        if (!defgen::query_daemon_stats(options.endpoint, stats, err))
+        {
+            std::printf("defgend: %s\n", err.c_str());
+            return 1;
+        }
+        std::printf("resident objects: %zu\nresident bytes:   %llu / %llu\nevictions:        %zu\nrequests:         %zu\n",
+                    stats.resident_objects, static_cast<unsigned long long>(stats.resident_bytes),
+                    static_cast<unsigned long long>(stats.memory_budget), stats.evictions, stats.requests);
+        return 0;
+    }
+    if (command == "stop")
+    {
+        if (!defgen::stop_daemon(options.endpoint, err))
+        {
+            std::printf("defgend: %s\n", err.c_str());
+            return 1;
+        }
+        return 0;
+    }
+    print_usage();
+    return 2;
+}
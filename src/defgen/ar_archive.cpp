@@ -0,0 +1,167 @@
+#include "ar_archive.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+namespace defgen::detail::ar
+{
+
+namespace
+{
+
+constexpr char kSignature[kSignatureSize + 1] = "!<arch>\n";
+constexpr char kThinSignature[kSignatureSize + 1] = "!<thin>\n";
+
+/// Blank-padded ASCII decimal field of a member header.
+[[nodiscard]] bool parse_decimal(const std::uint8_t* field, std::size_t width, std::uint64_t& out)
+{
+    out = 0;
+    std::size_t i = 0;
+    for (; i < width && field[i] >= '0' && field[i] <= '9'; i++)
+    {
+        out = out * 10 + static_cast<std::uint64_t>(field[i] - '0');
+    }
+    for (; i < width; i++)
+    {
+        if (field[i] != ' ')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+[[nodiscard]] std::uint64_t read_be(const std::uint8_t* p, std::size_t width)
+{
+    std::uint64_t v = 0;
+    for (std::size_t i = 0; i < width; i++)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+} // namespace
+
+bool is_archive(ObjectSource& source)
+{
+    std::span<const std::uint8_t> head;
+    std::string err;
+    return source.size() >= kSignatureSize && source.read(0, kSignatureSize, head, err) &&
+           std::memcmp(head.data(), kSignature, kSignatureSize) == 0;
+}
+
+bool is_thin_archive(std::span<const std::uint8_t> head)
+{
+    return head.size() >= kSignatureSize && std::memcmp(head.data(), kThinSignature, kSignatureSize) == 0;
+}
+
+bool is_thin_archive(ObjectSource& source)
+{
+    std::span<const std::uint8_t> head;
+    std::string err;
+    return source.size() >= kSignatureSize && source.read(0, kSignatureSize, head, err) && is_thin_archive(head);
+}
+
+bool is_thin_archive_file(const std::filesystem::path& path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (ext != ".a")
+    {
+        return false;
+    }
+    std::ifstream in(path, std::ios::binary);
+    std::uint8_t head[kSignatureSize] = {};
+    return in.read(reinterpret_cast<char*>(head), kSignatureSize) && is_thin_archive(head);
+}
+
+bool read_member(ObjectSource& source, std::uint64_t offset, Member& out, std::string& err, bool thin)
+{
+    std::span<const std::uint8_t> header;
+    if (!source.read(offset, kHeaderSize, header, err))
+    {
+        err = "archive truncated (member header outside of file)";
+        return false;
+    }
+    // name[16] date[12] uid[6] gid[6] mode[8] size[10] "`\n"
+    const std::uint8_t* h = header.data();
+    if (h[58] != '`' || h[59] != '\n' || !parse_decimal(h + 48, 10, out.size))
+    {
+        err = "invalid archive member header";
+        return false;
+    }
+    std::size_t name_size = 16;
+    while (name_size != 0 && h[name_size - 1] == ' ')
+    {
+        name_size--;
+    }
+    out.name = std::string_view(reinterpret_cast<const char*>(h), name_size);
+    out.header_offset = offset;
+    out.data_offset = offset + kHeaderSize;
+    out.external = thin && !is_special(out.name);
+    if (!out.external && out.size > source.size() - out.data_offset)
+    {
+        err = "archive truncated (member data outside of file)";
+        return false;
+    }
+    return true;
+}
+
+bool is_special(std::string_view name)
+{
+    return !name.empty() && name[0] == '/' && (name.size() == 1 || name[1] < '0' || name[1] > '9');
+}
+
+std::string member_name(std::string_view name, std::span<const std::uint8_t> long_names)
+{
+    // Only the leading digits count, as for binutils: GNU `ar` may leave bytes of an earlier name after the blanks.
+    std::size_t digits = 1;
+    std::uint64_t offset = 0;
+    while (digits < name.size() && name[digits] >= '0' && name[digits] <= '9')
+    {
+        offset = offset * 10 + static_cast<std::uint64_t>(name[digits++] - '0');
+    }
+    if (!name.empty() && name[0] == '/' && digits > 1 && offset < long_names.size())
+    {
+        const auto* begin = reinterpret_cast<const char*>(long_names.data()) + offset;
+        const auto* end = reinterpret_cast<const char*>(long_names.data()) + long_names.size();
+        const char* stop = std::find_if(begin, end, [](char c) { return c == '\0' || c == '\n'; });
+        if (stop != begin && stop[-1] == '/')
+        {
+            --stop;
+        }
+        return std::string(begin, stop);
+    }
+    if (name.size() > 1 && name.back() == '/')
+    {
+        name.remove_suffix(1);
+    }
+    return std::string(name);
+}
+
+bool read_symbol_index(std::span<const std::uint8_t> index, std::vector<std::uint64_t>& out, std::size_t width)
+{
+    out.clear();
+    if (index.size() < width)
+    {
+        return false;
+    }
+    const std::uint64_t count = read_be(index.data(), width);
+    if (count > (index.size() - width) / width)
+    {
+        return false;
+    }
+    out.reserve(static_cast<std::size_t>(count));
+    for (std::size_t i = 0; i < count; i++)
+    {
+        out.push_back(read_be(index.data() + width * (i + 1), width));
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return true;
+}
+
+} // namespace defgen::detail::ar
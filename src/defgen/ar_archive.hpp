@@ -0,0 +1,60 @@
+#pragma once
+
+#include "object_source.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace defgen::detail::ar
+{
+
+/// Unix `ar` container, shared by MSVC `.lib` and GNU `.a`: an 8-byte signature, then members that are each a 60-byte
+/// text header followed by their data, padded to an even offset.
+constexpr std::size_t kSignatureSize = 8;
+constexpr std::size_t kHeaderSize = 60;
+
+/// One member header. `name` is the raw 16-byte name field without trailing blanks (`/`, `//`, `name/`, `/123`, ...).
+struct Member
+{
+    std::uint64_t header_offset = 0;
+    std::uint64_t data_offset = 0;
+    std::uint64_t size = 0;
+    std::string_view name;
+    /// Member of a thin archive: `size` bytes of a file next to the archive, nothing stored after the header.
+    bool external = false;
+
+    [[nodiscard]] std::uint64_t next() const { return external ? data_offset : data_offset + size + (size & 1); }
+};
+
+/// True if `source` starts with the `!<arch>` signature (one 8-byte read).
+[[nodiscard]] bool is_archive(ObjectSource& source);
+
+/// True if `head` (the first bytes of a file) is the GNU thin archive signature `!<thin>`.
+[[nodiscard]] bool is_thin_archive(std::span<const std::uint8_t> head);
+[[nodiscard]] bool is_thin_archive(ObjectSource& source);
+
+/// Probe a `.a` file on disk for the thin archive signature; other names are not opened. A thin archive only records
+/// where its members live, so its own bytes (size, mtime, content hash) say nothing about whether they changed.
+[[nodiscard]] bool is_thin_archive_file(const std::filesystem::path& path);
+
+/// Decode the member header at `offset`; the member's data must lie inside the file unless `thin` is set and it is an
+/// object member (bookkeeping members of thin archives are still stored in place).
+[[nodiscard]] bool read_member(ObjectSource& source, std::uint64_t offset, Member& out, std::string& err, bool thin = false);
+
+/// Symbol index (`/`), long name table (`//`) and other `/`-prefixed bookkeeping members carry no object.
+[[nodiscard]] bool is_special(std::string_view name);
+
+/// Member name (for messages; the member's path in a thin archive): `name/` loses its slash, `/<offset>` is looked up in `long_names`
+/// (entries end in `/\n`, or in `\0` as written by `lib.exe`).
+[[nodiscard]] std::string member_name(std::string_view name, std::span<const std::uint8_t> long_names);
+
+/// Header offsets of every member the SysV symbol index lists (big-endian symbol count, one big-endian member offset
+/// per symbol, then the names), sorted and without duplicates. `width` is 4 for `/` and 8 for the GNU `/SYM64/` index
+/// of archives over 4 GB. False if the index is malformed.
+[[nodiscard]] bool read_symbol_index(std::span<const std::uint8_t> index, std::vector<std::uint64_t>& out, std::size_t width = 4);
+
+} // namespace defgen::detail::ar
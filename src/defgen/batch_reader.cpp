@@ -0,0 +1,548 @@
+#include "batch_reader.hpp"
+
+#if defined(DEFGEN_HAS_IO_URING)
+
+#include <linux/io_uring.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+// Largest single read request; longer files are read in several steps.
+constexpr std::size_t kMaxReadChunk = std::size_t{1} << 30;
+
+enum class Op : std::uint64_t
+{
+    Open = 1,
+    Stat = 2,
+    Read = 3,
+    Close = 4,
+    Cancel = 5
+};
+
+#if !defined(IORING_ASYNC_CANCEL_ANY)
+#define IORING_ASYNC_CANCEL_ANY (1U << 2)
+#endif
+
+[[nodiscard]] int sys_io_uring_setup(unsigned entries, io_uring_params* p)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+[[nodiscard]] int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+[[nodiscard]] int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+/// Minimal io_uring wrapper (no liburing dependency): one submission and one completion ring.
+class Ring
+{
+  public:
+    Ring() = default;
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+    ~Ring()
+    {
+        if (sqes_ != nullptr)
+        {
+            ::munmap(sqes_, sqes_len_);
+        }
+        if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_)
+        {
+            ::munmap(cq_ptr_, cq_len_);
+        }
+        if (sq_ptr_ != nullptr)
+        {
+            ::munmap(sq_ptr_, sq_len_);
+        }
+        if (fd_ >= 0)
+        {
+            ::close(fd_);
+        }
+    }
+
+    [[nodiscard]] bool init(unsigned entries, std::string& err)
+    {
+        io_uring_params p{};
+        fd_ = sys_io_uring_setup(entries, &p);
+        if (fd_ < 0)
+        {
+            err = "io_uring_setup failed";
+            return false;
+        }
+        if (!supports_required_ops())
+        {
+            err = "io_uring lacks openat/statx/read/close support";
+            return false;
+        }
+
+        sq_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap)
+        {
+            sq_len_ = cq_len_ = sq_len_ > cq_len_ ? sq_len_ : cq_len_;
+        }
+        sq_ptr_ = ::mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED)
+        {
+            sq_ptr_ = nullptr;
+            err = "io_uring ring mmap failed";
+            return false;
+        }
+        if (single_mmap)
+        {
+            cq_ptr_ = sq_ptr_;
+        }
+        else
+        {
+            cq_ptr_ = ::mmap(nullptr, cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED)
+            {
+                cq_ptr_ = nullptr;
+                err = "io_uring ring mmap failed";
+                return false;
+            }
+        }
+        sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            err = "io_uring sqe mmap failed";
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto* sq = static_cast<std::uint8_t*>(sq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        sq_entries_ = p.sq_entries;
+
+        auto* cq = static_cast<std::uint8_t*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    /// Next free submission entry, zeroed. The caller guarantees the ring never holds more than `sq_entries` requests.
+    [[nodiscard]] io_uring_sqe* get_sqe()
+    {
+        const unsigned head = std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+        if (local_tail_ - head >= sq_entries_)
+        {
+            return nullptr;
+        }
+        const unsigned idx = local_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[idx] = idx;
+        ++local_tail_;
+        ++to_submit_;
+        return sqe;
+    }
+
+    /// Publish queued entries and wait for at least `wait_nr` completions.
+    [[nodiscard]] int submit_and_wait(unsigned wait_nr)
+    {
+        std::atomic_ref<unsigned>(*sq_tail_).store(local_tail_, std::memory_order_release);
+        for (;;)
+        {
+            const int ret = sys_io_uring_enter(fd_, to_submit_, wait_nr, wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0u);
+            if (ret >= 0)
+            {
+                to_submit_ -= static_cast<unsigned>(ret) < to_submit_ ? static_cast<unsigned>(ret) : to_submit_;
+                return 0;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            {
+                return -errno;
+            }
+        }
+    }
+
+    template <typename F> void drain(F&& on_cqe)
+    {
+        unsigned head = *cq_head_;
+        const unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+        while (head != tail)
+        {
+            const io_uring_cqe cqe = cqes_[head & cq_mask_];
+            ++head;
+            std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+            on_cqe(cqe);
+        }
+    }
+
+  private:
+    [[nodiscard]] bool supports_required_ops() const
+    {
+        constexpr unsigned kProbeOps = 256;
+        std::vector<std::uint8_t> storage(sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+        if (sys_io_uring_register(fd_, IORING_REGISTER_PROBE, probe, kProbeOps) < 0)
+        {
+            return false;
+        }
+        for (const unsigned op : {unsigned{IORING_OP_OPENAT}, unsigned{IORING_OP_STATX}, unsigned{IORING_OP_READ}, unsigned{IORING_OP_CLOSE}})
+        {
+            if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int fd_ = -1;
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    std::size_t sq_len_ = 0;
+    std::size_t cq_len_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqes_len_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned local_tail_ = 0;
+    unsigned to_submit_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+/// One file moving through open + statx -> read (possibly in several steps) -> close.
+struct Slot
+{
+    std::size_t index = 0;
+    bool busy = false;
+    bool open_done = false;
+    bool stat_done = false;
+    int fd = -1;
+    int stat_res = 0;
+    struct statx stx
+    {
+    };
+    std::unique_ptr<std::uint8_t[]> bytes;
+    std::size_t size = 0;
+    std::size_t done = 0;
+};
+
+[[nodiscard]] std::uint64_t make_user_data(std::size_t slot, Op op) { return (static_cast<std::uint64_t>(slot) << 3) | static_cast<std::uint64_t>(op); }
+
+class BatchReader
+{
+  public:
+    BatchReader(const std::vector<std::filesystem::path>& paths, const BatchReadCallback& on_file)
+        : paths_(paths)
+        , on_file_(on_file)
+    {
+    }
+
+    [[nodiscard]] bool init(unsigned queue_depth, std::string& err)
+    {
+        slots_.resize(queue_depth);
+        // Per slot: open + statx in flight together, then one read, plus a trailing close.
+        unsigned entries = 1;
+        while (entries < queue_depth * 3)
+        {
+            entries <<= 1;
+        }
+        return ring_.init(entries, err);
+    }
+
+    void run()
+    {
+        std::size_t next = 0;
+        while (next < paths_.size() || inflight_ > 0)
+        {
+            for (std::size_t s = 0; s < slots_.size() && next < paths_.size(); s++)
+            {
+                if (!slots_[s].busy)
+                {
+                    start(s, next++);
+                }
+            }
+            const int rc = ring_.submit_and_wait(inflight_ > 0 ? 1u : 0u);
+            if (rc != 0)
+            {
+                const bool settled = settle_inflight();
+                fail_all(next);
+                if (!settled)
+                {
+                    // The kernel may still write into the buffers and `statx` records of these slots, and nothing tells
+                    // when it stops: they are leaked rather than freed under it.
+                    static_cast<void>(new std::vector<Slot>(std::move(slots_)));
+                }
+                return;
+            }
+            ring_.drain([this](const io_uring_cqe& cqe) { on_complete(cqe); });
+        }
+    }
+
+  private:
+    void start(std::size_t s, std::size_t index)
+    {
+        Slot& slot = slots_[s];
+        slot = Slot{};
+        slot.index = index;
+        slot.busy = true;
+        const char* path = paths_[index].c_str();
+
+        io_uring_sqe* open = ring_.get_sqe();
+        open->opcode = IORING_OP_OPENAT;
+        open->fd = AT_FDCWD;
+        open->addr = reinterpret_cast<std::uint64_t>(path);
+        open->open_flags = O_RDONLY | O_CLOEXEC;
+        open->user_data = make_user_data(s, Op::Open);
+
+        io_uring_sqe* stat = ring_.get_sqe();
+        stat->opcode = IORING_OP_STATX;
+        stat->fd = AT_FDCWD;
+        stat->addr = reinterpret_cast<std::uint64_t>(path);
+        stat->len = STATX_SIZE;
+        stat->off = reinterpret_cast<std::uint64_t>(&slot.stx);
+        stat->user_data = make_user_data(s, Op::Stat);
+        inflight_ += 2;
+    }
+
+    void queue_read(std::size_t s)
+    {
+        Slot& slot = slots_[s];
+        const std::size_t left = slot.size - slot.done;
+        io_uring_sqe* sqe = ring_.get_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = slot.fd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(slot.bytes.get() + slot.done);
+        sqe->len = static_cast<std::uint32_t>(left < kMaxReadChunk ? left : kMaxReadChunk);
+        sqe->off = slot.done;
+        sqe->user_data = make_user_data(s, Op::Read);
+        ++inflight_;
+    }
+
+    void queue_close(Slot& slot)
+    {
+        if (slot.fd < 0)
+        {
+            return;
+        }
+        io_uring_sqe* sqe = ring_.get_sqe();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = slot.fd;
+        sqe->user_data = make_user_data(0, Op::Close);
+        slot.fd = -1;
+        ++inflight_;
+    }
+
+    void finish(std::size_t s, const std::string& err)
+    {
+        Slot& slot = slots_[s];
+        queue_close(slot);
+        slot.busy = false;
+        if (err.empty())
+        {
+            on_file_(slot.index, std::move(slot.bytes), slot.size, err);
+        }
+        else
+        {
+            on_file_(slot.index, nullptr, 0, err);
+        }
+    }
+
+    void opened_and_sized(std::size_t s)
+    {
+        Slot& slot = slots_[s];
+        if (slot.fd < 0)
+        {
+            finish(s, "cannot open object file");
+            return;
+        }
+        if (slot.stat_res < 0)
+        {
+            finish(s, "cannot size object file");
+            return;
+        }
+        slot.size = static_cast<std::size_t>(slot.stx.stx_size);
+        if (slot.size == 0)
+        {
+            finish(s, {});
+            return;
+        }
+        slot.bytes = std::make_unique<std::uint8_t[]>(slot.size);
+        queue_read(s);
+    }
+
+    void on_complete(const io_uring_cqe& cqe)
+    {
+        --inflight_;
+        const auto op = static_cast<Op>(cqe.user_data & 7u);
+        const auto s = static_cast<std::size_t>(cqe.user_data >> 3);
+        if (op == Op::Close)
+        {
+            return;
+        }
+        Slot& slot = slots_[s];
+        switch (op)
+        {
+        case Op::Open:
+            slot.open_done = true;
+            slot.fd = cqe.res;
+            if (slot.stat_done)
+            {
+                opened_and_sized(s);
+            }
+            break;
+        case Op::Stat:
+            slot.stat_done = true;
+            slot.stat_res = cqe.res;
+            if (slot.open_done)
+            {
+                opened_and_sized(s);
+            }
+            break;
+        case Op::Read:
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+            {
+                queue_read(s);
+                break;
+            }
+            if (cqe.res <= 0)
+            {
+                finish(s, "cannot read object file");
+                break;
+            }
+            slot.done += static_cast<std::size_t>(cqe.res);
+            if (slot.done < slot.size)
+            {
+                queue_read(s);
+            }
+            else
+            {
+                finish(s, {});
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    /// After `io_uring_enter` failed: cancel every request still in flight and wait for their completions, which still
+    /// write into the slots. False if the ring cannot do even that.
+    [[nodiscard]] bool settle_inflight()
+    {
+        if (inflight_ == 0)
+        {
+            return true;
+        }
+        // Older kernels answer the cancel with -EINVAL; the requests then simply run to completion.
+        if (io_uring_sqe* cancel = ring_.get_sqe())
+        {
+            cancel->opcode = IORING_OP_ASYNC_CANCEL;
+            cancel->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+            cancel->user_data = make_user_data(0, Op::Cancel);
+            ++inflight_;
+        }
+        while (inflight_ > 0 && ring_.submit_and_wait(1) == 0)
+        {
+            ring_.drain([this](const io_uring_cqe& cqe) {
+                --inflight_;
+                if (static_cast<Op>(cqe.user_data & 7u) == Op::Open && cqe.res >= 0)
+                {
+                    ::close(cqe.res);
+                }
+            });
+        }
+        return inflight_ == 0;
+    }
+
+    /// The ring itself broke (`io_uring_enter` failed): report every file not yet delivered.
+    void fail_all(std::size_t next)
+    {
+        for (Slot& slot : slots_)
+        {
+            if (slot.busy)
+            {
+                if (slot.fd >= 0)
+                {
+                    ::close(slot.fd);
+                }
+                on_file_(slot.index, nullptr, 0, "cannot read object file");
+            }
+        }
+        for (; next < paths_.size(); next++)
+        {
+            on_file_(next, nullptr, 0, "cannot read object file");
+        }
+    }
+
+    const std::vector<std::filesystem::path>& paths_;
+    const BatchReadCallback& on_file_;
+    Ring ring_;
+    std::vector<Slot> slots_;
+    unsigned inflight_ = 0;
+};
+
+} // namespace
+
+bool batch_reader_available()
+{
+    Ring ring;
+    std::string err;
+    return ring.init(4, err);
+}
+
+bool batch_read_files(const std::vector<std::filesystem::path>& paths, unsigned queue_depth, const BatchReadCallback& on_file,
+                      std::string& err)
+{
+    // Three ring entries per file in flight; the kernel caps a ring at 32768 entries.
+    constexpr unsigned kMaxQueueDepth = 8192;
+    queue_depth = queue_depth == 0 ? 1 : (queue_depth > kMaxQueueDepth ? kMaxQueueDepth : queue_depth);
+    BatchReader reader(paths, on_file);
+    if (!reader.init(queue_depth, err))
+    {
+        return false;
+    }
+    reader.run();
+    return true;
+}
+
+} // namespace defgen::detail
+
+#else
+
+namespace defgen::detail
+{
+
+bool batch_reader_available() { return false; }
+
+bool batch_read_files(const std::vector<std::filesystem::path>&, unsigned, const BatchReadCallback&, std::string& err)
+{
+    err = "batched reader (io_uring) is not available in this build";
+    return false;
+}
+
+} // namespace defgen::detail
+
+#endif
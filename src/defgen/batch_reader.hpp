@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// Called once per file, in completion order. `err` is empty on success; `bytes` holds the whole file.
+using BatchReadCallback =
+    std::function<void(std::size_t index, std::unique_ptr<std::uint8_t[]> bytes, std::size_t size, const std::string& err)>;
+
+/// True when this build and the running kernel support the batched (io_uring) reader.
+[[nodiscard]] bool batch_reader_available();
+
+/// Read whole files keeping up to `queue_depth` files' open/statx/read operations in flight (io_uring on Linux).
+/// Buffers are handed to `on_file` as they complete, so parsing overlaps the remaining I/O.
+/// Returns false without calling `on_file` when the batched reader is unavailable; callers fall back to per-file loading.
+[[nodiscard]] bool batch_read_files(const std::vector<std::filesystem::path>& paths, unsigned queue_depth, const BatchReadCallback& on_file,
+                                    std::string& err);
+
+} // namespace defgen::detail
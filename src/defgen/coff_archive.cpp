@@ -0,0 +1,198 @@
+#include "ar_archive.hpp"
+#include "parsers.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+[[nodiscard]] std::uint32_t read_le32(const std::uint8_t* p)
+{
+    std::uint32_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/// Header offsets of the members that define at least one symbol, from the `lib.exe` second linker member
+/// (little-endian member count and member offsets, symbol count, then one 1-based 16-bit member index per symbol).
+/// Only the two tables are read, not the symbol names after them.
+[[nodiscard]] bool read_second_linker_member(ObjectSource& source, const ar::Member& member, std::vector<std::uint64_t>& out,
+                                             std::string& err)
+{
+    std::span<const std::uint8_t> bytes;
+    if (member.size < 4 || !source.read(member.data_offset, 4, bytes, err))
+    {
+        return false;
+    }
+    const std::uint32_t member_count = read_le32(bytes.data());
+    const std::uint64_t symbols_at = 4 + std::uint64_t{4} * member_count;
+    if (symbols_at + 4 > member.size || !source.read(member.data_offset, static_cast<std::size_t>(symbols_at + 4), bytes, err))
+    {
+        return false;
+    }
+    std::vector<std::uint32_t> offsets(member_count);
+    std::memcpy(offsets.data(), bytes.data() + 4, std::size_t{4} * member_count);
+    const std::uint32_t symbol_count = read_le32(bytes.data() + symbols_at);
+    const std::uint64_t indices_at = symbols_at + 4;
+    if (indices_at + std::uint64_t{2} * symbol_count > member.size ||
+        !source.read(member.data_offset + indices_at, std::size_t{2} * symbol_count, bytes, err))
+    {
+        return false;
+    }
+    std::vector<bool> defining(member_count, false);
+    for (std::uint32_t i = 0; i < symbol_count; i++)
+    {
+        std::uint16_t index = 0;
+        std::memcpy(&index, bytes.data() + 2 * static_cast<std::size_t>(i), sizeof(index));
+        if (index == 0 || index > member_count)
+        {
+            return false;
+        }
+        defining[index - 1] = true;
+    }
+    out.clear();
+    for (std::uint32_t i = 0; i < member_count; i++)
+    {
+        if (defining[i])
+        {
+            out.push_back(offsets[i]);
+        }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return true;
+}
+
+/// The first linker member is the SysV index; its names are not needed, only the count and offsets before them.
+[[nodiscard]] bool read_first_linker_member(ObjectSource& source, const ar::Member& member, std::vector<std::uint64_t>& out,
+                                            std::string& err)
+{
+    std::span<const std::uint8_t> bytes;
+    if (member.size < 4 || !source.read(member.data_offset, 4, bytes, err))
+    {
+        return false;
+    }
+    const std::uint64_t count =
+        (std::uint64_t{bytes[0]} << 24) | (std::uint64_t{bytes[1]} << 16) | (std::uint64_t{bytes[2]} << 8) | std::uint64_t{bytes[3]};
+    const std::uint64_t table = 4 + 4 * count;
+    return table <= member.size && source.read(member.data_offset, static_cast<std::size_t>(table), bytes, err) &&
+           ar::read_symbol_index(bytes, out);
+}
+
+/// Short import members of import libraries (`IMPORT_OBJECT_HEADER`: Sig1 0, Sig2 0xFFFF, version 0) describe DLL
+/// imports, not code of this module; bigobj headers share the signature but have version 2 or later.
+[[nodiscard]] bool is_short_import(ObjectSource& member)
+{
+    std::span<const std::uint8_t> head;
+    std::string err;
+    if (member.size() < 6 || !member.read(0, 6, head, err))
+    {
+        return false;
+    }
+    std::uint16_t sig[3] = {};
+    std::memcpy(sig, head.data(), sizeof(sig));
+    return sig[0] == 0 && sig[1] == 0xFFFF && sig[2] == 0;
+}
+
+} // namespace
+
+int process_coff_archive(ObjectSource& source, std::string_view label, SymbolCollector& out, std::string& err)
+{
+    // Bookkeeping members lead the archive: first linker member (`/`), second linker member (`/`, lib.exe only) and the
+    // long name table (`//`).
+    std::uint64_t at = ar::kSignatureSize;
+    ar::Member first_index;
+    ar::Member second_index;
+    std::span<const std::uint8_t> long_names;
+    ar::Member member;
+    while (at < source.size())
+    {
+        if (!ar::read_member(source, at, member, err))
+        {
+            err = std::string(label) + ": " + err;
+            return -1;
+        }
+        if (!ar::is_special(member.name))
+        {
+            break;
+        }
+        if (member.name == "/")
+        {
+            (first_index.name.empty() ? first_index : second_index) = member;
+        }
+        else if (member.name == "//" && !source.read(member.data_offset, static_cast<std::size_t>(member.size), long_names, err))
+        {
+            return -1;
+        }
+        at = member.next();
+    }
+    const std::uint64_t first_object = at;
+
+    // Every member with a public definition is listed in the symbol index; the rest are never touched. Archives
+    // without an index (or with an empty one, e.g. written by a tool that did not recognize the members) are walked.
+    std::vector<std::uint64_t> defining;
+    bool indexed = false;
+    if (!second_index.name.empty())
+    {
+        indexed = read_second_linker_member(source, second_index, defining, err);
+    }
+    if (!indexed && !first_index.name.empty())
+    {
+        indexed = read_first_linker_member(source, first_index, defining, err);
+    }
+    if (!indexed || defining.empty())
+    {
+        defining.clear();
+        for (at = first_object; at < source.size(); at = member.next())
+        {
+            if (!ar::read_member(source, at, member, err))
+            {
+                err = std::string(label) + ": " + err;
+                return -1;
+            }
+            if (!ar::is_special(member.name))
+            {
+                defining.push_back(at);
+            }
+        }
+    }
+
+    std::string member_label;
+    for (const std::uint64_t offset : defining)
+    {
+        if (!ar::read_member(source, offset, member, err))
+        {
+            err = std::string(label) + ": " + err;
+            return -1;
+        }
+        if (ar::is_special(member.name))
+        {
+            continue;
+        }
+        SliceObjectSource object(source, member.data_offset, member.size);
+        if (is_short_import(object))
+        {
+            continue;
+        }
+        member_label.assign(label);
+        member_label += '(';
+        member_label += ar::member_name(member.name, long_names);
+        member_label += ')';
+        if (process_coff_object(object, member_label, out, err) != 0)
+        {
+            if (err.find(member_label) == std::string::npos)
+            {
+                err = member_label + ": " + err;
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
+} // namespace defgen::detail
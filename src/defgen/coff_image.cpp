@@ -5,7 +5,48 @@
 namespace defgen::detail
 {
 
-bool SCoffImage::parse_coff(SCoffHeader* header, std::string_view fileName, std::string& err)
+bool SCoffImage::read_tables(ObjectSource& source, std::size_t headerSize, std::size_t symbolSize, dword pSymbols, std::string& err)
+{
+    std::span<const byte> bytes;
+    if (!source.read(headerSize, static_cast<std::size_t>(numSections) * sizeof(SCoffSection), bytes, err))
+    {
+        return false;
+    }
+    pSections = reinterpret_cast<const SCoffSection*>(bytes.data());
+
+    // Symbol table plus the 4-byte size that opens the string table right after it.
+    const std::size_t symbolBytes = static_cast<std::size_t>(numSymbols) * symbolSize;
+    const std::uint64_t stringTableOffset = static_cast<std::uint64_t>(pSymbols) + symbolBytes;
+    const bool hasStringTable = stringTableOffset + sizeof(dword) <= source.size();
+    if (!source.read(pSymbols, symbolBytes + (hasStringTable ? sizeof(dword) : 0), bytes, err))
+    {
+        return false;
+    }
+    const byte* symbols = bytes.data();
+    stringTable = {};
+    if (hasStringTable)
+    {
+        dword stringTableSize = 0;
+        std::memcpy(&stringTableSize, symbols + symbolBytes, sizeof(dword));
+        if (stringTableSize > sizeof(dword) && !source.read(stringTableOffset, stringTableSize, stringTable, err))
+        {
+            return false;
+        }
+    }
+    if (symbolSize == sizeof(SCoffSymbol))
+    {
+        pSymbolsStd = reinterpret_cast<const SCoffSymbol*>(symbols);
+        pSymbolsBig = nullptr;
+    }
+    else
+    {
+        pSymbolsStd = nullptr;
+        pSymbolsBig = reinterpret_cast<const SCoffSymbolBigObj*>(symbols);
+    }
+    return true;
+}
+
+bool SCoffImage::parse_coff(const SCoffHeader* header, ObjectSource& source, std::string_view fileName, std::string& err)
 {
     using namespace coff;
     if (header->machine != IMAGE_FILE_MACHINE_I386 && header->machine != IMAGE_FILE_MACHINE_AMD64)
@@ -23,17 +64,14 @@ bool SCoffImage::parse_coff(SCoffHeader* header, std::string_view fileName, std:
         return false;
     }
 
-    pSections = reinterpret_cast<SCoffSection*>(&image[sizeof(SCoffHeader)]);
-    pSymbolsStd = reinterpret_cast<SCoffSymbol*>(&image[header->pSymbols]);
-    pSymbolsBig = nullptr;
-    nameOffset = static_cast<int>(header->pSymbols + header->nSymbols * sizeof(SCoffSymbol));
     numSymbols = static_cast<int>(header->nSymbols);
     numSections = static_cast<int>(header->nSections);
     timeStamp = header->timeStamp;
-    return true;
+    return read_tables(source, sizeof(SCoffHeader), sizeof(SCoffSymbol), header->pSymbols, err);
 }
 
-bool SCoffImage::parse_coff_bigobj(SCoffHeaderBigObj* header, std::string_view fileName, std::string& err)
+bool SCoffImage::parse_coff_bigobj(const SCoffHeaderBigObj* header, ObjectSource& source, std::string_view fileName,
+                                   std::string& err)
 {
     using namespace coff;
     static const unsigned char bigObjclassID[16] = {0xC7, 0xA1, 0xBA, 0xD1, 0xEE, 0xBA, 0xa9, 0x4b,
@@ -58,33 +96,37 @@ bool SCoffImage::parse_coff_bigobj(SCoffHeaderBigObj* header, std::string_view f
         }
     }
 
-    pSections = reinterpret_cast<SCoffSection*>(&image[sizeof(SCoffHeaderBigObj)]);
-    pSymbolsStd = nullptr;
-    pSymbolsBig = reinterpret_cast<SCoffSymbolBigObj*>(&image[header->pSymbols]);
-    nameOffset = static_cast<int>(header->pSymbols + header->nSymbols * sizeof(SCoffSymbolBigObj));
     numSymbols = static_cast<int>(header->nSymbols);
     numSections = static_cast<int>(header->nSections);
     timeStamp = header->timeStamp;
-    return true;
+    return read_tables(source, sizeof(SCoffHeaderBigObj), sizeof(SCoffSymbolBigObj), header->pSymbols, err);
 }
 
-bool SCoffImage::load(std::span<const std::uint8_t> data, std::string_view file_label, std::string& err)
+bool SCoffImage::load(ObjectSource& source, std::string_view file_label, std::string& err)
 {
-    image.assign(data.begin(), data.end());
-    if (image.size() < sizeof(SCoffHeader))
+    if (source.size() < sizeof(SCoffHeader))
     {
         err = "COFF file too small";
         return false;
     }
-    auto* pBigObjHeader = reinterpret_cast<SCoffHeaderBigObj*>(image.data());
-    auto* pHeader = reinterpret_cast<SCoffHeader*>(image.data());
+    std::span<const byte> head;
+    if (!source.read(0, sizeof(SCoffHeader), head, err))
+    {
+        return false;
+    }
+    auto* pHeader = reinterpret_cast<const SCoffHeader*>(head.data());
+    auto* pBigObjHeader = reinterpret_cast<const SCoffHeaderBigObj*>(head.data());
     // Same detection as legacy AT-Linker (bigobj vs normal COFF).
     if (pBigObjHeader->Sig1 == 0 && pBigObjHeader->Sig2 == 0xFFFF && pHeader->machine != coff::IMAGE_FILE_MACHINE_I386 &&
         pHeader->machine != coff::IMAGE_FILE_MACHINE_AMD64)
     {
-        return parse_coff_bigobj(pBigObjHeader, file_label, err);
+        if (!source.read(0, sizeof(SCoffHeaderBigObj), head, err))
+        {
+            return false;
+        }
+        return parse_coff_bigobj(reinterpret_cast<const SCoffHeaderBigObj*>(head.data()), source, file_label, err);
     }
-    return parse_coff(pHeader, file_label, err);
+    return parse_coff(pHeader, source, file_label, err);
 }
 
 } // namespace defgen::detail
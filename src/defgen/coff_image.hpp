@@ -1,12 +1,13 @@
 #pragma once
 
 #include "coff_pe_constants.hpp"
+#include "object_source.hpp"
 
 #include <cstdint>
 #include <cstring>
 #include <span>
 #include <string>
-#include <vector>
+#include <string_view>
 
 namespace defgen::detail
 {
@@ -106,77 +107,73 @@ struct SCoffImage
         byte unused[3];
     };
 
+    struct SCoffRelocation
+    {
+        dword dwAddress;
+        dword nSymbol;
+        word nType;
+    };
+
+    /// Short import member of an import library (`IMPORT_OBJECT_HEADER`), followed by the symbol and DLL names.
+    struct SCoffImportHeader
+    {
+        word Sig1;
+        word Sig2;
+        word Version;
+        word machine;
+        dword timeStamp;
+        dword sizeOfData;
+        word ordinalOrHint;
+        word type;
+    };
+
     dword timeStamp = 0;
     int numSymbols = 0;
     int numSections = 0;
-    int nameOffset = 0;
-    SCoffSection* pSections = nullptr;
-    std::vector<byte> image;
-
-    SCoffSymbol* pSymbolsStd = nullptr;
-    SCoffSymbolBigObj* pSymbolsBig = nullptr;
-
-    [[nodiscard]] byte GetNumAuxSymbols(int index) const
-    {
-        if (pSymbolsStd != nullptr)
-        {
-            return pSymbolsStd[index].nAuxSymbols;
-        }
-        return pSymbolsBig[index].nAuxSymbols;
-    }
+    const SCoffSection* pSections = nullptr;
+    /// String table (starts with its own 4-byte size); views are owned by the `ObjectSource` passed to `load`.
+    std::span<const byte> stringTable;
 
-    void GetSymbol(int index, SCoffSymbolBigObj* result) const
-    {
-        if (pSymbolsStd != nullptr)
-        {
-            result->nAuxSymbols = pSymbolsStd[index].nAuxSymbols;
-            result->nSection = pSymbolsStd[index].nSection;
-            result->nStorageClass = pSymbolsStd[index].nStorageClass;
-            result->nType = pSymbolsStd[index].nType;
-            result->nValue = pSymbolsStd[index].nValue;
-            std::memcpy(result->szName, pSymbolsStd[index].szName, sizeof(SCoffName));
-            return;
-        }
-        result->nAuxSymbols = pSymbolsBig[index].nAuxSymbols;
-        result->nSection = pSymbolsBig[index].nSection;
-        result->nStorageClass = pSymbolsBig[index].nStorageClass;
-        result->nType = pSymbolsBig[index].nType;
-        result->nValue = pSymbolsBig[index].nValue;
-        std::memcpy(result->szName, pSymbolsBig[index].szName, sizeof(SCoffName));
-    }
+    const SCoffSymbol* pSymbolsStd = nullptr;
+    const SCoffSymbolBigObj* pSymbolsBig = nullptr;
 
-    [[nodiscard]] byte GetSectionSelectionFromSectionDefinition(int index) const
-    {
-        if (pSymbolsStd != nullptr)
-        {
-            auto& def = *reinterpret_cast<SCoffSectionDefinition*>(&pSymbolsStd[index]);
-            return def.nSelection;
-        }
-        auto& def = *reinterpret_cast<SCoffSectionDefinitionBigObj*>(&pSymbolsBig[index]);
-        return def.nSelection;
-    }
+    [[nodiscard]] bool parse_coff(const SCoffHeader* header, ObjectSource& source, std::string_view fileName, std::string& err);
 
-    [[nodiscard]] bool parse_coff(SCoffHeader* header, std::string_view fileName, std::string& err);
+    [[nodiscard]] bool parse_coff_bigobj(const SCoffHeaderBigObj* header, ObjectSource& source, std::string_view fileName,
+                                         std::string& err);
 
-    [[nodiscard]] bool parse_coff_bigobj(SCoffHeaderBigObj* header, std::string_view fileName, std::string& err);
+    /// Fetch the header, section table, symbol table and string table from `source` and parse them in place.
+    /// Section payload is never requested; `source` must outlive the image.
+    [[nodiscard]] bool load(ObjectSource& source, std::string_view file_label, std::string& err);
 
-    /// Load COFF image from raw bytes (entire `.obj` file).
-    [[nodiscard]] bool load(std::span<const std::uint8_t> data, std::string_view file_label, std::string& err);
+    [[nodiscard]] bool read_tables(ObjectSource& source, std::size_t headerSize, std::size_t symbolSize, dword pSymbols,
+                                   std::string& err);
 };
 #pragma pack(pop)
 
-inline void GetName(const SCoffImage& image, const SCoffName& a, std::string* pRes)
+/// Name of a symbol or section record without copying: short names point into the record itself, long names into the
+/// string table. Both stay valid as long as the image's `ObjectSource`.
+[[nodiscard]] inline std::string_view GetNameView(const SCoffImage& image, const SCoffName& a)
 {
-    const int* pA = reinterpret_cast<const int*>(&a);
-    if (pA[0] != 0)
+    dword zeroes = 0;
+    std::memcpy(&zeroes, &a, sizeof(dword));
+    if (zeroes != 0)
     {
-        char szBuf[16]{};
-        static_assert(sizeof(a) < sizeof(szBuf));
-        std::memcpy(szBuf, &a, sizeof(a));
-        *pRes = szBuf;
-        return;
+        const void* end = std::memchr(a, 0, sizeof(a));
+        return {a, end != nullptr ? static_cast<std::size_t>(static_cast<const char*>(end) - a) : sizeof(a)};
     }
-    *pRes = reinterpret_cast<const char*>(&image.image[static_cast<size_t>(image.nameOffset) + static_cast<size_t>(pA[1])]);
+    dword offset = 0;
+    std::memcpy(&offset, reinterpret_cast<const char*>(&a) + sizeof(dword), sizeof(dword));
+    if (offset >= image.stringTable.size())
+    {
+        return {};
+    }
+    const char* str = reinterpret_cast<const char*>(image.stringTable.data() + offset);
+    const std::size_t limit = image.stringTable.size() - offset;
+    const void* end = std::memchr(str, 0, limit);
+    return {str, end != nullptr ? static_cast<std::size_t>(static_cast<const char*>(end) - str) : limit};
 }
 
+inline void GetName(const SCoffImage& image, const SCoffName& a, std::string* pRes) { pRes->assign(GetNameView(image, a)); }
+
 } // namespace defgen::detail
@@ -0,0 +1,178 @@
+#include "defgen/defgen.hpp"
+#include "ar_archive.hpp"
+#include "coff_image.hpp"
+#include "object_source.hpp"
+
+#include <cctype>
+#include <cstring>
+#include <string_view>
+
+namespace defgen
+{
+
+namespace
+{
+
+using namespace detail;
+using namespace coff;
+
+using Header = SCoffImage::SCoffHeader;
+using HeaderBigObj = SCoffImage::SCoffHeaderBigObj;
+using Section = SCoffImage::SCoffSection;
+
+/// Where a COFF object keeps its section table.
+struct ObjectHeader
+{
+    std::uint16_t machine = 0;
+    std::uint64_t sections_offset = 0;
+    std::uint32_t section_count = 0;
+};
+
+/// Read the file header of the COFF object in `source`. False for an archive, an import member, another machine or
+/// anything else that is not an object.
+[[nodiscard]] bool read_object_header(ObjectSource& source, ObjectHeader& out)
+{
+    std::string err;
+    std::span<const std::uint8_t> head;
+    if (source.size() < sizeof(HeaderBigObj) || !source.read(0, sizeof(HeaderBigObj), head, err) || ar::is_archive(source))
+    {
+        return false;
+    }
+    HeaderBigObj big{};
+    std::memcpy(&big, head.data(), sizeof(big));
+    if (big.Sig1 == 0 && big.Sig2 == 0xFFFF)
+    {
+        // Version 0 and 1 are short import members and anonymous objects; bigobj starts at 2.
+        if (big.Version < 2)
+        {
+            return false;
+        }
+        out = {big.machine, sizeof(HeaderBigObj), big.nSections};
+    }
+    else
+    {
+        Header header{};
+        std::memcpy(&header, head.data(), sizeof(header));
+        out = {header.machine, sizeof(Header) + std::uint64_t{header.nOptionalHeaderSize}, header.nSections};
+    }
+    return out.machine == IMAGE_FILE_MACHINE_I386 || out.machine == IMAGE_FILE_MACHINE_AMD64 || out.machine == 0xAA64;
+}
+
+/// True if the linker directives `text` contain `/EXPORT:` (or `-export:`, in any case).
+[[nodiscard]] bool passes_export(std::string_view text)
+{
+    constexpr std::string_view kOption = "EXPORT:";
+    std::size_t at = 0;
+    while (at < text.size())
+    {
+        while (at < text.size() && (std::isspace(static_cast<unsigned char>(text[at])) != 0 || text[at] == '"'))
+        {
+            ++at;
+        }
+        std::size_t end = at;
+        while (end < text.size() && std::isspace(static_cast<unsigned char>(text[end])) == 0)
+        {
+            ++end;
+        }
+        const std::string_view token = text.substr(at, end - at);
+        if (token.size() > kOption.size() && (token[0] == '/' || token[0] == '-'))
+        {
+            bool match = true;
+            for (std::size_t i = 0; i < kOption.size() && match; ++i)
+            {
+                match = std::toupper(static_cast<unsigned char>(token[i + 1])) == kOption[i];
+            }
+            if (match)
+            {
+                return true;
+            }
+        }
+        at = end;
+    }
+    return false;
+}
+
+/// True if a `.drectve` section of the object described by `header` passes `/EXPORT:` to the linker.
+[[nodiscard]] bool has_export_directive(ObjectSource& source, const ObjectHeader& header)
+{
+    std::string err;
+    std::span<const std::uint8_t> table;
+    const std::uint64_t table_size = std::uint64_t{header.section_count} * sizeof(Section);
+    if (header.sections_offset + table_size > source.size() ||
+        !source.read(header.sections_offset, static_cast<std::size_t>(table_size), table, err))
+    {
+        return false;
+    }
+    for (std::uint32_t i = 0; i < header.section_count; ++i)
+    {
+        Section section{};
+        std::memcpy(&section, table.data() + std::size_t{i} * sizeof(Section), sizeof(section));
+        if (std::memcmp(section.szName, ".drectve", 8) != 0 || std::uint64_t{section.pData} + section.dwSize > source.size())
+        {
+            continue;
+        }
+        std::span<const std::uint8_t> text;
+        if (source.read(section.pData, section.dwSize, text, err) &&
+            passes_export({reinterpret_cast<const char*>(text.data()), text.size()}))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Fold the object in `source` into `out`; true once nothing more is to be learned.
+[[nodiscard]] bool inspect_object(ObjectSource& source, bool read_directives, CoffLinkInputs& out)
+{
+    ObjectHeader header;
+    if (!read_object_header(source, header))
+    {
+        return false;
+    }
+    if (out.machine == 0)
+    {
+        out.machine = header.machine;
+    }
+    if (read_directives && !out.export_directives)
+    {
+        out.export_directives = has_export_directive(source, header);
+    }
+    return !read_directives || out.export_directives;
+}
+
+} // namespace
+
+CoffLinkInputs inspect_coff_inputs(const std::vector<std::filesystem::path>& object_files, bool read_directives)
+{
+    CoffLinkInputs out;
+    for (const std::filesystem::path& path : object_files)
+    {
+        std::string err;
+        const std::unique_ptr<ObjectSource> source = open_object_source(path, LoadMode::Ranged, err);
+        if (!source)
+        {
+            continue;
+        }
+        if (!ar::is_archive(*source))
+        {
+            if (inspect_object(*source, read_directives, out))
+            {
+                break;
+            }
+            continue;
+        }
+        // Every member of a `/DEFLIB:` library is linked, since the `.def` exports its public symbols.
+        ar::Member member;
+        for (std::uint64_t at = ar::kSignatureSize; at < source->size() && ar::read_member(*source, at, member, err); at = member.next())
+        {
+            SliceObjectSource object(*source, member.data_offset, member.size);
+            if (!ar::is_special(member.name) && inspect_object(object, read_directives, out))
+            {
+                return out;
+            }
+        }
+    }
+    return out;
+}
+
+} // namespace defgen
@@ -1,12 +1,10 @@
 #include "coff_image.hpp"
+#include "name_kernels.hpp"
+#include "parsers.hpp"
 
-#include <algorithm>
-#include <cctype>
+#include <cstdint>
 #include <cstring>
-#include <filesystem>
-#include <fstream>
-#include <sstream>
-#include <string>
+#include <string_view>
 #include <vector>
 
 namespace defgen::detail
@@ -17,125 +15,117 @@ namespace
 
 using namespace coff;
 
-[[nodiscard]] std::string get_export_name(const std::string& szName)
+[[nodiscard]] std::string_view get_export_name(std::string_view szName)
 {
-    bool alnum_only = true;
-    for (char c : szName)
-    {
-        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
-        {
-            alnum_only = false;
-            break;
-        }
-    }
-    if (alnum_only && !szName.empty() && szName[0] == '_')
+    if (!szName.empty() && szName[0] == '_' && is_identifier(szName))
     {
         return szName.substr(1);
     }
     return szName;
 }
 
-[[nodiscard]] bool starts_with(const std::string& sz, const char* prefix)
+[[nodiscard]] bool starts_with(std::string_view sz, std::string_view prefix)
 {
-    const std::size_t n = std::strlen(prefix);
-    return sz.size() > n && std::strncmp(sz.c_str(), prefix, n) == 0;
+    return sz.size() > prefix.size() && sz.compare(0, prefix.size(), prefix) == 0;
 }
 
-void gather_public_symbols(SCoffImage* p, std::vector<std::string>* pResFunc, std::vector<std::string>* pResData)
+/// Per-section COMDAT state, filled in while scanning.
+enum SectionState : std::uint8_t
+{
+    SectionUnresolved = 0,
+    /// A `.text` section definition with `IMAGE_COMDAT_SELECT_NODUPLICATES` was seen for this section.
+    SectionNoDuplicates = 1
+};
+
+/// A function defined in a COMDAT section whose `.text` definition had not been seen yet when the symbol was reached.
+struct PendingFunction
+{
+    std::uint32_t section;
+    std::string_view name;
+};
+
+/// One pass over the symbol table, instantiated once per record layout so the loop has no per-symbol layout branch
+/// or record copy. Data exports are emitted directly; functions in COMDAT sections are emitted as soon as their
+/// section is known to be NODUPLICATES, and the rare ones that precede their section definition are checked at the end.
+template <typename TSymbol, typename TSectionDefinition>
+void scan_public_symbols(const SCoffImage& image, const TSymbol* symbols, SymbolCollector& out)
 {
-    std::vector<char> sections(static_cast<size_t>(p->numSections), 0);
+    static_assert(sizeof(TSymbol) == sizeof(TSectionDefinition), "aux records share the symbol record size");
+
+    const auto numSections = static_cast<std::uint32_t>(image.numSections);
+    std::vector<std::uint8_t> sections(numSections, SectionUnresolved);
+    std::vector<PendingFunction> pending;
 
-    for (int k = 0; k < p->numSymbols; k += p->GetNumAuxSymbols(k) + 1)
+    const int numSymbols = image.numSymbols;
+    for (int k = 0; k < numSymbols; k += symbols[k].nAuxSymbols + 1)
     {
-        SCoffImage::SCoffSymbolBigObj symb{};
-        p->GetSymbol(k, &symb);
-        int nSection = static_cast<int>(symb.nSection);
-        if (nSection > 0 && nSection <= static_cast<int>(sections.size()))
+        const TSymbol& symb = symbols[k];
+        const auto nSection = static_cast<std::uint32_t>(symb.nSection);
+        if (nSection == 0 || nSection > numSections)
+        {
+            continue;
+        }
+        if (symb.nStorageClass == IMAGE_SYM_CLASS_EXTERNAL)
         {
-            if (symb.nType == 0 && symb.nStorageClass == IMAGE_SYM_CLASS_EXTERNAL)
+            if (symb.nType == 0)
             {
-                std::string szName;
-                GetName(*p, symb.szName, &szName);
-                if (starts_with(szName, "??"))
+                const std::string_view name = GetNameView(image, symb.szName);
+                if (!starts_with(name, "??") && !starts_with(name, "__real"))
                 {
-                    continue;
+                    out.add(get_export_name(name), SymbolData);
                 }
-                if (starts_with(szName, "__real"))
-                {
-                    continue;
-                }
-                pResData->push_back(get_export_name(szName));
             }
-            if (std::strncmp(symb.szName, ".text", 5) == 0 && symb.nAuxSymbols >= 1 && symb.nStorageClass == IMAGE_SYM_CLASS_STATIC)
+            else if (symb.nType == 0x20)
             {
-                byte nSelection = p->GetSectionSelectionFromSectionDefinition(k + 1);
-                if (nSelection == IMAGE_COMDAT_SELECT_NODUPLICATES)
+                const std::string_view name = GetNameView(image, symb.szName);
+                if ((image.pSections[nSection - 1].flags & IMAGE_SCN_LNK_COMDAT) == 0 || sections[nSection - 1] == SectionNoDuplicates)
+                {
+                    out.add(get_export_name(name), SymbolFunction);
+                }
+                else
                 {
-                    sections[static_cast<size_t>(nSection - 1)] = 1;
+                    pending.push_back({nSection, name});
                 }
             }
         }
+        else if (symb.nStorageClass == IMAGE_SYM_CLASS_STATIC && symb.nAuxSymbols >= 1 && k + 1 < numSymbols &&
+                 std::strncmp(symb.szName, ".text", 5) == 0)
+        {
+            const auto& def = reinterpret_cast<const TSectionDefinition&>(symbols[k + 1]);
+            if (def.nSelection == IMAGE_COMDAT_SELECT_NODUPLICATES)
+            {
+                sections[nSection - 1] = SectionNoDuplicates;
+            }
+        }
     }
 
-    for (int k = 0; k < p->numSymbols; k += p->GetNumAuxSymbols(k) + 1)
+    for (const PendingFunction& f : pending)
     {
-        SCoffImage::SCoffSymbolBigObj symb{};
-        p->GetSymbol(k, &symb);
-        int nSection = static_cast<int>(symb.nSection);
-        if (nSection > 0 && nSection <= static_cast<int>(sections.size()) && symb.nType == 0x20 &&
-            symb.nStorageClass == IMAGE_SYM_CLASS_EXTERNAL)
+        if (sections[f.section - 1] == SectionNoDuplicates)
         {
-            if ((p->pSections[nSection - 1].flags & IMAGE_SCN_LNK_COMDAT) != 0)
-            {
-                if (sections[static_cast<size_t>(nSection - 1)] == 0)
-                {
-                    continue;
-                }
-            }
-            std::string szName;
-            GetName(*p, symb.szName, &szName);
-            pResFunc->push_back(get_export_name(szName));
+            out.add(get_export_name(f.name), SymbolFunction);
         }
     }
 }
 
-[[nodiscard]] bool read_file_bytes(const std::filesystem::path& p, std::vector<std::uint8_t>& out, std::string& err)
+void gather_public_symbols(const SCoffImage& image, SymbolCollector& out)
 {
-    std::ifstream f(p, std::ios::binary);
-    if (!f)
-    {
-        err = "cannot open object file";
-        return false;
-    }
-    f.seekg(0, std::ios::end);
-    const auto sz = f.tellg();
-    if (sz < 0)
+    if (image.pSymbolsStd != nullptr)
     {
-        err = "cannot size object file";
-        return false;
+        scan_public_symbols<SCoffImage::SCoffSymbol, SCoffImage::SCoffSectionDefinition>(image, image.pSymbolsStd, out);
     }
-    f.seekg(0);
-    out.resize(static_cast<size_t>(sz));
-    if (sz > 0)
+    else if (image.pSymbolsBig != nullptr)
     {
-        f.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(sz));
+        scan_public_symbols<SCoffImage::SCoffSymbolBigObj, SCoffImage::SCoffSectionDefinitionBigObj>(image, image.pSymbolsBig, out);
     }
-    return true;
 }
 
 } // namespace
 
-[[nodiscard]] int process_coff_object(const std::filesystem::path& path, std::vector<std::string>& export_funcs,
-                                      std::vector<std::string>& export_data, std::string& err)
+[[nodiscard]] int process_coff_object(ObjectSource& source, std::string_view label, SymbolCollector& out, std::string& err)
 {
-    std::vector<std::uint8_t> bytes;
-    if (!read_file_bytes(path, bytes, err))
-    {
-        return -1;
-    }
     SCoffImage src{};
-    const std::string label = path.filename().string();
-    if (!src.load(bytes, label, err))
+    if (!src.load(source, label, err))
     {
         return -1;
     }
@@ -144,7 +134,7 @@ void gather_public_symbols(SCoffImage* p, std::vector<std::string>* pResFunc, st
         // Legacy: skip placeholder objects with zero timestamp.
         return 0;
     }
-    gather_public_symbols(&src, &export_funcs, &export_data);
+    gather_public_symbols(src, out);
     return 0;
 }
 
@@ -9,11 +9,36 @@ namespace defgen::coff
 inline constexpr std::uint16_t IMAGE_FILE_MACHINE_I386 = 0x014c;
 inline constexpr std::uint16_t IMAGE_FILE_MACHINE_AMD64 = 0x8664;
 
+inline constexpr std::uint16_t IMAGE_FILE_32BIT_MACHINE = 0x0100;
+
 inline constexpr std::uint8_t IMAGE_SYM_CLASS_EXTERNAL = 2;
 inline constexpr std::uint8_t IMAGE_SYM_CLASS_STATIC = 3;
+inline constexpr std::uint8_t IMAGE_SYM_CLASS_SECTION = 0x68;
+
+inline constexpr std::uint16_t IMAGE_SYM_DTYPE_FUNCTION = 0x20;
 
+inline constexpr std::uint32_t IMAGE_SCN_CNT_CODE = 0x00000020;
+inline constexpr std::uint32_t IMAGE_SCN_CNT_INITIALIZED_DATA = 0x00000040;
+inline constexpr std::uint32_t IMAGE_SCN_LNK_INFO = 0x00000200;
+inline constexpr std::uint32_t IMAGE_SCN_LNK_REMOVE = 0x00000800;
 inline constexpr std::uint32_t IMAGE_SCN_LNK_COMDAT = 0x00001000;
+inline constexpr std::uint32_t IMAGE_SCN_ALIGN_1BYTES = 0x00100000;
+inline constexpr std::uint32_t IMAGE_SCN_ALIGN_2BYTES = 0x00200000;
+inline constexpr std::uint32_t IMAGE_SCN_ALIGN_4BYTES = 0x00300000;
+inline constexpr std::uint32_t IMAGE_SCN_ALIGN_8BYTES = 0x00400000;
+inline constexpr std::uint32_t IMAGE_SCN_LNK_NRELOC_OVFL = 0x01000000;
+inline constexpr std::uint32_t IMAGE_SCN_MEM_EXECUTE = 0x20000000;
+inline constexpr std::uint32_t IMAGE_SCN_MEM_READ = 0x40000000;
+inline constexpr std::uint32_t IMAGE_SCN_MEM_WRITE = 0x80000000;
+
+inline constexpr std::uint16_t IMAGE_REL_I386_DIR32NB = 0x0007;
+inline constexpr std::uint16_t IMAGE_REL_AMD64_ADDR32NB = 0x0003;
 
 inline constexpr std::uint8_t IMAGE_COMDAT_SELECT_NODUPLICATES = 1;
 
+inline constexpr std::uint16_t IMPORT_OBJECT_CODE = 0;
+inline constexpr std::uint16_t IMPORT_OBJECT_ORDINAL = 0;
+inline constexpr std::uint16_t IMPORT_OBJECT_NAME = 1;
+inline constexpr std::uint16_t IMPORT_OBJECT_NAME_NO_PREFIX = 2;
+
 } // namespace defgen::coff
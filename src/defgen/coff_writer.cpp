@@ -0,0 +1,157 @@
+#include "coff_writer.hpp"
+#include "name_kernels.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+
+namespace defgen::detail
+{
+
+void set_coff_name(SCoffName& field, std::string_view name, std::string& strings)
+{
+    std::memset(field, 0, sizeof(SCoffName));
+    if (name.size() <= sizeof(SCoffName))
+    {
+        std::memcpy(field, name.data(), name.size());
+        return;
+    }
+    const auto offset = static_cast<dword>(strings.size());
+    std::memcpy(reinterpret_cast<char*>(field) + sizeof(dword), &offset, sizeof(dword));
+    strings.append(name);
+    strings.push_back('\0');
+}
+
+void append_string_table(std::vector<std::uint8_t>& out, std::string& strings)
+{
+    const auto size = static_cast<dword>(strings.size());
+    std::memcpy(strings.data(), &size, sizeof(dword));
+    out.insert(out.end(), strings.begin(), strings.end());
+}
+
+void def_symbol_name(std::string_view name, std::uint16_t machine, std::string& out)
+{
+    out.clear();
+    if (machine == coff::IMAGE_FILE_MACHINE_I386 && is_identifier(name))
+    {
+        out.push_back('_');
+    }
+    out.append(name);
+}
+
+std::uint16_t image_relative_relocation(std::uint16_t machine)
+{
+    switch (machine)
+    {
+    case coff::IMAGE_FILE_MACHINE_AMD64:
+        return coff::IMAGE_REL_AMD64_ADDR32NB;
+    case coff::IMAGE_FILE_MACHINE_I386:
+        return coff::IMAGE_REL_I386_DIR32NB;
+    default:
+        return 0;
+    }
+}
+
+Errc lay_out_export_table(const DefExports& def, ExportTable& out, std::string& message)
+{
+    const std::vector<DefExport>& exports = def.exports;
+    out.ordinals.assign(exports.size(), 0);
+    std::uint32_t highest = 0;
+    for (const DefExport& e : exports)
+    {
+        highest = std::max<std::uint32_t>(highest, e.ordinal);
+    }
+    out.base = exports.empty() ? 1 : 0xFFFF;
+    for (std::size_t i = 0; i < exports.size(); i++)
+    {
+        out.ordinals[i] = exports[i].ordinal != 0 ? exports[i].ordinal : ++highest;
+        out.base = std::min(out.base, out.ordinals[i]);
+    }
+    if (highest > 0xFFFF)
+    {
+        message = std::to_string(exports.size()) + " exports do not fit below ordinal 65535";
+        return Errc::InvalidArgument;
+    }
+    out.functions = exports.empty() ? 0 : highest - out.base + 1;
+    out.slots.assign(out.functions, 0);
+    for (std::size_t i = 0; i < exports.size(); i++)
+    {
+        std::uint32_t& slot = out.slots[out.ordinals[i] - out.base];
+        if (slot != 0)
+        {
+            message = "ordinal " + std::to_string(out.ordinals[i]) + " is used twice";
+            return Errc::Parse;
+        }
+        slot = static_cast<std::uint32_t>(i) + 1;
+    }
+
+    // The loader binary-searches the name pointer table, so it must be in byte order whatever the `.def` order was.
+    out.by_name.resize(exports.size());
+    std::iota(out.by_name.begin(), out.by_name.end(), 0u);
+    std::sort(out.by_name.begin(), out.by_name.end(), [&](std::uint32_t a, std::uint32_t b) { return exports[a].name < exports[b].name; });
+    for (std::size_t i = 1; i < out.by_name.size(); i++)
+    {
+        if (exports[out.by_name[i - 1]].name == exports[out.by_name[i]].name)
+        {
+            message = std::string(exports[out.by_name[i]].name) + " is exported twice";
+            return Errc::Parse;
+        }
+    }
+    std::erase_if(out.by_name, [&](std::uint32_t i) { return exports[i].noname; });
+    return Errc::Ok;
+}
+
+SCoffImage::SCoffSection stamp_section(std::uint32_t offset, std::uint32_t size)
+{
+    SCoffImage::SCoffSection section{};
+    std::memcpy(section.szName, kStampSection, sizeof(kStampSection) - 1);
+    section.dwSize = size;
+    section.pData = offset;
+    section.flags = coff::IMAGE_SCN_LNK_INFO | coff::IMAGE_SCN_LNK_REMOVE | coff::IMAGE_SCN_ALIGN_1BYTES;
+    return section;
+}
+
+bool coff_stamp_matches(ObjectSource& source, std::string_view stamp)
+{
+    using Header = SCoffImage::SCoffHeader;
+    using Section = SCoffImage::SCoffSection;
+    std::string err;
+    std::span<const std::uint8_t> bytes;
+    if (source.size() < sizeof(Header) || !source.read(0, sizeof(Header), bytes, err))
+    {
+        return false;
+    }
+    Header header{};
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+    if (header.nOptionalHeaderSize != 0 || !source.read(sizeof(Header), header.nSections * sizeof(Section), bytes, err))
+    {
+        return false;
+    }
+    for (word i = 0; i < header.nSections; i++)
+    {
+        Section section{};
+        std::memcpy(&section, bytes.data() + i * sizeof(Section), sizeof(Section));
+        if (std::strncmp(section.szName, kStampSection, sizeof(SCoffName)) == 0)
+        {
+            return section.dwSize == stamp.size() && source.read(section.pData, section.dwSize, bytes, err) &&
+                   std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()) == stamp;
+        }
+    }
+    return false;
+}
+
+Errc write_def_output(const std::filesystem::path& def_path, const std::filesystem::path& out_path, const ExportObjectOptions& options,
+                      std::string_view tag, ExportOutputCheck check, DefOutputBuilder build, bool& unchanged, std::string& message)
+{
+    char machine[8] = {};
+    std::snprintf(machine, sizeof(machine), "%04x", options.machine);
+    const std::string target = std::string(machine) + ' ' + options.dll_name;
+    return write_export_output(
+        def_path, out_path, tag, target, read_def_exports, check,
+        [&](const DefExports& def, std::string_view stamp, std::vector<std::uint8_t>& out, std::string& msg) {
+            return build(def, options, stamp, out, msg);
+        },
+        unchanged, message);
+}
+
+} // namespace defgen::detail
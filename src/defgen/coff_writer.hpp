@@ -0,0 +1,82 @@
+#pragma once
+
+#include "coff_image.hpp"
+#include "def_file.hpp"
+#include "defgen/defgen.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// COFF output built from a `.def`, shared by `write_export_object` and `write_import_library`.
+
+/// Store `value` at `offset` of `out` (already that large).
+template <typename T> void put_le(std::vector<std::uint8_t>& out, std::size_t offset, T value)
+{
+    std::memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+/// Append the bytes of a packed on-disk record.
+template <typename T> void append_record(std::vector<std::uint8_t>& out, const T& record)
+{
+    const auto* p = reinterpret_cast<const std::uint8_t*>(&record);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+/// Fill a symbol or section name field: inline up to 8 bytes, otherwise as an offset into `strings`, the string table
+/// being built (it starts with room for its 4-byte size; see `append_string_table`).
+void set_coff_name(SCoffName& field, std::string_view name, std::string& strings);
+
+/// Patch the size of `strings` into its first 4 bytes and append it.
+void append_string_table(std::vector<std::uint8_t>& out, std::string& strings);
+
+/// Symbol `link.exe` binds a `.def` name to: on x86 a C name gets its leading underscore back (the inverse of how
+/// `generate_def` derived the name); decorated names are taken as they are.
+void def_symbol_name(std::string_view name, std::uint16_t machine, std::string& out);
+
+/// Image-relative 32-bit relocation type for `machine` (`ADDR32NB` / `DIR32NB`); 0 for machines not supported.
+[[nodiscard]] std::uint16_t image_relative_relocation(std::uint16_t machine);
+
+/// Ordinals and name table order of a `.def`'s exports, as the linker lays out the export table.
+struct ExportTable
+{
+    std::uint32_t base = 1;
+    /// Export address table entries: highest ordinal - `base` + 1.
+    std::uint32_t functions = 0;
+    /// Ordinal of each export, in `.def` order. Entries without `@N` follow the highest explicit one.
+    std::vector<std::uint32_t> ordinals;
+    /// Export index + 1 per address table entry (0 = unused ordinal).
+    std::vector<std::uint32_t> slots;
+    /// Named exports in name pointer table order (byte order). The position of an export is its import hint.
+    std::vector<std::uint32_t> by_name;
+};
+
+/// `Errc::Parse` for duplicate names or ordinals, `Errc::InvalidArgument` when the exports need ordinals past 65535.
+[[nodiscard]] Errc lay_out_export_table(const DefExports& def, ExportTable& out, std::string& message);
+
+/// Section that records what an output was built from, so a current one is recognised without rebuilding it.
+/// `IMAGE_SCN_LNK_INFO | IMAGE_SCN_LNK_REMOVE`: linkers drop it.
+constexpr char kStampSection[] = ".defgen";
+
+/// Header of a stamp section of `size` bytes stored at `offset`.
+[[nodiscard]] SCoffImage::SCoffSection stamp_section(std::uint32_t offset, std::uint32_t size);
+
+/// True if the COFF object in `source` has a stamp section holding `stamp`. Reads its headers and the stamp only.
+[[nodiscard]] bool coff_stamp_matches(ObjectSource& source, std::string_view stamp);
+
+/// Lays out the output for `def`, embedding `stamp`.
+using DefOutputBuilder = Errc (*)(const DefExports& def, const ExportObjectOptions& options, std::string_view stamp,
+                                  std::vector<std::uint8_t>& out, std::string& message);
+
+/// `write_export_output` for a `.def`, with `<machine> <dll name>` as the stamp target.
+[[nodiscard]] Errc write_def_output(const std::filesystem::path& def_path, const std::filesystem::path& out_path,
+                                    const ExportObjectOptions& options, std::string_view tag, ExportOutputCheck check,
+                                    DefOutputBuilder build, bool& unchanged, std::string& message);
+
+} // namespace defgen::detail
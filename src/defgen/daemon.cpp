@@ -0,0 +1,431 @@
+#include "defgen/defgen.hpp"
+#include "ar_archive.hpp"
+#include "daemon_protocol.hpp"
+#include "export_lines.hpp"
+#include "file_util.hpp"
+#include "ignore_matcher.hpp"
+#include "local_socket.hpp"
+#include "name_sort.hpp"
+#include "object_source.hpp"
+#include "ordinal_db.hpp"
+#include "parsers.hpp"
+#include "resident_store.hpp"
+#include "symbol_pool.hpp"
+#include "work_stealing.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+
+namespace defgen
+{
+
+namespace
+{
+
+/// `s` is a generic (forward-slash) spelling of an absolute path.
+[[nodiscard]] bool is_absolute_generic(std::string_view s)
+{
+#ifdef _WIN32
+    return s.starts_with("//") || (s.size() >= 3 && s[1] == ':' && s[2] == '/');
+#else
+    return s.starts_with('/');
+#endif
+}
+
+/// Request state: the store of parsed objects plus the last few full results, so a repeated request over objects
+/// that are all resident and unchanged is answered without merging or sorting anything.
+class ExportDaemon
+{
+  public:
+    explicit ExportDaemon(const DaemonOptions& options)
+        : store_(options.memory_budget)
+        , threads_(detail::resolve_thread_count(options.thread_count))
+    {
+    }
+
+    [[nodiscard]] detail::DaemonReply generate(const detail::DaemonRequest& request);
+
+    [[nodiscard]] DaemonStats stats() const
+    {
+        DaemonStats s;
+        s.resident_objects = store_.size();
+        s.resident_bytes = store_.bytes();
+        s.memory_budget = store_.budget();
+        s.evictions = store_.evictions();
+        s.requests = requests_;
+        return s;
+    }
+
+  private:
+    struct CachedResult
+    {
+        std::uint64_t fingerprint = 0;
+        /// Store generation the result was built at.
+        std::uint64_t generation = 0;
+        std::uint64_t output_hash = 0;
+        std::vector<std::string> lines;
+    };
+
+    static constexpr std::size_t kCachedResults = 8;
+
+    [[nodiscard]] bool parse_pending(const std::vector<std::filesystem::path>& paths, const std::vector<std::string>& keys,
+                                     const std::vector<detail::FileIdentity>& identities, const std::vector<std::size_t>& pending,
+                                     ObjectFormat format, std::vector<const detail::ResidentObject*>& objects, std::string& err);
+
+    detail::ResidentStore store_;
+    unsigned threads_;
+    std::size_t requests_ = 0;
+    /// Most recently used first.
+    std::vector<CachedResult> results_;
+};
+
+bool ExportDaemon::parse_pending(const std::vector<std::filesystem::path>& paths, const std::vector<std::string>& keys,
+                                 const std::vector<detail::FileIdentity>& identities, const std::vector<std::size_t>& pending,
+                                 ObjectFormat format, std::vector<const detail::ResidentObject*>& objects, std::string& err)
+{
+    // Largest first; the reported error is the lowest failing input index, as in `generate_def`.
+    std::vector<std::size_t> order(pending.size());
+    for (std::size_t slot = 0; slot < order.size(); slot++)
+    {
+        order[slot] = slot;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::size_t a, std::size_t b) { return identities[pending[a]].size > identities[pending[b]].size; });
+
+    std::vector<detail::ResidentObject> parsed(pending.size());
+    std::vector<char> parsed_ok(pending.size(), 0);
+    std::vector<std::string> errors(pending.size());
+    std::atomic<std::size_t> first_failed{pending.size()};
+    detail::SymbolPool pool;
+
+    const auto threads = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(threads_, pending.size())));
+    detail::run_work_stealing(order, threads, [&](unsigned, std::size_t slot) {
+        if (slot > first_failed.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        const std::size_t i = pending[slot];
+        std::string parse_err;
+        const std::unique_ptr<detail::ObjectSource> source = detail::open_object_source(paths[i], LoadMode::Mapped, parse_err);
+        std::vector<detail::TracedSymbol> traced;
+        detail::SymbolCollector collector(pool);
+        collector.trace = &traced;
+        if (source && detail::parse_object(paths[i], detail::resolve_object_format(paths[i], format), *source, collector, parse_err) == 0)
+        {
+            detail::ResidentObject& object = parsed[slot];
+            object.identity = identities[i];
+            for (const detail::TracedSymbol& s : traced)
+            {
+                if (s.kind == detail::SymbolFunction)
+                {
+                    object.names.push_back({s.name->hash, static_cast<std::uint32_t>(object.text.size()), s.name->size});
+                    object.text += s.name->view();
+                }
+            }
+            object.text.shrink_to_fit();
+            object.names.shrink_to_fit();
+            parsed_ok[slot] = 1;
+            return;
+        }
+        errors[slot] = std::move(parse_err);
+        std::size_t prev = first_failed.load(std::memory_order_relaxed);
+        while (slot < prev && !first_failed.compare_exchange_weak(prev, slot, std::memory_order_relaxed))
+        {
+        }
+    });
+
+    // Keep whatever did parse, even when the request fails: the next attempt only re-parses the broken object.
+    for (std::size_t slot = 0; slot < pending.size(); slot++)
+    {
+        if (parsed_ok[slot] != 0)
+        {
+            objects[pending[slot]] = &store_.insert(keys[pending[slot]], std::move(parsed[slot]));
+        }
+    }
+    const std::size_t failed = first_failed.load();
+    if (failed < pending.size())
+    {
+        err = std::move(errors[failed]);
+        return false;
+    }
+    return true;
+}
+
+detail::DaemonReply ExportDaemon::generate(const detail::DaemonRequest& request)
+{
+    detail::DaemonReply reply;
+    ++requests_;
+    const std::size_t count = request.object_files.size();
+
+    // Key = resolved format + absolute path, so clients in different directories share entries. The path is not
+    // normalized (`lexically_normal` would dominate a no-change request); a build names an object the same way each time.
+    std::vector<std::filesystem::path> paths(count);
+    std::vector<std::string> keys(count);
+    std::string fingerprint_text;
+    const std::uint64_t settings = manifest_settings_hash(request.format, request.options);
+    fingerprint_text.append(reinterpret_cast<const char*>(&settings), sizeof(settings));
+    for (std::size_t i = 0; i < count; i++)
+    {
+        const std::string& file = request.object_files[i];
+        std::string absolute = is_absolute_generic(file) ? file : request.working_dir + '/' + file;
+        paths[i] = detail::path_from_key(absolute);
+        keys[i] = static_cast<char>('0' + static_cast<int>(detail::resolve_object_format(paths[i], request.format)));
+        keys[i] += absolute;
+        fingerprint_text += keys[i];
+        fingerprint_text += '\0';
+    }
+    const std::uint64_t fingerprint = detail::Xxh64::hash(fingerprint_text);
+
+    // One stat per object is the whole cost of a no-change request; spread it over the pool.
+    std::vector<detail::FileIdentity> identities(count);
+    std::vector<char> stat_ok(count, 0);
+    {
+        std::vector<std::size_t> order(count);
+        for (std::size_t i = 0; i < count; i++)
+        {
+            order[i] = i;
+        }
+        const auto threads = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(threads_, count / 256)));
+        detail::run_work_stealing(order, threads,
+                                  [&](unsigned, std::size_t i) { stat_ok[i] = detail::stat_file_identity(paths[i], identities[i]) ? 1 : 0; });
+    }
+
+    std::vector<const detail::ResidentObject*> objects(count, nullptr);
+    std::vector<std::size_t> pending;
+    std::unordered_set<std::string_view> pending_keys;
+    std::uint64_t newest = 0;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        // A thin archive's members are other files, so its own identity cannot vouch for the resident symbols.
+        const detail::ResidentObject* object =
+            stat_ok[i] != 0 && !detail::ar::is_thin_archive_file(paths[i]) ? store_.find(keys[i], identities[i]) : nullptr;
+        if (object != nullptr)
+        {
+            objects[i] = object;
+            newest = std::max(newest, object->generation);
+        }
+        else if (pending_keys.insert(keys[i]).second)
+        {
+            // Unreadable objects are parsed too, so the failure is reported with the parser's message.
+            pending.push_back(i);
+        }
+    }
+    reply.objects_parsed = pending.size();
+    reply.objects_resident = count - pending.size();
+
+    if (!pending.empty() && !parse_pending(paths, keys, identities, pending, request.format, objects, reply.message))
+    {
+        reply.ec = Errc::Parse;
+        store_.trim();
+        return reply;
+    }
+
+    // Ordinal output also depends on the database, which may have changed (or been deleted) since: never reused.
+    auto cached = results_.end();
+    if (pending.empty() && request.options.ordinal_database.empty())
+    {
+        cached = std::find_if(results_.begin(), results_.end(), [&](const CachedResult& r) {
+            return r.fingerprint == fingerprint && r.generation >= newest;
+        });
+    }
+    if (cached == results_.end())
+    {
+        detail::SymbolPool pool;
+        detail::SymbolCollector collector(pool);
+        for (const detail::ResidentObject* object : objects)
+        {
+            if (object == nullptr)
+            {
+                continue;
+            }
+            for (const detail::ResidentObject::Name& n : object->names)
+            {
+                collector.add(object->name(n), n.hash, detail::SymbolFunction);
+            }
+        }
+        detail::sort_names(collector.funcs, threads_);
+
+        const detail::IgnoreMatcher ignores(request.options.ignore_substrings);
+        std::vector<std::string_view> filtered;
+        filtered.reserve(collector.funcs.size());
+        for (const detail::SymbolHandle name : collector.funcs)
+        {
+            if (!ignores.matches(name->view()))
+            {
+                filtered.push_back(name->view());
+            }
+        }
+
+        std::vector<detail::ExportOrdinal> ordinals;
+        std::size_t ordinals_added = 0;
+        if (!detail::assign_export_ordinals(filtered, request.options, ordinals, ordinals_added, reply.message))
+        {
+            reply.ec = Errc::InvalidArgument;
+            store_.trim();
+            return reply;
+        }
+
+        CachedResult result;
+        result.fingerprint = fingerprint;
+        result.generation = store_.generation();
+        detail::append_export_lines(filtered, request.options, result.lines, ordinals);
+        result.output_hash = detail::hash_export_lines(result.lines);
+        results_.erase(std::remove_if(results_.begin(), results_.end(), [&](const CachedResult& r) { return r.fingerprint == fingerprint; }),
+                       results_.end());
+        if (results_.size() >= kCachedResults)
+        {
+            results_.pop_back();
+        }
+        results_.insert(results_.begin(), std::move(result));
+    }
+    else
+    {
+        std::rotate(results_.begin(), cached, cached + 1);
+    }
+
+    const CachedResult& result = results_.front();
+    reply.output_hash = result.output_hash;
+    reply.unchanged = request.has_current && request.current_hash == result.output_hash;
+    if (!reply.unchanged)
+    {
+        reply.lines = result.lines;
+    }
+    store_.trim();
+    reply.stats = stats();
+    return reply;
+}
+
+/// Send `request` to the daemon at `endpoint` and wait for the reply; `err` is set on any transport failure.
+[[nodiscard]] bool round_trip(const std::filesystem::path& endpoint, const detail::DaemonRequest& request, detail::DaemonReply& reply,
+                              std::string& err)
+{
+    detail::LocalStream stream;
+    std::string payload;
+    if (!stream.connect(endpoint, err) || !detail::send_message(stream, detail::encode_request(request), err) ||
+        !detail::receive_message(stream, payload, err))
+    {
+        return false;
+    }
+    if (!detail::decode_reply(payload, reply))
+    {
+        err = "invalid reply from defgen daemon";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::filesystem::path default_daemon_endpoint() { return detail::default_local_endpoint(); }
+
+bool run_daemon(const DaemonOptions& options, std::string& err)
+{
+    const std::filesystem::path endpoint = options.endpoint.empty() ? default_daemon_endpoint() : options.endpoint;
+    detail::LocalListener listener;
+    if (!listener.listen(endpoint, err))
+    {
+        return false;
+    }
+    ExportDaemon daemon(options);
+    for (;;)
+    {
+        detail::LocalStream stream;
+        if (!listener.accept(stream, err))
+        {
+            return false;
+        }
+        // A client that disconnects or sends garbage only loses its own connection.
+        std::string payload;
+        std::string stream_err;
+        detail::DaemonRequest request;
+        if (!detail::receive_message(stream, payload, stream_err) || !detail::decode_request(payload, request))
+        {
+            continue;
+        }
+        detail::DaemonReply reply;
+        if (request.op == detail::DaemonOp::Generate)
+        {
+            reply = daemon.generate(request);
+        }
+        else
+        {
+            reply.stats = daemon.stats();
+        }
+        (void)detail::send_message(stream, detail::encode_reply(reply), stream_err);
+        if (request.op == detail::DaemonOp::Shutdown)
+        {
+            return true;
+        }
+    }
+}
+
+DaemonResult query_daemon(const std::filesystem::path& endpoint, const std::vector<std::filesystem::path>& object_files, ObjectFormat format,
+                          const GenerateOptions& options, const std::filesystem::path& current_output)
+{
+    DaemonResult result;
+    detail::DaemonRequest request;
+    std::error_code ec;
+    request.working_dir = detail::path_key(std::filesystem::current_path(ec));
+    request.format = format;
+    request.options.ignore_substrings = options.ignore_substrings;
+    request.options.elf_style_export_block = options.elf_style_export_block;
+    request.options.library_basename = options.library_basename;
+    request.options.object_count_line = options.object_count_line;
+    request.options.export_hash_in_header = options.export_hash_in_header;
+    if (!options.ordinal_database.empty())
+    {
+        // The daemon runs elsewhere and writes the database itself.
+        request.options.ordinal_database = std::filesystem::absolute(options.ordinal_database, ec);
+        request.options.named_exports = options.named_exports;
+    }
+    if (!current_output.empty())
+    {
+        request.has_current = detail::hash_export_file(current_output, request.current_hash);
+    }
+    request.object_files.reserve(object_files.size());
+    for (const auto& path : object_files)
+    {
+        request.object_files.push_back(detail::path_key(path));
+    }
+
+    detail::DaemonReply reply;
+    if (!round_trip(endpoint, request, reply, result.message))
+    {
+        result.ec = Errc::Io;
+        return result;
+    }
+    result.ec = reply.ec;
+    result.message = std::move(reply.message);
+    result.unchanged = reply.unchanged;
+    result.out.lines = std::move(reply.lines);
+    result.objects_resident = static_cast<std::size_t>(reply.objects_resident);
+    result.objects_parsed = static_cast<std::size_t>(reply.objects_parsed);
+    return result;
+}
+
+bool query_daemon_stats(const std::filesystem::path& endpoint, DaemonStats& out, std::string& err)
+{
+    detail::DaemonRequest request;
+    request.op = detail::DaemonOp::Status;
+    detail::DaemonReply reply;
+    if (!round_trip(endpoint, request, reply, err))
+    {
+        return false;
+    }
+    out = reply.stats;
+    return true;
+}
+
+bool stop_daemon(const std::filesystem::path& endpoint, std::string& err)
+{
+    detail::DaemonRequest request;
+    request.op = detail::DaemonOp::Shutdown;
+    detail::DaemonReply reply;
+    return round_trip(endpoint, request, reply, err);
+}
+
+} // namespace defgen
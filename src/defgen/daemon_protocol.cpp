@@ -0,0 +1,240 @@
+#include "daemon_protocol.hpp"
+#include "file_util.hpp"
+
+#include <cstring>
+#include <utility>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+constexpr std::uint32_t kMagic = 0x33444744; // "DGD3"
+/// Sanity bound so a corrupt or hostile header cannot make either end allocate without limit.
+constexpr std::uint32_t kMaxPayload = 1u << 30;
+
+struct MessageHeader
+{
+    std::uint32_t magic;
+    std::uint32_t size;
+};
+
+class WireWriter
+{
+  public:
+    template <typename T> void put(T v)
+    {
+        const std::size_t at = buf_.size();
+        buf_.resize(at + sizeof(T));
+        std::memcpy(buf_.data() + at, &v, sizeof(T));
+    }
+
+    void put_string(std::string_view s)
+    {
+        put(static_cast<std::uint32_t>(s.size()));
+        buf_.append(s);
+    }
+
+    void put_strings(const std::vector<std::string>& v)
+    {
+        put(static_cast<std::uint32_t>(v.size()));
+        for (const std::string& s : v)
+        {
+            put_string(s);
+        }
+    }
+
+    [[nodiscard]] std::string take() { return std::move(buf_); }
+
+  private:
+    std::string buf_;
+};
+
+/// Bounds-checked reader; once a read fails every later read fails too, so callers check `at_end()` once after the last field.
+class WireReader
+{
+  public:
+    explicit WireReader(std::string_view data)
+        : data_(data)
+    {
+    }
+
+    template <typename T> [[nodiscard]] T get()
+    {
+        T v{};
+        if (!ok_ || data_.size() < sizeof(T))
+        {
+            ok_ = false;
+            return v;
+        }
+        std::memcpy(&v, data_.data(), sizeof(T));
+        data_.remove_prefix(sizeof(T));
+        return v;
+    }
+
+    [[nodiscard]] std::string get_string()
+    {
+        const auto size = get<std::uint32_t>();
+        if (!ok_ || data_.size() < size)
+        {
+            ok_ = false;
+            return {};
+        }
+        std::string s(data_.substr(0, size));
+        data_.remove_prefix(size);
+        return s;
+    }
+
+    void get_strings(std::vector<std::string>& out)
+    {
+        const auto count = get<std::uint32_t>();
+        // Each string needs at least its length prefix; reject counts the payload cannot hold before reserving.
+        if (!ok_ || count > data_.size() / sizeof(std::uint32_t))
+        {
+            ok_ = false;
+            return;
+        }
+        out.reserve(count);
+        for (std::uint32_t i = 0; i < count && ok_; i++)
+        {
+            out.push_back(get_string());
+        }
+    }
+
+    [[nodiscard]] bool at_end() const { return ok_ && data_.empty(); }
+
+  private:
+    std::string_view data_;
+    bool ok_ = true;
+};
+
+} // namespace
+
+bool send_message(LocalStream& stream, const std::string& payload, std::string& err)
+{
+    if (payload.size() > kMaxPayload)
+    {
+        err = "daemon message too large";
+        return false;
+    }
+    const MessageHeader header{kMagic, static_cast<std::uint32_t>(payload.size())};
+    return stream.write_all(&header, sizeof(header), err) && stream.write_all(payload.data(), payload.size(), err);
+}
+
+bool receive_message(LocalStream& stream, std::string& payload, std::string& err)
+{
+    MessageHeader header{};
+    if (!stream.read_all(&header, sizeof(header), err))
+    {
+        return false;
+    }
+    if (header.magic != kMagic || header.size > kMaxPayload)
+    {
+        err = "invalid daemon message";
+        return false;
+    }
+    payload.resize(header.size);
+    return stream.read_all(payload.data(), payload.size(), err);
+}
+
+std::string encode_request(const DaemonRequest& request)
+{
+    WireWriter w;
+    w.put(static_cast<std::uint8_t>(request.op));
+    w.put_string(request.working_dir);
+    w.put(static_cast<std::uint8_t>(request.format));
+    w.put(static_cast<std::uint8_t>(request.options.elf_style_export_block));
+    w.put_string(request.options.library_basename);
+    w.put(static_cast<std::uint8_t>(request.options.object_count_line.has_value()));
+    w.put_string(request.options.object_count_line.value_or(std::string()));
+    w.put(static_cast<std::uint8_t>(request.options.export_hash_in_header));
+    w.put_strings(request.options.ignore_substrings);
+    w.put_string(request.options.ordinal_database.empty() ? std::string() : path_key(request.options.ordinal_database));
+    w.put_strings(request.options.named_exports);
+    w.put(static_cast<std::uint8_t>(request.has_current));
+    w.put(request.current_hash);
+    w.put_strings(request.object_files);
+    return w.take();
+}
+
+bool decode_request(std::string_view payload, DaemonRequest& out)
+{
+    WireReader r(payload);
+    const auto op = r.get<std::uint8_t>();
+    if (op < static_cast<std::uint8_t>(DaemonOp::Generate) || op > static_cast<std::uint8_t>(DaemonOp::Shutdown))
+    {
+        return false;
+    }
+    out.op = static_cast<DaemonOp>(op);
+    out.working_dir = r.get_string();
+    const auto format = r.get<std::uint8_t>();
+    if (format > static_cast<std::uint8_t>(ObjectFormat::Elf))
+    {
+        return false;
+    }
+    out.format = static_cast<ObjectFormat>(format);
+    out.options.elf_style_export_block = r.get<std::uint8_t>() != 0;
+    out.options.library_basename = r.get_string();
+    const bool has_count_line = r.get<std::uint8_t>() != 0;
+    std::string count_line = r.get_string();
+    if (has_count_line)
+    {
+        out.options.object_count_line = std::move(count_line);
+    }
+    out.options.export_hash_in_header = r.get<std::uint8_t>() != 0;
+    r.get_strings(out.options.ignore_substrings);
+    const std::string ordinal_database = r.get_string();
+    if (!ordinal_database.empty())
+    {
+        out.options.ordinal_database = path_from_key(ordinal_database);
+    }
+    r.get_strings(out.options.named_exports);
+    out.has_current = r.get<std::uint8_t>() != 0;
+    out.current_hash = r.get<std::uint64_t>();
+    r.get_strings(out.object_files);
+    return r.at_end();
+}
+
+std::string encode_reply(const DaemonReply& reply)
+{
+    WireWriter w;
+    w.put(static_cast<std::uint8_t>(reply.ec));
+    w.put_string(reply.message);
+    w.put(static_cast<std::uint8_t>(reply.unchanged));
+    w.put(reply.output_hash);
+    w.put(reply.objects_resident);
+    w.put(reply.objects_parsed);
+    w.put(static_cast<std::uint64_t>(reply.stats.resident_objects));
+    w.put(reply.stats.resident_bytes);
+    w.put(reply.stats.memory_budget);
+    w.put(static_cast<std::uint64_t>(reply.stats.evictions));
+    w.put(static_cast<std::uint64_t>(reply.stats.requests));
+    w.put_strings(reply.lines);
+    return w.take();
+}
+
+bool decode_reply(std::string_view payload, DaemonReply& out)
+{
+    WireReader r(payload);
+    const auto ec = r.get<std::uint8_t>();
+    if (ec > static_cast<std::uint8_t>(Errc::InvalidArgument))
+    {
+        return false;
+    }
+    out.ec = static_cast<Errc>(ec);
+    out.message = r.get_string();
+    out.unchanged = r.get<std::uint8_t>() != 0;
+    out.output_hash = r.get<std::uint64_t>();
+    out.objects_resident = r.get<std::uint64_t>();
+    out.objects_parsed = r.get<std::uint64_t>();
+    out.stats.resident_objects = static_cast<std::size_t>(r.get<std::uint64_t>());
+    out.stats.resident_bytes = r.get<std::uint64_t>();
+    out.stats.memory_budget = r.get<std::uint64_t>();
+    out.stats.evictions = static_cast<std::size_t>(r.get<std::uint64_t>());
+    out.stats.requests = static_cast<std::size_t>(r.get<std::uint64_t>());
+    r.get_strings(out.lines);
+    return r.at_end();
+}
+
+} // namespace defgen::detail
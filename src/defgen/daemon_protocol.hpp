@@ -0,0 +1,57 @@
+#pragma once
+
+#include "defgen/defgen.hpp"
+#include "local_socket.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace defgen::detail
+{
+
+enum class DaemonOp : std::uint8_t
+{
+    Generate = 1,
+    Status = 2,
+    Shutdown = 3
+};
+
+/// One client request. Paths are sent as given together with the client's working directory, which the daemon
+/// resolves relative paths against (it may have been started somewhere else).
+struct DaemonRequest
+{
+    DaemonOp op = DaemonOp::Generate;
+    std::string working_dir;
+    ObjectFormat format = ObjectFormat::Auto;
+    /// Only the fields that shape the output are sent; loader, thread and cache settings belong to the daemon.
+    GenerateOptions options;
+    /// XXH64 of the output the client already has (see `hash_export_lines`); when it matches, no lines are sent back.
+    bool has_current = false;
+    std::uint64_t current_hash = 0;
+    std::vector<std::string> object_files;
+};
+
+struct DaemonReply
+{
+    Errc ec = Errc::Ok;
+    std::string message;
+    bool unchanged = false;
+    std::uint64_t output_hash = 0;
+    std::uint64_t objects_resident = 0;
+    std::uint64_t objects_parsed = 0;
+    DaemonStats stats;
+    std::vector<std::string> lines;
+};
+
+/// Messages are a fixed header (magic, payload size) followed by a native-endian payload; both ends run on one machine.
+[[nodiscard]] bool send_message(LocalStream& stream, const std::string& payload, std::string& err);
+[[nodiscard]] bool receive_message(LocalStream& stream, std::string& payload, std::string& err);
+
+[[nodiscard]] std::string encode_request(const DaemonRequest& request);
+[[nodiscard]] bool decode_request(std::string_view payload, DaemonRequest& out);
+[[nodiscard]] std::string encode_reply(const DaemonReply& reply);
+[[nodiscard]] bool decode_reply(std::string_view payload, DaemonReply& out);
+
+} // namespace defgen::detail
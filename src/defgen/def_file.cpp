@@ -0,0 +1,217 @@
+#include "def_file.hpp"
+#include "export_lines.hpp"
+#include "file_util.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <iterator>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+constexpr std::size_t kExportHashDigits = 32;
+
+[[nodiscard]] std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+    {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r'))
+    {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+[[nodiscard]] bool read_text(const std::filesystem::path& path, std::string& out, std::string& err)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f)
+    {
+        err = "cannot read " + path_key(path);
+        return false;
+    }
+    out.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    return true;
+}
+
+/// Calls `fn(line, line_no)` for each trimmed line of `text` that is neither blank nor a comment (`comment`).
+template <typename Fn> bool for_each_statement(std::string_view text, std::string_view comment, Fn&& fn)
+{
+    std::size_t line_no = 0;
+    while (!text.empty())
+    {
+        const std::size_t eol = text.find('\n');
+        const std::string_view line = trim(text.substr(0, eol));
+        text = eol == std::string_view::npos ? std::string_view{} : text.substr(eol + 1);
+        line_no++;
+        if (!line.empty() && line.substr(0, comment.size()) != comment && !fn(line, line_no))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+[[nodiscard]] bool file_equals(const std::filesystem::path& path, const std::vector<std::uint8_t>& bytes)
+{
+    std::error_code ec;
+    if (std::filesystem::file_size(path, ec) != bytes.size() || ec)
+    {
+        return false;
+    }
+    std::ifstream f(path, std::ios::binary);
+    const std::vector<std::uint8_t> old((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    return old == bytes;
+}
+
+/// `name`, `name @N` or `name @N NONAME`.
+[[nodiscard]] bool parse_entry(std::string_view line, DefExport& out)
+{
+    const std::size_t space = line.find(' ');
+    out.name = line.substr(0, space);
+    if (out.name.find('=') != std::string_view::npos)
+    {
+        return false;
+    }
+    if (space == std::string_view::npos)
+    {
+        return true;
+    }
+    const std::string_view tail = line.substr(space + 1);
+    std::uint32_t ordinal = 0;
+    const auto r = std::from_chars(tail.data() + 1, tail.data() + tail.size(), ordinal);
+    if (tail.front() != '@' || r.ec != std::errc() || ordinal == 0 || ordinal > 0xFFFF)
+    {
+        return false;
+    }
+    out.ordinal = static_cast<std::uint16_t>(ordinal);
+    const std::string_view flags(r.ptr, static_cast<std::size_t>(tail.data() + tail.size() - r.ptr));
+    out.noname = flags == " NONAME";
+    return flags.empty() || out.noname;
+}
+
+} // namespace
+
+Errc read_def_exports(const std::filesystem::path& path, DefExports& out, std::string& err)
+{
+    out.exports.clear();
+    if (!read_text(path, out.text, err))
+    {
+        return Errc::Io;
+    }
+    bool body = false;
+    const bool ok = for_each_statement(out.text, ";", [&](std::string_view line, std::size_t line_no) {
+        if (!body)
+        {
+            body = line == "EXPORTS";
+            return true;
+        }
+        if (!parse_entry(line, out.exports.emplace_back()))
+        {
+            err = path_key(path) + ": unsupported export entry on line " + std::to_string(line_no);
+            return false;
+        }
+        return true;
+    });
+    return ok ? Errc::Ok : Errc::Parse;
+}
+
+Errc read_emd_exports(const std::filesystem::path& path, DefExports& out, std::string& err)
+{
+    out.exports.clear();
+    if (!read_text(path, out.text, err))
+    {
+        return Errc::Io;
+    }
+    bool body = false;
+    const bool ok = for_each_statement(out.text, "//", [&](std::string_view line, std::size_t line_no) {
+        if (!body)
+        {
+            body = line == "export: {";
+            return body || line == "}" || (line.substr(0, 9) == "Library: " && line.back() == '{');
+        }
+        if (line == "}")
+        {
+            body = false;
+            return true;
+        }
+        if (line.find_first_of(" \t{}") == std::string_view::npos)
+        {
+            out.exports.push_back({line});
+            return true;
+        }
+        err = path_key(path) + ": unsupported export entry on line " + std::to_string(line_no);
+        return false;
+    });
+    if (!ok && err.empty())
+    {
+        err = path_key(path) + ": not an EMD export block";
+    }
+    return ok ? Errc::Ok : Errc::Parse;
+}
+
+bool read_def_export_hash(const std::filesystem::path& path, std::string& out)
+{
+    std::ifstream f(path, std::ios::binary);
+    std::string line;
+    if (!f || !std::getline(f, line))
+    {
+        return false;
+    }
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.pop_back();
+    }
+    if (!line_has_export_hash(line))
+    {
+        return false;
+    }
+    out = line.substr(line.size() - kExportHashDigits);
+    return true;
+}
+
+Errc write_export_output(const std::filesystem::path& export_path, const std::filesystem::path& out_path, std::string_view tag,
+                         std::string_view target, ExportListReader read, ExportOutputCheck check, const ExportOutputBuilder& build,
+                         bool& unchanged, std::string& message)
+{
+    unchanged = false;
+    std::string export_hash;
+    const bool hashed = read_def_export_hash(export_path, export_hash);
+    std::string stamp(tag);
+    stamp += ' ';
+    stamp += hashed ? export_hash : "-";
+    stamp += ' ';
+    stamp += target;
+    if (hashed && check(out_path, stamp))
+    {
+        unchanged = true;
+        return Errc::Ok;
+    }
+
+    DefExports exports;
+    Errc ec = read(export_path, exports, message);
+    if (ec != Errc::Ok)
+    {
+        return ec;
+    }
+    std::vector<std::uint8_t> bytes;
+    ec = build(exports, stamp, bytes, message);
+    if (ec != Errc::Ok)
+    {
+        message = path_key(export_path) + ": " + message;
+        return ec;
+    }
+    if (file_equals(out_path, bytes))
+    {
+        unchanged = true;
+        return Errc::Ok;
+    }
+    return write_file_atomic(out_path, bytes.data(), bytes.size(), message) ? Errc::Ok : Errc::Io;
+}
+
+} // namespace defgen::detail
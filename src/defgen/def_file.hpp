@@ -0,0 +1,61 @@
+#pragma once
+
+#include "defgen/defgen.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// One `EXPORTS` entry of a `.def`.
+struct DefExport
+{
+    std::string_view name;
+    /// 0 when the entry has no `@N`.
+    std::uint16_t ordinal = 0;
+    bool noname = false;
+};
+
+/// The `EXPORTS` section of a `.def`; names are views into `text`.
+struct DefExports
+{
+    std::string text;
+    std::vector<DefExport> exports;
+};
+
+/// Read a `.def` as `generate_def` writes it: `name`, `name @N` or `name @N NONAME` per `EXPORTS` line. Statements
+/// before `EXPORTS`, `;` comments and blank lines are skipped. `Errc::Io` if the file cannot be read, `Errc::Parse`
+/// (with the line number) for any other entry form.
+[[nodiscard]] Errc read_def_exports(const std::filesystem::path& path, DefExports& out, std::string& err);
+
+/// Read an EMD file as `generate_def` writes it with `elf_style_export_block`: one symbol per line in the `export: {`
+/// block, optionally inside `Library: <name> {`. `//` comments and blank lines are skipped. `Errc::Io` if the file
+/// cannot be read, `Errc::Parse` (with the line number) for a line that is not a single symbol name.
+[[nodiscard]] Errc read_emd_exports(const std::filesystem::path& path, DefExports& out, std::string& err);
+
+/// The 32 hex digits of the `ExportHash=` on the first line of `path` (see `export_hash_in_header`). False when the
+/// file cannot be read or its first line has none.
+[[nodiscard]] bool read_def_export_hash(const std::filesystem::path& path, std::string& out);
+
+/// Reads the export list of an export file (`read_def_exports`, `read_emd_exports`).
+using ExportListReader = Errc (*)(const std::filesystem::path& path, DefExports& out, std::string& err);
+/// True if the existing output at the path holds `stamp`.
+using ExportOutputCheck = bool (*)(const std::filesystem::path& path, std::string_view stamp);
+/// Lays out the output for the exports, embedding `stamp`.
+using ExportOutputBuilder =
+    std::function<Errc(const DefExports& exports, std::string_view stamp, std::vector<std::uint8_t>& out, std::string& message)>;
+
+/// Shared driver of the files built from an export file (`write_export_object`, `write_import_library`,
+/// `write_elf_stub`). The stamp is `<tag> <export hash> <target>`: when the export file carries an export hash and
+/// `check` finds the stamp in `out_path`, nothing else is read. Otherwise the exports are read and built, and `out_path`
+/// is written (temporary file + rename) only if its bytes differ.
+[[nodiscard]] Errc write_export_output(const std::filesystem::path& export_path, const std::filesystem::path& out_path,
+                                       std::string_view tag, std::string_view target, ExportListReader read, ExportOutputCheck check,
+                                       const ExportOutputBuilder& build, bool& unchanged, std::string& message);
+
+} // namespace defgen::detail
@@ -1,12 +1,23 @@
 #include "defgen/defgen.hpp"
+#include "ar_archive.hpp"
+#include "batch_reader.hpp"
+#include "export_lines.hpp"
+#include "ignore_matcher.hpp"
+#include "name_sort.hpp"
+#include "ordinal_db.hpp"
 #include "parsers.hpp"
+#include "shared_cache.hpp"
+#include "symbol_cache.hpp"
+#include "symbol_pool.hpp"
+#include "symbol_sidecar.hpp"
+#include "work_stealing.hpp"
 
 #include <algorithm>
-#include <cctype>
+#include <atomic>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <string_view>
-#include <unordered_set>
 
 namespace defgen
 {
@@ -14,129 +25,488 @@ namespace defgen
 namespace
 {
 
-[[nodiscard]] ObjectFormat resolve_format(const std::filesystem::path& path, ObjectFormat f)
+/// Symbol-cache state for one `generate_def` call: the mapped cache plus one key and record per input object.
+struct CacheSession
 {
-    if (f != ObjectFormat::Auto)
+    detail::SymbolCache cache;
+    std::vector<std::string> keys;
+    std::vector<detail::SymbolCacheRecord> records;
+};
+
+struct LoadContext
+{
+    const std::vector<std::filesystem::path>& object_files;
+    ObjectFormat format;
+    GenerateResult& gr;
+    /// Null when no symbol cache is configured.
+    CacheSession* cache;
+    /// Null when no shared store is configured.
+    detail::SharedSymbolCache* shared;
+};
+
+/// Collect the symbols of object `index` from `source`. With a cache, an entry whose recorded ranges (the headers and
+/// tables its parse fetched) still hash the same is replayed instead of parsing, first from the local cache, else from
+/// the shared store; otherwise the parse records its ranges and traces its symbols into the object's cache record, and
+/// publishes both to the shared store. No cache lookup reads more of the object than a parse would.
+[[nodiscard]] int load_object(const LoadContext& ctx, std::size_t index, detail::ObjectSource& source, detail::SymbolCollector& out,
+                              std::string& err)
+{
+    const auto& path = ctx.object_files[index];
+    const ObjectFormat fmt = detail::resolve_object_format(path, ctx.format);
+    ObjectStats& st = ctx.gr.stats.objects[index];
+    int code = 0;
+    if (ctx.cache == nullptr && ctx.shared == nullptr)
     {
-        return f;
+        code = detail::parse_object(path, fmt, source, out, err);
     }
-    const auto ext = path.extension().string();
-    std::string lower;
-    lower.resize(ext.size());
-    std::transform(ext.begin(), ext.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-    if (lower == ".o")
+    else if (detail::ar::is_thin_archive(source))
     {
-        return ObjectFormat::Elf;
+        // Its members live in other files, so nothing keyed by the archive's own bytes may be cached or replayed.
+        if (ctx.cache != nullptr)
+        {
+            ctx.cache->records[index].valid = false;
+        }
+        code = detail::parse_object(path, fmt, source, out, err);
+        st.cache = CacheOutcome::Miss;
     }
-    return ObjectFormat::Coff;
+    else
+    {
+        std::vector<detail::ByteRange> uncached_ranges;
+        std::uint64_t uncached_hash = 0;
+        std::vector<detail::TracedSymbol> uncached_trace;
+        std::vector<detail::ByteRange>* ranges = &uncached_ranges;
+        std::uint64_t* tables_hash = &uncached_hash;
+        const detail::SymbolCache::Entry* entry = nullptr;
+        if (ctx.cache != nullptr)
+        {
+            detail::SymbolCacheRecord& record = ctx.cache->records[index];
+            // Changed between the stat and the read: parse it, but do not cache it under the stale identity.
+            record.valid = record.valid && record.identity.size == source.size();
+            ranges = &record.ranges;
+            tables_hash = &record.tables_hash;
+            out.trace = &record.symbols;
+            entry = ctx.cache->cache.find(ctx.cache->keys[index], fmt);
+        }
+        else
+        {
+            out.trace = &uncached_trace;
+        }
+        // The ranges of a stale entry may lie past the end of the file; that is a miss, not an error.
+        std::string stale_err;
+        if (entry != nullptr && entry->size == source.size() &&
+            detail::hash_ranges(source, ctx.cache->cache.ranges(*entry), *tables_hash, stale_err) && *tables_hash == entry->tables_hash)
+        {
+            const std::span<const detail::ByteRange> listed = ctx.cache->cache.ranges(*entry);
+            ranges->assign(listed.begin(), listed.end());
+            ctx.cache->cache.replay(*entry, out);
+            st.cache = CacheOutcome::ContentHit;
+        }
+        else if (ctx.shared != nullptr && ctx.shared->replay(fmt, source, *ranges, *tables_hash, out))
+        {
+            st.cache = CacheOutcome::SharedHit;
+        }
+        else
+        {
+            ranges->clear();
+            detail::RecordingObjectSource recording(source, *ranges);
+            code = detail::parse_object(path, fmt, recording, out, err);
+            st.cache = CacheOutcome::Miss;
+            // Every range was just fetched, so hashing them reads nothing more from the file.
+            if (code == 0 && !detail::hash_ranges(source, *ranges, *tables_hash, err))
+            {
+                code = -1;
+            }
+            if (code == 0 && ctx.shared != nullptr)
+            {
+                ctx.shared->store(fmt, source, *ranges, *tables_hash, *out.trace);
+            }
+        }
+        out.trace = nullptr;
+    }
+    st.file_size = source.size();
+    st.bytes_read = source.bytes_read();
+    return code;
 }
 
-void merge_unique_sort(std::vector<std::string>& v)
+[[nodiscard]] bool load_serial(const LoadContext& ctx, const std::vector<std::size_t>& pending, LoadMode mode, detail::SymbolCollector& out)
 {
-    std::unordered_set<std::string> seen;
-    for (const auto& s : v)
+    for (const std::size_t i : pending)
     {
-        seen.insert(s);
+        std::string err;
+        const std::unique_ptr<detail::ObjectSource> source = detail::open_object_source(ctx.object_files[i], mode, err);
+        if (!source || load_object(ctx, i, *source, out, err) != 0)
+        {
+            ctx.gr.ec = Errc::Parse;
+            ctx.gr.message = err;
+            return false;
+        }
     }
-    v.assign(seen.begin(), seen.end());
-    std::sort(v.begin(), v.end());
+    return true;
 }
 
-[[nodiscard]] bool is_ignored(std::string_view name, const std::vector<std::string>& ignores)
+/// Largest objects first over a work-stealing pool; each worker interns through its own collector (one per entry of
+/// `collectors`). Output is identical to `load_serial` because the pool deduplicates and the lists are sorted later, and
+/// the reported error is the lowest failing index: objects after a known failure are skipped, objects before it always run.
+[[nodiscard]] bool load_parallel(const LoadContext& ctx, const std::vector<std::size_t>& pending, LoadMode mode,
+                                 std::vector<detail::SymbolCollector>& collectors)
 {
-    for (const auto& ign : ignores)
+    const std::size_t count = ctx.object_files.size();
+    std::vector<std::uintmax_t> sizes(count, 0);
+    for (const std::size_t i : pending)
     {
-        if (ign.empty())
+        std::error_code ec;
+        const std::uintmax_t sz = std::filesystem::file_size(ctx.object_files[i], ec);
+        sizes[i] = ec ? 0 : sz;
+    }
+    std::vector<std::size_t> order = pending;
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+
+    std::vector<std::string> errors(count);
+    std::atomic<std::size_t> first_failed{count};
+
+    const auto threads = static_cast<unsigned>(collectors.size());
+    detail::run_work_stealing(order, threads, [&](unsigned worker, std::size_t i) {
+        if (i > first_failed.load(std::memory_order_relaxed))
         {
-            continue;
+            return;
         }
-        if (name.find(ign) != std::string_view::npos)
+        std::string err;
+        const std::unique_ptr<detail::ObjectSource> source = detail::open_object_source(ctx.object_files[i], mode, err);
+        if (source && load_object(ctx, i, *source, collectors[worker], err) == 0)
+        {
+            return;
+        }
+        errors[i] = std::move(err);
+        std::size_t prev = first_failed.load(std::memory_order_relaxed);
+        while (i < prev && !first_failed.compare_exchange_weak(prev, i, std::memory_order_relaxed))
         {
-            return true;
         }
+    });
+
+    const std::size_t failed = first_failed.load();
+    if (failed < count)
+    {
+        ctx.gr.ec = Errc::Parse;
+        ctx.gr.message = errors[failed];
+        return false;
     }
-    return false;
+    return true;
 }
 
-} // namespace
-
-GenerateResult generate_def(const std::vector<std::filesystem::path>& object_files, ObjectFormat format, const GenerateOptions& options)
+/// `ran` is false when io_uring is unavailable and nothing was loaded; the caller then falls back.
+[[nodiscard]] bool load_batched(const LoadContext& ctx, const std::vector<std::size_t>& pending, unsigned queue_depth,
+                                detail::SymbolCollector& out, bool& ran)
 {
-    GenerateResult gr;
-    std::vector<std::string> export_funcs;
-    std::vector<std::string> export_data;
+    std::vector<std::filesystem::path> paths;
+    paths.reserve(pending.size());
+    for (const std::size_t i : pending)
+    {
+        paths.push_back(ctx.object_files[i]);
+    }
+    // Buffers arrive in completion order; report the lowest failing index so errors match the serial path.
+    std::size_t first_failed = paths.size();
+    std::string first_err;
+    std::string err;
+    ran = detail::batch_read_files(
+        paths, queue_depth,
+        [&](std::size_t slot, std::unique_ptr<std::uint8_t[]> bytes, std::size_t size, const std::string& read_err) {
+            if (slot > first_failed)
+            {
+                return;
+            }
+            std::string parse_err = read_err;
+            if (parse_err.empty())
+            {
+                detail::BufferObjectSource source(std::move(bytes), size);
+                if (load_object(ctx, pending[slot], source, out, parse_err) == 0)
+                {
+                    return;
+                }
+            }
+            first_failed = slot;
+            first_err = std::move(parse_err);
+        },
+        err);
+    if (ran && first_failed < paths.size())
+    {
+        ctx.gr.ec = Errc::Parse;
+        ctx.gr.message = first_err;
+        return false;
+    }
+    return true;
+}
 
-    for (const auto& path : object_files)
+/// Open `<object>.sym` for each object whose sidecar matches its current size and mtime (and format); the objects
+/// without one are returned for loading. `sidecars` gets one slot per object, open where the sidecar is used.
+[[nodiscard]] std::vector<std::size_t> open_sidecars(const LoadContext& ctx, unsigned threads, std::vector<detail::SymbolSidecar>& sidecars)
+{
+    const std::size_t count = ctx.object_files.size();
+    sidecars.resize(count);
+    std::vector<std::size_t> all(count);
+    for (std::size_t i = 0; i < count; i++)
     {
-        const ObjectFormat fmt = resolve_format(path, format);
+        all[i] = i;
+    }
+    detail::run_work_stealing(all, std::max(1u, threads), [&](unsigned, std::size_t i) {
+        const auto& path = ctx.object_files[i];
+        detail::FileIdentity identity;
         std::string err;
-        if (fmt == ObjectFormat::Coff)
+        detail::SymbolSidecar& sidecar = sidecars[i];
+        if (detail::stat_file_identity(path, identity) && sidecar.open(detail::sidecar_path_for(path), err) &&
+            sidecar.format() == detail::resolve_object_format(path, ctx.format) && sidecar.object_identity() == identity)
         {
-            const int code = detail::process_coff_object(path, export_funcs, export_data, err);
-            if (code != 0)
-            {
-                gr.ec = Errc::Parse;
-                gr.message = err;
-                return gr;
-            }
+            ObjectStats& st = ctx.gr.stats.objects[i];
+            st.sidecar = true;
+            st.file_size = identity.size;
+            return;
         }
-        else
+        sidecar.close();
+    });
+    std::vector<std::size_t> rest;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        if (!ctx.gr.stats.objects[i].sidecar)
         {
-            const int code = detail::process_elf_object(path, export_funcs, err);
-            if (code != 0)
-            {
-                gr.ec = Errc::Parse;
-                gr.message = err;
-                return gr;
-            }
+            rest.push_back(i);
         }
     }
+    return rest;
+}
 
-    merge_unique_sort(export_funcs);
-    merge_unique_sort(export_data);
+/// Merge sorted, duplicate-free runs into one sorted set. The k-way merge runs as a balanced tree of two-way unions:
+/// every pass streams through its inputs sequentially, and names shared by many objects collapse early, so the passes
+/// shrink quickly (a heap over thousands of tiny runs spends most of its time on scattered compares instead).
+[[nodiscard]] std::vector<std::string_view> merge_runs(const std::vector<const std::vector<std::string_view>*>& runs)
+{
+    if (runs.empty())
+    {
+        return {};
+    }
+    std::vector<std::vector<std::string_view>> level;
+    level.reserve((runs.size() + 1) / 2);
+    for (std::size_t r = 0; r + 1 < runs.size(); r += 2)
+    {
+        std::vector<std::string_view>& u = level.emplace_back();
+        u.reserve(runs[r]->size() + runs[r + 1]->size());
+        std::set_union(runs[r]->begin(), runs[r]->end(), runs[r + 1]->begin(), runs[r + 1]->end(), std::back_inserter(u));
+    }
+    if (runs.size() % 2 != 0)
+    {
+        level.push_back(*runs.back());
+    }
+    while (level.size() > 1)
+    {
+        std::vector<std::vector<std::string_view>> next;
+        next.reserve((level.size() + 1) / 2);
+        for (std::size_t r = 0; r + 1 < level.size(); r += 2)
+        {
+            std::vector<std::string_view>& u = next.emplace_back();
+            u.reserve(level[r].size() + level[r + 1].size());
+            std::set_union(level[r].begin(), level[r].end(), level[r + 1].begin(), level[r + 1].end(), std::back_inserter(u));
+        }
+        if (level.size() % 2 != 0)
+        {
+            next.push_back(std::move(level.back()));
+        }
+        level = std::move(next);
+    }
+    return std::move(level.front());
+}
 
-    std::vector<std::string> filtered;
-    filtered.reserve(export_funcs.size());
-    for (const auto& name : export_funcs)
+/// Serve every object in `candidates` whose path, size and mtime match a cache entry straight from the cache (without
+/// opening it) into `out`; the others are returned for loading.
+[[nodiscard]] std::vector<std::size_t> replay_cache_hits(const LoadContext& ctx, const std::vector<std::size_t>& candidates,
+                                                         detail::SymbolCollector& out)
+{
+    CacheSession& session = *ctx.cache;
+    const std::size_t count = ctx.object_files.size();
+    session.keys.resize(count);
+    session.records.resize(count);
+    std::vector<std::size_t> pending;
+    for (const std::size_t i : candidates)
     {
-        if (!is_ignored(name, options.ignore_substrings))
+        const auto& path = ctx.object_files[i];
+        detail::SymbolCacheRecord& record = session.records[i];
+        session.keys[i] = detail::path_key(path);
+        record.format = detail::resolve_object_format(path, ctx.format);
+        record.valid = detail::stat_file_identity(path, record.identity);
+        const detail::SymbolCache::Entry* entry = record.valid ? session.cache.find(session.keys[i], record.format) : nullptr;
+        if (entry == nullptr || entry->size != record.identity.size || entry->mtime != record.identity.mtime)
         {
-            filtered.push_back(name);
+            pending.push_back(i);
+            continue;
         }
+        const std::span<const detail::ByteRange> ranges = session.cache.ranges(*entry);
+        record.ranges.assign(ranges.begin(), ranges.end());
+        record.tables_hash = entry->tables_hash;
+        out.trace = &record.symbols;
+        session.cache.replay(*entry, out);
+        out.trace = nullptr;
+        ObjectStats& st = ctx.gr.stats.objects[i];
+        st.cache = CacheOutcome::Hit;
+        st.file_size = record.identity.size;
+    }
+    return pending;
+}
+
+/// Concatenate every collector's first-seen handles of `kind` (already unique) and sort them by name.
+[[nodiscard]] std::vector<detail::SymbolHandle> merge_sorted(const std::vector<detail::SymbolCollector>& collectors, detail::SymbolKind kind,
+                                                             unsigned threads)
+{
+    std::vector<detail::SymbolHandle> v;
+    std::size_t total = 0;
+    for (const auto& c : collectors)
+    {
+        total += (kind == detail::SymbolFunction ? c.funcs : c.data).size();
+    }
+    v.reserve(total);
+    for (const auto& c : collectors)
+    {
+        const auto& part = kind == detail::SymbolFunction ? c.funcs : c.data;
+        v.insert(v.end(), part.begin(), part.end());
     }
+    detail::sort_names(v, threads);
+    return v;
+}
+
+} // namespace
+
+GenerateResult generate_def(const std::vector<std::filesystem::path>& object_files, ObjectFormat format, const GenerateOptions& options)
+{
+    std::vector<std::string> lines;
+    detail::LineCollector sink(lines);
+    GenerateResult gr = generate_def(object_files, format, options, sink);
+    gr.out.lines = std::move(lines);
+    return gr;
+}
 
-    std::vector<std::string>& lines = gr.out.lines;
+GenerateResult generate_def(const std::vector<std::filesystem::path>& object_files, ObjectFormat format, const GenerateOptions& options,
+                            ExportSink& sink)
+{
+    GenerateResult gr;
+    detail::SymbolPool pool;
+    std::vector<detail::SymbolCollector> collectors;
 
-    if (options.object_count_line.has_value())
+    gr.stats.objects.resize(object_files.size());
+    gr.stats.load_mode = options.load_mode;
+
+    std::unique_ptr<CacheSession> session;
+    if (!options.symbol_cache_path.empty())
+    {
+        session = std::make_unique<CacheSession>();
+        session->cache.open(options.symbol_cache_path);
+    }
+    std::unique_ptr<detail::SharedSymbolCache> shared;
+    if (!options.shared_cache_dir.empty())
+    {
+        shared = std::make_unique<detail::SharedSymbolCache>(options.shared_cache_dir, options.shared_cache_max_bytes);
+    }
+    const LoadContext ctx{object_files, format, gr, session.get(), shared.get()};
+    std::vector<detail::SymbolSidecar> sidecars;
+    std::vector<std::size_t> candidates;
+    if (options.use_symbol_sidecars)
+    {
+        candidates = open_sidecars(ctx, detail::resolve_thread_count(options.thread_count), sidecars);
+    }
+    else
     {
-        lines.push_back(*options.object_count_line);
+        candidates.resize(object_files.size());
+        for (std::size_t i = 0; i < candidates.size(); i++)
+        {
+            candidates[i] = i;
+        }
     }
+    detail::SymbolCollector cached(pool);
+    const std::vector<std::size_t> pending = session ? replay_cache_hits(ctx, candidates, cached) : candidates;
 
-    if (options.elf_style_export_block)
+    bool ran = false;
+    bool ok = true;
+    if (options.load_mode == LoadMode::Batched)
     {
-        if (!options.library_basename.empty())
+        collectors.emplace_back(pool);
+        ok = load_batched(ctx, pending, options.io_queue_depth, collectors.front(), ran);
+        if (!ran)
         {
-            lines.push_back(std::string("Library: ") + options.library_basename + " {");
+            gr.stats.load_mode = LoadMode::Mapped;
         }
-        lines.push_back("export: {");
-        for (const auto& s : filtered)
+    }
+    if (!ran)
+    {
+        std::size_t threads = detail::resolve_thread_count(options.thread_count);
+        threads = std::max<std::size_t>(1, std::min(threads, pending.size()));
+        collectors.assign(threads, detail::SymbolCollector(pool));
+        ok = threads > 1 ? load_parallel(ctx, pending, gr.stats.load_mode, collectors)
+                         : load_serial(ctx, pending, gr.stats.load_mode, collectors.front());
+    }
+    if (!ok)
+    {
+        return gr;
+    }
+    collectors.push_back(std::move(cached));
+
+    for (const ObjectStats& st : gr.stats.objects)
+    {
+        gr.stats.total_file_size += st.file_size;
+        gr.stats.total_bytes_read += st.bytes_read;
+        gr.stats.cache_hits += st.cache == CacheOutcome::Hit ? 1 : 0;
+        gr.stats.cache_content_hits += st.cache == CacheOutcome::ContentHit ? 1 : 0;
+        gr.stats.cache_misses += st.cache == CacheOutcome::Miss ? 1 : 0;
+        gr.stats.sidecar_hits += st.sidecar ? 1 : 0;
+        gr.stats.shared_cache_hits += st.cache == CacheOutcome::SharedHit ? 1 : 0;
+    }
+    if (shared)
+    {
+        gr.stats.shared_cache_writes = shared->writes();
+        gr.stats.shared_cache_evictions = shared->trim();
+    }
+
+    if (session)
+    {
+        // Unchanged when every object without a sidecar was a plain hit and the cache holds nothing else.
+        const bool changed = !pending.empty() || session->cache.size() != candidates.size();
+        session->cache.close();
+        if (changed)
         {
-            lines.push_back(s);
+            gr.stats.cache_written =
+                detail::SymbolCache::write(options.symbol_cache_path, session->keys, session->records, gr.stats.cache_error);
         }
-        lines.push_back("}");
-        if (!options.library_basename.empty())
+    }
+
+    std::vector<std::string_view> names;
+    {
+        // Data symbols are collected (and deduplicated by the pool) like the legacy tool, but only functions are exported.
+        const std::vector<detail::SymbolHandle> export_funcs =
+            merge_sorted(collectors, detail::SymbolFunction, detail::resolve_thread_count(options.thread_count));
+        names.reserve(export_funcs.size());
+        for (const detail::SymbolHandle name : export_funcs)
         {
-            lines.push_back("}");
+            names.push_back(name->view());
         }
     }
-    else
+    if (gr.stats.sidecar_hits != 0)
     {
-        lines.push_back("EXPORTS");
-        for (const auto& s : filtered)
+        // Sidecars are sorted runs already: merge them with the parsed objects' run instead of interning and re-sorting.
+        std::vector<const std::vector<std::string_view>*> runs{&names};
+        for (const detail::SymbolSidecar& sidecar : sidecars)
         {
-            lines.push_back(s);
+            if (!sidecar.names(detail::SymbolFunction).empty())
+            {
+                runs.push_back(&sidecar.names(detail::SymbolFunction));
+            }
         }
+        names = merge_runs(runs);
+    }
+
+    const detail::IgnoreMatcher ignores(options.ignore_substrings);
+    std::erase_if(names, [&](std::string_view name) { return ignores.matches(name); });
+
+    std::vector<detail::ExportOrdinal> ordinals;
+    if (!detail::assign_export_ordinals(names, options, ordinals, gr.stats.ordinals_added, gr.message))
+    {
+        gr.ec = Errc::InvalidArgument;
+        return gr;
     }
+    detail::write_export_lines(names, options, sink, ordinals);
 
     gr.ec = Errc::Ok;
     return gr;
@@ -161,8 +531,12 @@ bool def_first_line_is(const std::filesystem::path& def_path, std::string_view e
     return line == expected;
 }
 
-bool def_file_matches(const std::filesystem::path& def_path, const std::vector<std::string>& new_lines)
+bool def_file_matches(const std::filesystem::path& def_path, const std::vector<std::string>& new_lines, ExportCompare compare)
 {
+    if (compare == ExportCompare::Header && !new_lines.empty() && detail::line_has_export_hash(new_lines.front()))
+    {
+        return def_first_line_is(def_path, new_lines.front());
+    }
     std::ifstream f(def_path);
     if (!f)
     {
@@ -0,0 +1,214 @@
+#include "dir_watcher.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace defgen::detail
+{
+
+#ifdef __linux__
+
+namespace
+{
+
+constexpr std::uint32_t kWatchMask =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_MODIFY | IN_DELETE_SELF | IN_ONLYDIR;
+
+[[nodiscard]] bool is_within(const std::filesystem::path& path, const std::filesystem::path& dir)
+{
+    auto p = path.begin();
+    for (auto d = dir.begin(); d != dir.end(); ++d, ++p)
+    {
+        if (p == path.end() || *p != *d)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+bool DirectoryWatcher::add_tree(const std::filesystem::path& root, std::vector<std::filesystem::path>& files, std::string& err)
+{
+    if (fd_ < 0)
+    {
+        fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0)
+        {
+            err = std::string("inotify_init1: ") + std::strerror(errno);
+            return false;
+        }
+    }
+    const int wd = ::inotify_add_watch(fd_, root.c_str(), kWatchMask);
+    if (wd < 0)
+    {
+        err = "cannot watch " + root.string() + ": " + std::strerror(errno);
+        return false;
+    }
+    dirs_[wd] = root;
+    // Each directory is watched before it is listed, so a file created meanwhile is seen by one or the other.
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(root, std::filesystem::directory_options::skip_permission_denied, ec);
+         !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+    {
+        if (it->is_directory(ec))
+        {
+            const int sub = ::inotify_add_watch(fd_, it->path().c_str(), kWatchMask);
+            if (sub >= 0)
+            {
+                dirs_[sub] = it->path();
+            }
+        }
+        else if (it->is_regular_file(ec))
+        {
+            files.push_back(it->path());
+        }
+    }
+    return true;
+}
+
+void DirectoryWatcher::watch_new_directory(const std::filesystem::path& dir, std::vector<DirectoryEvent>& out)
+{
+    std::vector<std::filesystem::path> files;
+    std::string err;
+    if (!add_tree(dir, files, err))
+    {
+        return;
+    }
+    for (auto& f : files)
+    {
+        out.push_back({DirectoryEvent::Modified, false, std::move(f)});
+    }
+}
+
+bool DirectoryWatcher::wait(int timeout_ms, std::vector<DirectoryEvent>& out, std::string& err)
+{
+    pollfd pfd{fd_, POLLIN, 0};
+    const int ready = ::poll(&pfd, 1, timeout_ms);
+    if (ready < 0)
+    {
+        if (errno == EINTR)
+        {
+            return true;
+        }
+        err = std::string("poll: ") + std::strerror(errno);
+        return false;
+    }
+    if (ready == 0)
+    {
+        return true;
+    }
+
+    alignas(inotify_event) char buf[64 * 1024];
+    for (;;)
+    {
+        const ssize_t n = ::read(fd_, buf, sizeof(buf));
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+            {
+                return true;
+            }
+            err = std::string("inotify read: ") + std::strerror(errno);
+            return false;
+        }
+        for (ssize_t at = 0; at < n;)
+        {
+            const auto* ev = reinterpret_cast<const inotify_event*>(buf + at);
+            at += static_cast<ssize_t>(sizeof(inotify_event) + ev->len);
+            if ((ev->mask & IN_Q_OVERFLOW) != 0)
+            {
+                out.push_back({DirectoryEvent::Rescan, false, {}});
+                continue;
+            }
+            if ((ev->mask & IN_IGNORED) != 0)
+            {
+                dirs_.erase(ev->wd);
+                continue;
+            }
+            const auto dir = dirs_.find(ev->wd);
+            if (dir == dirs_.end() || ev->len == 0)
+            {
+                // Events on the watched directory itself: its parent (or, for a root, nobody) reports the removal.
+                continue;
+            }
+            std::filesystem::path path = dir->second / ev->name;
+            if ((ev->mask & IN_ISDIR) != 0)
+            {
+                if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+                {
+                    watch_new_directory(path, out);
+                }
+                else if ((ev->mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+                {
+                    // A directory moved elsewhere stays watched under its old name: drop those watches now.
+                    for (auto it = dirs_.begin(); it != dirs_.end();)
+                    {
+                        if (is_within(it->second, path))
+                        {
+                            ::inotify_rm_watch(fd_, it->first);
+                            it = dirs_.erase(it);
+                        }
+                        else
+                        {
+                            ++it;
+                        }
+                    }
+                    out.push_back({DirectoryEvent::Removed, true, std::move(path)});
+                }
+                continue;
+            }
+            if ((ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) != 0)
+            {
+                out.push_back({DirectoryEvent::Written, false, std::move(path)});
+            }
+            else if ((ev->mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+            {
+                out.push_back({DirectoryEvent::Removed, false, std::move(path)});
+            }
+            else if ((ev->mask & (IN_CREATE | IN_MODIFY)) != 0)
+            {
+                out.push_back({DirectoryEvent::Modified, false, std::move(path)});
+            }
+        }
+    }
+}
+
+#else
+
+DirectoryWatcher::~DirectoryWatcher() = default;
+
+bool DirectoryWatcher::add_tree(const std::filesystem::path&, std::vector<std::filesystem::path>&, std::string& err)
+{
+    err = "directory watching needs Linux inotify";
+    return false;
+}
+
+bool DirectoryWatcher::wait(int, std::vector<DirectoryEvent>&, std::string& err)
+{
+    err = "directory watching needs Linux inotify";
+    return false;
+}
+
+void DirectoryWatcher::watch_new_directory(const std::filesystem::path&, std::vector<DirectoryEvent>&) {}
+
+#endif
+
+} // namespace defgen::detail
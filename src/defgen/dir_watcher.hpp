@@ -0,0 +1,54 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace defgen::detail
+{
+
+struct DirectoryEvent
+{
+    enum Kind
+    {
+        /// A writer closed the file, or it was renamed into place: its content is complete.
+        Written,
+        /// Data was written or the file was created; more may follow.
+        Modified,
+        /// The file, or with `directory`, a whole subtree, is gone (deleted or renamed away).
+        Removed,
+        /// Events were lost (queue overflow): the caller should rescan everything.
+        Rescan
+    };
+
+    Kind kind;
+    bool directory = false;
+    /// Spelled from the root passed to `add_tree`.
+    std::filesystem::path path;
+};
+
+/// Recursive directory watch on Linux inotify. Subdirectories created later are watched as soon as they appear, and
+/// the files already inside them are reported as `Modified`. Other platforms fail in `add_tree`.
+class DirectoryWatcher
+{
+  public:
+    DirectoryWatcher() = default;
+    ~DirectoryWatcher();
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    /// Watch `root` and every directory below it; append the regular files found to `files`.
+    [[nodiscard]] bool add_tree(const std::filesystem::path& root, std::vector<std::filesystem::path>& files, std::string& err);
+
+    /// Wait up to `timeout_ms` (-1 = forever) for events and append them to `out`. Returns false on a fatal error.
+    [[nodiscard]] bool wait(int timeout_ms, std::vector<DirectoryEvent>& out, std::string& err);
+
+  private:
+    void watch_new_directory(const std::filesystem::path& dir, std::vector<DirectoryEvent>& out);
+
+    int fd_ = -1;
+    std::unordered_map<int, std::filesystem::path> dirs_;
+};
+
+} // namespace defgen::detail
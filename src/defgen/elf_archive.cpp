@@ -0,0 +1,140 @@
+#include "ar_archive.hpp"
+#include "parsers.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+/// The GNU symbol index (`/`, or `/SYM64/` with 64-bit offsets) lists every member with a global definition; only its
+/// count and offsets are read, not the names after them.
+[[nodiscard]] bool read_armap(ObjectSource& source, const ar::Member& member, std::size_t width, std::vector<std::uint64_t>& out,
+                              std::string& err)
+{
+    std::span<const std::uint8_t> bytes;
+    if (member.size < width || !source.read(member.data_offset, width, bytes, err))
+    {
+        return false;
+    }
+    std::uint64_t count = 0;
+    for (std::size_t i = 0; i < width; i++)
+    {
+        count = (count << 8) | bytes[i];
+    }
+    if (count > (member.size - width) / width)
+    {
+        return false;
+    }
+    const std::uint64_t table = width * (count + 1);
+    return source.read(member.data_offset, static_cast<std::size_t>(table), bytes, err) && ar::read_symbol_index(bytes, out, width);
+}
+
+} // namespace
+
+int process_elf_archive(const std::filesystem::path& path, ObjectSource& source, SymbolCollector& out, std::string& err)
+{
+    const std::string label = path.filename().string();
+    const bool thin = ar::is_thin_archive(source);
+
+    // Bookkeeping members lead the archive: the symbol index (`/` or `/SYM64/`) and the long name table (`//`), which
+    // in a thin archive holds the member paths.
+    std::uint64_t at = ar::kSignatureSize;
+    ar::Member index;
+    std::size_t index_width = 0;
+    std::span<const std::uint8_t> long_names;
+    ar::Member member;
+    while (at < source.size())
+    {
+        if (!ar::read_member(source, at, member, err, thin))
+        {
+            err = label + ": " + err;
+            return -1;
+        }
+        if (!ar::is_special(member.name))
+        {
+            break;
+        }
+        if (member.name == "/" || member.name == "/SYM64/")
+        {
+            index = member;
+            index_width = member.name == "/" ? 4 : 8;
+        }
+        else if (member.name == "//" && !source.read(member.data_offset, static_cast<std::size_t>(member.size), long_names, err))
+        {
+            return -1;
+        }
+        at = member.next();
+    }
+    const std::uint64_t first_object = at;
+
+    // Members without a global definition (often without a symbol table at all) are not in the index and never
+    // touched. An archive without an index (`ar rcS`) is walked, and then every member must parse, as if extracted.
+    std::vector<std::uint64_t> defining;
+    const bool indexed = index_width != 0 && read_armap(source, index, index_width, defining, err);
+    if (!indexed)
+    {
+        defining.clear();
+        for (at = first_object; at < source.size(); at = member.next())
+        {
+            if (!ar::read_member(source, at, member, err, thin))
+            {
+                err = label + ": " + err;
+                return -1;
+            }
+            if (!ar::is_special(member.name))
+            {
+                defining.push_back(at);
+            }
+        }
+    }
+
+    std::string member_label;
+    for (const std::uint64_t offset : defining)
+    {
+        if (!ar::read_member(source, offset, member, err, thin))
+        {
+            err = label + ": " + err;
+            return -1;
+        }
+        if (ar::is_special(member.name))
+        {
+            continue;
+        }
+        const std::string name = ar::member_name(member.name, long_names);
+        member_label = label + '(' + name + ')';
+        int code = 0;
+        if (member.external)
+        {
+            // Thin member paths are relative to the archive's directory. Only the ranges the parser asks for are read.
+            const std::unique_ptr<ObjectSource> object = open_object_source(path.parent_path() / name, LoadMode::Ranged, err);
+            if (!object)
+            {
+                err = member_label + ": " + err;
+                return -1;
+            }
+            if (object->size() != member.size)
+            {
+                err = member_label + ": member changed since the archive was written (size mismatch)";
+                return -1;
+            }
+            code = process_elf_object(*object, out, err);
+        }
+        else
+        {
+            SliceObjectSource object(source, member.data_offset, member.size);
+            code = process_elf_object(object, out, err);
+        }
+        if (code != 0)
+        {
+            err = member_label + ": " + err;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+} // namespace defgen::detail
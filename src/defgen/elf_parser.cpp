@@ -1,20 +1,32 @@
 #include "elf_types.hpp"
+#include "name_kernels.hpp"
+#include "object_source.hpp"
+#include "parsers.hpp"
 
+#include <cstddef>
 #include <cstring>
 #include <filesystem>
-#include <fstream>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace defgen::detail
 {
 
-#define ELF_ST_TYPE(info) ((info) & 0xf)
-#define ELF_ST_BIND(info) ((info) >> 4)
+#define ELF_ST_INFO(bind, type) (((bind) << 4) + ((type) & 0xf))
 
 namespace
 {
 
+/// NUL-terminated string at `offset`, clamped to the end of `table`.
+[[nodiscard]] std::string_view c_string_at(std::span<const std::uint8_t> table, std::size_t offset)
+{
+    const char* str = reinterpret_cast<const char*>(table.data() + offset);
+    const void* end = std::memchr(str, 0, table.size() - offset);
+    return {str, end != nullptr ? static_cast<std::size_t>(static_cast<const char*>(end) - str) : table.size() - offset};
+}
+
 template <typename TOffset> struct OffsetAndSize
 {
     TOffset offset{};
@@ -23,7 +35,8 @@ template <typename TOffset> struct OffsetAndSize
 
 struct ElfImage
 {
-    std::vector<std::uint8_t> image;
+    /// Every range is fetched on demand; views are owned by the source, which must outlive the image.
+    ObjectSource* source = nullptr;
     unsigned e_shnum = 0;
 
     [[nodiscard]] int parse_ident(bool& is32bit, std::string& err) const
@@ -35,7 +48,12 @@ struct ElfImage
         constexpr int ELFCLASS32 = 1;
         constexpr int ELFCLASS64 = 2;
 
-        const ELFIdent& ident = *reinterpret_cast<const ELFIdent*>(image.data());
+        std::span<const std::uint8_t> bytes;
+        if (!source->read(0, sizeof(ELFIdent), bytes, err))
+        {
+            return -5;
+        }
+        const ELFIdent& ident = *reinterpret_cast<const ELFIdent*>(bytes.data());
         if (ident[0] != 0x7f || ident[1] != 'E' || ident[2] != 'L' || ident[3] != 'F')
         {
             err = "Invalid ELF header prefix";
@@ -61,10 +79,9 @@ struct ElfImage
     }
 
     template <typename TOffset>
-    [[nodiscard]] int get_string_table(const ElfHeader<TOffset>& header, byte4 sectionIndex, OffsetAndSize<TOffset>& stringTable,
+    [[nodiscard]] int get_string_table(const SectionHeader<TOffset>* sections, byte4 sectionIndex, OffsetAndSize<TOffset>& stringTable,
                                        std::string& err) const
     {
-        auto* sections = reinterpret_cast<const SectionHeader<TOffset>*>(&image[static_cast<size_t>(header.e_shoff)]);
         if (sectionIndex == 0 || static_cast<unsigned>(sectionIndex) >= e_shnum)
         {
             err = "Section index is out of range";
@@ -82,7 +99,7 @@ struct ElfImage
     }
 
     template <typename TOffset>
-    [[nodiscard]] int get_object_string_and_symbol_tables(const ElfHeader<TOffset>& header, OffsetAndSize<TOffset> headersStringTable,
+    [[nodiscard]] int get_object_string_and_symbol_tables(const SectionHeader<TOffset>* sections, OffsetAndSize<TOffset> headersStringTable,
                                                           int& stringTableIndex, int& symbolTableIndex, std::string& err) const
     {
         constexpr int SHT_SYMTAB = 2;
@@ -91,7 +108,12 @@ struct ElfImage
         stringTableIndex = -1;
         symbolTableIndex = -1;
 
-        auto* sections = reinterpret_cast<const SectionHeader<TOffset>*>(&image[static_cast<size_t>(header.e_shoff)]);
+        std::span<const std::uint8_t> names;
+        if (!source->read(headersStringTable.offset, static_cast<std::size_t>(headersStringTable.size), names, err))
+        {
+            return -6;
+        }
+
         for (int i = 0; i < static_cast<int>(e_shnum); i++)
         {
             const SectionHeader<TOffset>& section = sections[i];
@@ -100,10 +122,9 @@ struct ElfImage
                 err = "Invalid section name index";
                 return -1;
             }
-            const char* sectionName =
-                reinterpret_cast<const char*>(&image[static_cast<size_t>(headersStringTable.offset + section.sh_name)]);
+            const std::string_view sectionName = c_string_at(names, section.sh_name);
 
-            if (section.sh_type == SHT_STRTAB && std::strcmp(".strtab", sectionName) == 0)
+            if (section.sh_type == SHT_STRTAB && sectionName == ".strtab")
             {
                 if (stringTableIndex != -1)
                 {
@@ -112,7 +133,7 @@ struct ElfImage
                 }
                 stringTableIndex = i;
             }
-            else if (section.sh_type == SHT_SYMTAB && std::strcmp(".symtab", sectionName) == 0)
+            else if (section.sh_type == SHT_SYMTAB && sectionName == ".symtab")
             {
                 if (symbolTableIndex != -1)
                 {
@@ -137,16 +158,18 @@ struct ElfImage
     }
 
     template <typename TOffset>
-    [[nodiscard]] int get_symbols(const ElfHeader<TOffset>& header, int objectSymbolTableIndex, OffsetAndSize<TOffset> objectStringTable,
-                                  std::vector<std::string>& result, std::string& err) const
+    [[nodiscard]] int get_symbols(const SectionHeader<TOffset>* sections, int objectSymbolTableIndex, OffsetAndSize<TOffset> objectStringTable,
+                                  SymbolCollector& out, std::string& err) const
     {
         constexpr int STT_FUNC = 2;
         constexpr int STB_GLOBAL = 1;
 
-        auto* sections = reinterpret_cast<const SectionHeader<TOffset>*>(&image[static_cast<size_t>(header.e_shoff)]);
         const SectionHeader<TOffset>& objSymbolTableSec = sections[objectSymbolTableIndex];
-        auto* symbols = reinterpret_cast<const SymbolHeader<TOffset>*>(&image[static_cast<size_t>(objSymbolTableSec.sh_offset)]);
-
+        if (objSymbolTableSec.sh_entsize == 0)
+        {
+            err = "Invalid sh_entsize";
+            return -1;
+        }
         const TOffset symbolsCount = objSymbolTableSec.sh_size / objSymbolTableSec.sh_entsize;
         if (symbolsCount * sizeof(SymbolHeader<TOffset>) > objSymbolTableSec.sh_size + 1)
         {
@@ -159,45 +182,71 @@ struct ElfImage
             return -2;
         }
 
-        const char* table = reinterpret_cast<const char*>(&image[static_cast<size_t>(objectStringTable.offset)]);
+        std::span<const std::uint8_t> bytes;
+        if (!source->read(objSymbolTableSec.sh_offset, static_cast<std::size_t>(symbolsCount * sizeof(SymbolHeader<TOffset>)), bytes, err))
+        {
+            return -4;
+        }
+        auto* symbols = reinterpret_cast<const SymbolHeader<TOffset>*>(bytes.data());
 
-        for (TOffset i = 0; i < symbolsCount; i++)
+        std::span<const std::uint8_t> table;
+        if (!source->read(objectStringTable.offset, static_cast<std::size_t>(objectStringTable.size), table, err))
         {
-            const SymbolHeader<TOffset>& symbol = symbols[i];
-            const int stType = ELF_ST_TYPE(symbol.st_info);
-            const int stBind = ELF_ST_BIND(symbol.st_info);
+            return -5;
+        }
 
-            if (stType != STT_FUNC || stBind != STB_GLOBAL)
-            {
-                continue;
-            }
+        // Pick the STB_GLOBAL/STT_FUNC records with one scalar byte compare per record over the st_info bytes.
+        std::vector<std::uint32_t> selected;
+        select_records_by_byte(bytes.data() + offsetof(SymbolHeader<TOffset>, st_info), sizeof(SymbolHeader<TOffset>),
+                               static_cast<std::size_t>(symbolsCount), ELF_ST_INFO(STB_GLOBAL, STT_FUNC), selected);
+        for (const std::uint32_t i : selected)
+        {
+            const SymbolHeader<TOffset>& symbol = symbols[i];
             if (symbol.st_name >= objectStringTable.size)
             {
                 err = "Invalid function name offset";
                 return -3;
             }
-            result.emplace_back(&table[symbol.st_name]);
+            out.add(c_string_at(table, symbol.st_name), SymbolFunction);
         }
         return 0;
     }
 
-    template <typename TOffset> [[nodiscard]] int parse(std::vector<std::string>& result, std::string& err)
+    template <typename TOffset> [[nodiscard]] int parse(SymbolCollector& out, std::string& err)
     {
-        const ElfHeader<TOffset>& header = *reinterpret_cast<const ElfHeader<TOffset>*>(image.data());
-        auto* sections = reinterpret_cast<const SectionHeader<TOffset>*>(&image[static_cast<size_t>(header.e_shoff)]);
-        e_shnum = header.e_shnum;
-        if (e_shnum == 0)
+        std::span<const std::uint8_t> bytes;
+        if (!source->read(0, sizeof(ElfHeader<TOffset>), bytes, err))
         {
-            e_shnum = static_cast<unsigned>(sections[0].sh_size);
+            return -6;
         }
+        const ElfHeader<TOffset>& header = *reinterpret_cast<const ElfHeader<TOffset>*>(bytes.data());
+        e_shnum = header.e_shnum;
         byte4 shstrndx = header.e_shstrndx;
-        if (shstrndx == 0xffff)
+        if (e_shnum == 0 || shstrndx == 0xffff)
+        {
+            // Extended numbering: the real values live in section header 0.
+            if (!source->read(header.e_shoff, sizeof(SectionHeader<TOffset>), bytes, err))
+            {
+                return -7;
+            }
+            const auto& first = *reinterpret_cast<const SectionHeader<TOffset>*>(bytes.data());
+            if (e_shnum == 0)
+            {
+                e_shnum = static_cast<unsigned>(first.sh_size);
+            }
+            if (shstrndx == 0xffff)
+            {
+                shstrndx = first.sh_link;
+            }
+        }
+        if (!source->read(header.e_shoff, static_cast<std::size_t>(e_shnum) * sizeof(SectionHeader<TOffset>), bytes, err))
         {
-            shstrndx = sections[0].sh_link;
+            return -8;
         }
+        auto* sections = reinterpret_cast<const SectionHeader<TOffset>*>(bytes.data());
 
         OffsetAndSize<TOffset> headersStringTable{};
-        int ec = get_string_table(header, shstrndx, headersStringTable, err);
+        int ec = get_string_table(sections, shstrndx, headersStringTable, err);
         if (ec != 0)
         {
             return -20 + ec;
@@ -205,20 +254,20 @@ struct ElfImage
 
         int objStringTableIndex = 0;
         int objectSymbolTableIndex = 0;
-        ec = get_object_string_and_symbol_tables(header, headersStringTable, objStringTableIndex, objectSymbolTableIndex, err);
+        ec = get_object_string_and_symbol_tables(sections, headersStringTable, objStringTableIndex, objectSymbolTableIndex, err);
         if (ec != 0)
         {
             return -30 + ec;
         }
 
         OffsetAndSize<TOffset> objectStringTable{};
-        ec = get_string_table(header, static_cast<byte4>(objStringTableIndex), objectStringTable, err);
+        ec = get_string_table(sections, static_cast<byte4>(objStringTableIndex), objectStringTable, err);
         if (ec != 0)
         {
             return -40 + ec;
         }
 
-        ec = get_symbols(header, objectSymbolTableIndex, objectStringTable, result, err);
+        ec = get_symbols(sections, objectSymbolTableIndex, objectStringTable, out, err);
         if (ec != 0)
         {
             return -500 + ec;
@@ -226,54 +275,25 @@ struct ElfImage
         return 0;
     }
 
-    [[nodiscard]] int read_and_parse(const std::vector<std::uint8_t>& file_bytes, std::vector<std::string>& result, std::string& err)
+    [[nodiscard]] int read_and_parse(ObjectSource& src, SymbolCollector& out, std::string& err)
     {
-        image = file_bytes;
+        source = &src;
         bool is32bit = false;
         int ec = parse_ident(is32bit, err);
         if (ec != 0)
         {
             return -10 + ec;
         }
-        return is32bit ? parse<byte4>(result, err) : parse<byte8>(result, err);
+        return is32bit ? parse<byte4>(out, err) : parse<byte8>(out, err);
     }
 };
 
-[[nodiscard]] bool read_file_bytes(const std::filesystem::path& p, std::vector<std::uint8_t>& out, std::string& err)
-{
-    std::ifstream f(p, std::ios::binary);
-    if (!f)
-    {
-        err = "cannot open object file";
-        return false;
-    }
-    f.seekg(0, std::ios::end);
-    const auto sz = f.tellg();
-    if (sz < 0)
-    {
-        err = "cannot size object file";
-        return false;
-    }
-    f.seekg(0);
-    out.resize(static_cast<size_t>(sz));
-    if (sz > 0)
-    {
-        f.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(sz));
-    }
-    return true;
-}
-
 } // namespace
 
-[[nodiscard]] int process_elf_object(const std::filesystem::path& path, std::vector<std::string>& export_funcs, std::string& err)
+[[nodiscard]] int process_elf_object(ObjectSource& source, SymbolCollector& out, std::string& err)
 {
-    std::vector<std::uint8_t> bytes;
-    if (!read_file_bytes(path, bytes, err))
-    {
-        return -1;
-    }
     ElfImage img{};
-    return img.read_and_parse(bytes, export_funcs, err);
+    return img.read_and_parse(source, out, err);
 }
 
 } // namespace defgen::detail
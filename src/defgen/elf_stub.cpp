@@ -0,0 +1,286 @@
+#include "defgen/defgen.hpp"
+#include "def_file.hpp"
+#include "elf_types.hpp"
+#include "object_source.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace defgen
+{
+
+namespace
+{
+
+using namespace detail;
+
+constexpr std::string_view kStampTag = "defgen-so 1";
+/// Non-allocated section recording what the stub was built from (see `write_export_output`).
+constexpr std::string_view kStampSection = ".defgen";
+
+constexpr byte2 EM_386 = 3;
+constexpr byte2 EM_ARM = 40;
+constexpr byte2 EM_X86_64 = 62;
+constexpr byte2 EM_AARCH64 = 183;
+constexpr byte4 EF_ARM_EABI_VER5 = 0x05000000;
+
+constexpr byte2 ET_DYN = 3;
+constexpr byte4 PT_LOAD = 1;
+constexpr byte4 PT_DYNAMIC = 2;
+constexpr byte4 PF_R = 4;
+constexpr byte4 SHT_PROGBITS = 1;
+constexpr byte4 SHT_STRTAB = 3;
+constexpr byte4 SHT_DYNAMIC = 6;
+constexpr byte4 SHT_DYNSYM = 11;
+constexpr byte4 SHF_WRITE = 1;
+constexpr byte4 SHF_ALLOC = 2;
+constexpr byte4 SHF_EXECINSTR = 4;
+constexpr byte4 DT_NULL = 0;
+constexpr byte4 DT_STRTAB = 5;
+constexpr byte4 DT_SYMTAB = 6;
+constexpr byte4 DT_STRSZ = 10;
+constexpr byte4 DT_SYMENT = 11;
+constexpr byte4 DT_SONAME = 14;
+constexpr byte1 STB_GLOBAL = 1;
+constexpr byte1 STT_FUNC = 2;
+
+/// Section header indices of the stub.
+enum StubSection : byte2
+{
+    kDynsym = 1,
+    kDynstr,
+    kDynamic,
+    kText,
+    kStamp,
+    kShstrtab,
+    kSectionCount
+};
+
+constexpr char kSectionNames[] = "\0.dynsym\0.dynstr\0.dynamic\0.text\0.defgen\0.shstrtab";
+
+[[nodiscard]] byte4 section_name(std::string_view name)
+{
+    return static_cast<byte4>(std::string_view(kSectionNames, sizeof(kSectionNames)).find(name));
+}
+
+[[nodiscard]] std::size_t align_up(std::size_t v, std::size_t a) { return (v + a - 1) & ~(a - 1); }
+
+template <typename T> void store(std::vector<std::uint8_t>& out, std::size_t offset, const T& record)
+{
+    std::memcpy(out.data() + offset, &record, sizeof(T));
+}
+
+/// Layout: ELF header, program headers (`PT_LOAD` over everything up to `.dynamic`, `PT_DYNAMIC`), `.dynsym`, `.dynstr`,
+/// `.dynamic`, an empty `.text` the symbols are defined in, then the stamp, `.shstrtab` and the section headers.
+/// Addresses equal file offsets.
+template <typename TOffset>
+void build_stub(const DefExports& exports, const ElfStubOptions& options, std::string_view stamp, std::vector<std::uint8_t>& out)
+{
+    using Sym = SymbolHeader<TOffset>;
+    using Dyn = DynamicEntry<TOffset>;
+    constexpr std::size_t kAlign = sizeof(TOffset);
+
+    std::size_t dynstr_size = 1 + (options.soname.empty() ? 0 : options.soname.size() + 1);
+    for (const DefExport& e : exports.exports)
+    {
+        dynstr_size += e.name.size() + 1;
+    }
+    const std::size_t dyn_count = options.soname.empty() ? 5 : 6;
+
+    const std::size_t phdrs = sizeof(ElfHeader<TOffset>);
+    const std::size_t dynsym = align_up(phdrs + 2 * sizeof(ProgramHeader<TOffset>), kAlign);
+    const std::size_t dynsym_size = (exports.exports.size() + 1) * sizeof(Sym);
+    const std::size_t dynstr = dynsym + dynsym_size;
+    const std::size_t dynamic = align_up(dynstr + dynstr_size, kAlign);
+    const std::size_t dynamic_size = dyn_count * sizeof(Dyn);
+    const std::size_t text = dynamic + dynamic_size;
+    const std::size_t stamp_offset = text;
+    const std::size_t shstrtab = stamp_offset + stamp.size();
+    const std::size_t shdrs = align_up(shstrtab + sizeof(kSectionNames), kAlign);
+    out.assign(shdrs + kSectionCount * sizeof(SectionHeader<TOffset>), 0);
+
+    ElfHeader<TOffset> header{};
+    const byte1 ident[] = {0x7f, 'E', 'L', 'F', sizeof(TOffset) == 8 ? byte1{2} : byte1{1}, 1, 1};
+    std::memcpy(header.e_ident, ident, sizeof(ident));
+    header.e_type = ET_DYN;
+    header.e_machine = options.machine;
+    header.e_version = 1;
+    header.e_phoff = static_cast<TOffset>(phdrs);
+    header.e_shoff = static_cast<TOffset>(shdrs);
+    header.e_flags = options.machine == EM_ARM ? EF_ARM_EABI_VER5 : 0;
+    header.e_ehsize = sizeof(ElfHeader<TOffset>);
+    header.e_phentsize = sizeof(ProgramHeader<TOffset>);
+    header.e_phnum = 2;
+    header.e_shentsize = sizeof(SectionHeader<TOffset>);
+    header.e_shnum = kSectionCount;
+    header.e_shstrndx = kShstrtab;
+    store(out, 0, header);
+
+    ProgramHeader<TOffset> load{};
+    load.p_type = PT_LOAD;
+    load.p_flags = PF_R;
+    load.p_filesz = load.p_memsz = static_cast<TOffset>(text);
+    load.p_align = 0x1000;
+    store(out, phdrs, load);
+    ProgramHeader<TOffset> dyn_segment{};
+    dyn_segment.p_type = PT_DYNAMIC;
+    dyn_segment.p_flags = PF_R;
+    dyn_segment.p_offset = dyn_segment.p_vaddr = dyn_segment.p_paddr = static_cast<TOffset>(dynamic);
+    dyn_segment.p_filesz = dyn_segment.p_memsz = static_cast<TOffset>(dynamic_size);
+    dyn_segment.p_align = kAlign;
+    store(out, phdrs + sizeof(load), dyn_segment);
+
+    // Symbol 0 and string 0 stay null; the soname leads the strings.
+    std::size_t str = 1;
+    TOffset soname = 0;
+    if (!options.soname.empty())
+    {
+        soname = static_cast<TOffset>(str);
+        std::memcpy(out.data() + dynstr + str, options.soname.data(), options.soname.size());
+        str += options.soname.size() + 1;
+    }
+    for (std::size_t i = 0; i < exports.exports.size(); i++)
+    {
+        const std::string_view name = exports.exports[i].name;
+        Sym sym{};
+        sym.st_name = static_cast<byte4>(str);
+        sym.st_info = static_cast<byte1>((STB_GLOBAL << 4) | STT_FUNC);
+        sym.st_shndx = kText;
+        sym.st_value = static_cast<TOffset>(text);
+        store(out, dynsym + (i + 1) * sizeof(Sym), sym);
+        std::memcpy(out.data() + dynstr + str, name.data(), name.size());
+        str += name.size() + 1;
+    }
+
+    std::size_t d = dynamic;
+    auto dyn = [&](byte4 tag, std::size_t value) {
+        store(out, d, Dyn{static_cast<TOffset>(tag), static_cast<TOffset>(value)});
+        d += sizeof(Dyn);
+    };
+    if (!options.soname.empty())
+    {
+        dyn(DT_SONAME, soname);
+    }
+    dyn(DT_SYMTAB, dynsym);
+    dyn(DT_STRTAB, dynstr);
+    dyn(DT_STRSZ, dynstr_size);
+    dyn(DT_SYMENT, sizeof(Sym));
+    dyn(DT_NULL, 0);
+
+    std::memcpy(out.data() + stamp_offset, stamp.data(), stamp.size());
+    std::memcpy(out.data() + shstrtab, kSectionNames, sizeof(kSectionNames));
+
+    auto section = [&](StubSection index, std::string_view name, byte4 type, byte4 flags, std::size_t offset, std::size_t size,
+                       byte4 link, byte4 info, std::size_t align, std::size_t entsize) {
+        SectionHeader<TOffset> sh{};
+        sh.sh_name = section_name(name);
+        sh.sh_type = type;
+        sh.sh_flags = flags;
+        sh.sh_addr = static_cast<TOffset>((flags & SHF_ALLOC) != 0 ? offset : 0);
+        sh.sh_offset = static_cast<TOffset>(offset);
+        sh.sh_size = static_cast<TOffset>(size);
+        sh.sh_link = link;
+        sh.sh_info = info;
+        sh.sh_addralign = static_cast<TOffset>(align);
+        sh.sh_entsize = static_cast<TOffset>(entsize);
+        store(out, shdrs + index * sizeof(SectionHeader<TOffset>), sh);
+    };
+    section(kDynsym, ".dynsym", SHT_DYNSYM, SHF_ALLOC, dynsym, dynsym_size, kDynstr, 1, kAlign, sizeof(Sym));
+    section(kDynstr, ".dynstr", SHT_STRTAB, SHF_ALLOC, dynstr, dynstr_size, 0, 0, 1, 0);
+    section(kDynamic, ".dynamic", SHT_DYNAMIC, SHF_ALLOC | SHF_WRITE, dynamic, dynamic_size, kDynstr, 0, kAlign, sizeof(Dyn));
+    section(kText, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text, 0, 0, 0, kAlign, 0);
+    section(kStamp, kStampSection, SHT_PROGBITS, 0, stamp_offset, stamp.size(), 0, 0, 1, 0);
+    section(kShstrtab, ".shstrtab", SHT_STRTAB, 0, shstrtab, sizeof(kSectionNames), 0, 0, 1, 0);
+}
+
+/// True if `source` is an ELF file of class `TOffset` whose stamp section holds `stamp`: the header, the section
+/// headers, the section name table and the stamp are read.
+template <typename TOffset> [[nodiscard]] bool elf_stamp_matches(ObjectSource& source, std::string_view stamp)
+{
+    std::string err;
+    std::span<const std::uint8_t> bytes;
+    if (source.size() < sizeof(ElfHeader<TOffset>) || !source.read(0, sizeof(ElfHeader<TOffset>), bytes, err))
+    {
+        return false;
+    }
+    ElfHeader<TOffset> header{};
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.e_shentsize != sizeof(SectionHeader<TOffset>) || header.e_shstrndx >= header.e_shnum ||
+        !source.read(header.e_shoff, header.e_shnum * sizeof(SectionHeader<TOffset>), bytes, err))
+    {
+        return false;
+    }
+    std::vector<SectionHeader<TOffset>> sections(header.e_shnum);
+    std::memcpy(sections.data(), bytes.data(), sections.size() * sizeof(SectionHeader<TOffset>));
+    const SectionHeader<TOffset>& names = sections[header.e_shstrndx];
+    if (!source.read(names.sh_offset, static_cast<std::size_t>(names.sh_size), bytes, err))
+    {
+        return false;
+    }
+    const std::string_view table(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    for (const SectionHeader<TOffset>& section : sections)
+    {
+        const std::string_view name = section.sh_name < table.size() ? table.substr(section.sh_name) : std::string_view{};
+        if (name.substr(0, name.find('\0')) == kStampSection)
+        {
+            return section.sh_size == stamp.size() && source.read(section.sh_offset, stamp.size(), bytes, err) &&
+                   std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()) == stamp;
+        }
+    }
+    return false;
+}
+
+[[nodiscard]] bool elf_stub_stamped(const std::filesystem::path& stub_path, std::string_view stamp)
+{
+    std::string err;
+    const std::unique_ptr<ObjectSource> source = open_object_source(stub_path, LoadMode::Ranged, err);
+    std::span<const std::uint8_t> ident;
+    if (!source || source->size() < sizeof(ELFIdent) || !source->read(0, sizeof(ELFIdent), ident, err))
+    {
+        return false;
+    }
+    return ident[4] == 2 ? elf_stamp_matches<byte8>(*source, stamp) : elf_stamp_matches<byte4>(*source, stamp);
+}
+
+} // namespace
+
+Errc write_elf_stub(const std::filesystem::path& emd_path, const std::filesystem::path& stub_path, const ElfStubOptions& options,
+                    bool& unchanged, std::string& message)
+{
+    const bool elf64 = options.machine == EM_X86_64 || options.machine == EM_AARCH64;
+    if (!elf64 && options.machine != EM_386 && options.machine != EM_ARM)
+    {
+        unchanged = false;
+        message = "unsupported ELF machine " + std::to_string(options.machine);
+        return Errc::InvalidArgument;
+    }
+    char machine[8] = {};
+    std::snprintf(machine, sizeof(machine), "%04x", options.machine);
+    const std::string target = std::string(machine) + ' ' + options.soname;
+    return write_export_output(
+        emd_path, stub_path, kStampTag, target, read_emd_exports, elf_stub_stamped,
+        [&](const DefExports& exports, std::string_view stamp, std::vector<std::uint8_t>& out, std::string& msg) {
+            std::vector<std::string_view> names(exports.exports.size());
+            std::transform(exports.exports.begin(), exports.exports.end(), names.begin(), [](const DefExport& e) { return e.name; });
+            std::sort(names.begin(), names.end());
+            const auto twice = std::adjacent_find(names.begin(), names.end());
+            if (twice != names.end())
+            {
+                msg = std::string(*twice) + " is exported twice";
+                return Errc::Parse;
+            }
+            if (elf64)
+            {
+                build_stub<byte8>(exports, options, stamp, out);
+            }
+            else
+            {
+                build_stub<byte4>(exports, options, stamp, out);
+            }
+            return Errc::Ok;
+        },
+        unchanged, message);
+}
+
+} // namespace defgen
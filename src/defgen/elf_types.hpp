@@ -66,4 +66,36 @@ template <> struct SymbolHeader<byte8>
     byte8 st_size;
 };
 
+template <typename TOffset> struct ProgramHeader;
+
+template <> struct ProgramHeader<byte4>
+{
+    byte4 p_type;
+    byte4 p_offset;
+    byte4 p_vaddr;
+    byte4 p_paddr;
+    byte4 p_filesz;
+    byte4 p_memsz;
+    byte4 p_flags;
+    byte4 p_align;
+};
+
+template <> struct ProgramHeader<byte8>
+{
+    byte4 p_type;
+    byte4 p_flags;
+    byte8 p_offset;
+    byte8 p_vaddr;
+    byte8 p_paddr;
+    byte8 p_filesz;
+    byte8 p_memsz;
+    byte8 p_align;
+};
+
+template <typename TOffset> struct DynamicEntry
+{
+    TOffset d_tag;
+    TOffset d_val;
+};
+
 } // namespace defgen::detail
@@ -0,0 +1,201 @@
+#include "export_lines.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+constexpr std::string_view kExportHashKey = "ExportHash=";
+constexpr std::size_t kExportHashDigits = 32;
+
+/// Two XXH64 lanes with different seeds over the text (each line plus `\n`): 128 bits, so an accidental match of a
+/// changed export set is not a practical concern. Not meant to resist deliberate collisions.
+class BodyHasher final : public ExportSink
+{
+  public:
+    BodyHasher() { pending_.reserve(kBlock + 4096); }
+
+    void line(std::string_view text) override
+    {
+        pending_.append(text);
+        pending_.push_back('\n');
+        if (pending_.size() >= kBlock)
+        {
+            flush();
+        }
+    }
+
+    [[nodiscard]] std::string hex()
+    {
+        flush();
+        char buf[kExportHashDigits + 1] = {};
+        std::snprintf(buf, sizeof(buf), "%016llx%016llx", static_cast<unsigned long long>(high_.digest()),
+                      static_cast<unsigned long long>(low_.digest()));
+        return buf;
+    }
+
+  private:
+    /// Lines are hashed in blocks: per-line updates would cost more than the hashing itself.
+    static constexpr std::size_t kBlock = 64 * 1024;
+
+    void flush()
+    {
+        low_.update(pending_);
+        high_.update(pending_);
+        pending_.clear();
+    }
+
+    std::string pending_;
+    Xxh64::State low_{0};
+    Xxh64::State high_{0x9E3779B97F4A7C15ull};
+};
+
+void write_export_body(const std::vector<std::string_view>& names, const GenerateOptions& options, ExportSink& sink,
+                       std::span<const ExportOrdinal> ordinals)
+{
+    if (options.elf_style_export_block)
+    {
+        if (!options.library_basename.empty())
+        {
+            sink.line(std::string("Library: ") + options.library_basename + " {");
+        }
+        sink.line("export: {");
+        for (const auto& s : names)
+        {
+            sink.line(s);
+        }
+        sink.line("}");
+        if (!options.library_basename.empty())
+        {
+            sink.line("}");
+        }
+    }
+    else
+    {
+        sink.line("EXPORTS");
+        if (ordinals.empty())
+        {
+            for (const auto& s : names)
+            {
+                sink.line(s);
+            }
+            return;
+        }
+        std::string line;
+        for (std::size_t i = 0; i < names.size(); i++)
+        {
+            char ordinal[16];
+            const auto r = std::to_chars(ordinal, ordinal + sizeof(ordinal), ordinals[i].ordinal);
+            line.assign(names[i]);
+            line += " @";
+            line.append(ordinal, r.ptr);
+            if (!ordinals[i].named)
+            {
+                line += " NONAME";
+            }
+            sink.line(line);
+        }
+    }
+}
+
+} // namespace
+
+bool line_has_export_hash(std::string_view line)
+{
+    if (line.size() < kExportHashKey.size() + kExportHashDigits || (line.front() != ';' && line.substr(0, 2) != "//"))
+    {
+        return false;
+    }
+    const std::size_t key = line.size() - kExportHashDigits - kExportHashKey.size();
+    if (line.substr(key, kExportHashKey.size()) != kExportHashKey || (line[key - 1] != ' ' && line[key - 1] != ';' && line[key - 1] != '/'))
+    {
+        return false;
+    }
+    return std::all_of(line.end() - kExportHashDigits, line.end(), [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+}
+
+void write_export_lines(const std::vector<std::string_view>& names, const GenerateOptions& options, ExportSink& sink,
+                        std::span<const ExportOrdinal> ordinals)
+{
+    if (options.export_hash_in_header)
+    {
+        // One extra pass over the names (views, nothing is built) so the hash can lead the file.
+        BodyHasher hasher;
+        write_export_body(names, options, hasher, ordinals);
+        std::string header;
+        if (options.object_count_line.has_value() && !options.object_count_line->empty())
+        {
+            header = *options.object_count_line + ' ';
+        }
+        else
+        {
+            header = options.elf_style_export_block ? "//" : ";";
+        }
+        header += kExportHashKey;
+        header += hasher.hex();
+        sink.line(header);
+    }
+    else if (options.object_count_line.has_value())
+    {
+        sink.line(*options.object_count_line);
+    }
+    write_export_body(names, options, sink, ordinals);
+}
+
+void append_export_lines(const std::vector<std::string_view>& names, const GenerateOptions& options, std::vector<std::string>& lines,
+                         std::span<const ExportOrdinal> ordinals)
+{
+    lines.reserve(lines.size() + names.size() + 5);
+    LineCollector sink(lines);
+    write_export_lines(names, options, sink, ordinals);
+}
+
+std::uint64_t hash_export_lines(const std::vector<std::string>& lines)
+{
+    Xxh64::State h;
+    for (const std::string& line : lines)
+    {
+        h.update(line);
+        h.update("\n", 1);
+        if (&line == &lines.front() && line_has_export_hash(line))
+        {
+            break;
+        }
+    }
+    return h.digest();
+}
+
+bool hash_export_file(const std::filesystem::path& path, std::uint64_t& out)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f)
+    {
+        return false;
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(f, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        lines.push_back(std::move(line));
+        if (lines.size() == 1 && line_has_export_hash(lines.front()))
+        {
+            break;
+        }
+    }
+    out = hash_export_lines(lines);
+    return true;
+}
+
+} // namespace defgen::detail
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "defgen/defgen.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// Ordinal of one export in ordinal mode (see `GenerateOptions::ordinal_database`).
+struct ExportOrdinal
+{
+    std::uint16_t ordinal = 0;
+    /// Keep the name in the export name table: `name @N` instead of `name @N NONAME`.
+    bool named = false;
+};
+
+/// Emit the `.def` (`EXPORTS`) or EMD (`Library:` / `export:`) text for `names` (sorted, filtered) into `sink`.
+/// Shared by `generate_def`, `ExportSetBuilder::snapshot` and the daemon so all produce identical output. `ordinals`
+/// is either empty or parallel to `names` (`.def` only).
+void write_export_lines(const std::vector<std::string_view>& names, const GenerateOptions& options, ExportSink& sink,
+                        std::span<const ExportOrdinal> ordinals = {});
+
+/// True if `line` is a header comment ending in ` ExportHash=<32 hex digits>` (see `export_hash_in_header`).
+[[nodiscard]] bool line_has_export_hash(std::string_view line);
+
+/// Sink that keeps the lines, for `GenerateOutput::lines`.
+class LineCollector final : public ExportSink
+{
+  public:
+    explicit LineCollector(std::vector<std::string>& lines)
+        : lines_(lines)
+    {
+    }
+
+    void line(std::string_view text) override { lines_.emplace_back(text); }
+
+  private:
+    std::vector<std::string>& lines_;
+};
+
+/// `write_export_lines` into `lines`.
+void append_export_lines(const std::vector<std::string_view>& names, const GenerateOptions& options, std::vector<std::string>& lines,
+                         std::span<const ExportOrdinal> ordinals = {});
+
+/// Fingerprint of export text: XXH64 of `lines`, each followed by `\n` (the bytes of the written export file). When the
+/// first line carries an export hash it already stands for the rest, so only that line is hashed.
+[[nodiscard]] std::uint64_t hash_export_lines(const std::vector<std::string>& lines);
+
+/// `hash_export_lines` of an existing export file read line by line (a `\r` before each newline is ignored, as in
+/// `def_file_matches`); reads just the first line when it carries an export hash. False if the file cannot be read.
+[[nodiscard]] bool hash_export_file(const std::filesystem::path& path, std::uint64_t& out);
+
+} // namespace defgen::detail
@@ -0,0 +1,186 @@
+#include "defgen/defgen.hpp"
+#include "coff_writer.hpp"
+#include "object_source.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace defgen
+{
+
+namespace
+{
+
+using namespace detail;
+using namespace coff;
+
+using Header = SCoffImage::SCoffHeader;
+using Section = SCoffImage::SCoffSection;
+using Symbol = SCoffImage::SCoffSymbol;
+using SectionDefinition = SCoffImage::SCoffSectionDefinition;
+using Relocation = SCoffImage::SCoffRelocation;
+
+constexpr std::string_view kStampTag = "defgen-exp 1";
+
+/// IMAGE_EXPORT_DIRECTORY field offsets.
+constexpr std::uint32_t kDirectorySize = 40;
+constexpr std::uint32_t kDirName = 12;
+constexpr std::uint32_t kDirBase = 16;
+constexpr std::uint32_t kDirFunctions = 20;
+constexpr std::uint32_t kDirNames = 24;
+constexpr std::uint32_t kDirAddressOfFunctions = 28;
+constexpr std::uint32_t kDirAddressOfNames = 32;
+constexpr std::uint32_t kDirAddressOfNameOrdinals = 36;
+
+[[nodiscard]] bool export_object_stamped(const std::filesystem::path& exp_path, std::string_view stamp)
+{
+    std::string err;
+    const std::unique_ptr<ObjectSource> source = open_object_source(exp_path, LoadMode::Ranged, err);
+    return source && coff_stamp_matches(*source, stamp);
+}
+
+/// Lay out the `.exp` for `def`. Sections: 1 `.edata` (export data plus relocations), 2 the stamp. Symbols: the
+/// `.edata` section symbol (with its aux record), then one undefined external per export, in `.def` order.
+[[nodiscard]] Errc build_export_object(const DefExports& def, const ExportObjectOptions& options, std::string_view stamp,
+                                       std::vector<std::uint8_t>& out, std::string& message)
+{
+    const word reloc_type = image_relative_relocation(options.machine);
+    if (reloc_type == 0)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "unsupported machine 0x%04x", options.machine);
+        message = buf;
+        return Errc::InvalidArgument;
+    }
+    ExportTable table;
+    const Errc ec = lay_out_export_table(def, table, message);
+    if (ec != Errc::Ok)
+    {
+        return ec;
+    }
+    const std::vector<DefExport>& exports = def.exports;
+    const auto names = static_cast<std::uint32_t>(table.by_name.size());
+
+    // .edata: directory, address table, name pointer table, ordinal table, DLL name, export names.
+    const std::uint32_t address_table = kDirectorySize;
+    const std::uint32_t name_pointers = address_table + 4 * table.functions;
+    const std::uint32_t name_ordinals = name_pointers + 4 * names;
+    const std::uint32_t dll_name = name_ordinals + 2 * names;
+    std::uint32_t edata_size = dll_name + static_cast<std::uint32_t>(options.dll_name.size()) + 1;
+    for (const std::uint32_t i : table.by_name)
+    {
+        edata_size += static_cast<std::uint32_t>(exports[i].name.size()) + 1;
+    }
+
+    // Directory fields and name pointers are section-relative (the addend sits in the field); address table entries
+    // point at the exported symbols.
+    constexpr dword kSectionSymbol = 0;
+    constexpr dword kFirstExportSymbol = 2;
+    std::vector<Relocation> relocs;
+    relocs.reserve(4 + table.functions + names);
+    for (const std::uint32_t field : {kDirName, kDirAddressOfFunctions, kDirAddressOfNames, kDirAddressOfNameOrdinals})
+    {
+        relocs.push_back({field, kSectionSymbol, reloc_type});
+    }
+    for (std::uint32_t k = 0; k < table.functions; k++)
+    {
+        if (table.slots[k] != 0)
+        {
+            relocs.push_back({address_table + 4 * k, kFirstExportSymbol + table.slots[k] - 1, reloc_type});
+        }
+    }
+    for (std::uint32_t k = 0; k < names; k++)
+    {
+        relocs.push_back({name_pointers + 4 * k, kSectionSymbol, reloc_type});
+    }
+    // More than 0xFFFF relocations: the count moves into an extra first record.
+    const bool overflow = relocs.size() >= 0xFFFF;
+    if (overflow)
+    {
+        relocs.insert(relocs.begin(), {static_cast<dword>(relocs.size() + 1), 0, 0});
+    }
+
+    const std::uint32_t stamp_offset = sizeof(Header) + 2 * sizeof(Section);
+    const std::uint32_t edata_offset = stamp_offset + static_cast<std::uint32_t>(stamp.size());
+    const std::uint32_t relocs_offset = edata_offset + edata_size;
+    const std::uint32_t symbols_offset = relocs_offset + static_cast<std::uint32_t>(relocs.size() * sizeof(Relocation));
+    const auto symbol_count = static_cast<dword>(kFirstExportSymbol + exports.size());
+
+    out.clear();
+    out.reserve(symbols_offset + symbol_count * sizeof(Symbol) + exports.size() * 16);
+    Header header{};
+    header.machine = options.machine;
+    header.nSections = 2;
+    header.pSymbols = symbols_offset;
+    header.nSymbols = symbol_count;
+    append_record(out, header);
+
+    Section edata{};
+    std::memcpy(edata.szName, ".edata", 6);
+    edata.dwSize = edata_size;
+    edata.pData = edata_offset;
+    edata.pRelocs = relocs_offset;
+    edata.nRelocs = overflow ? word{0xFFFF} : static_cast<word>(relocs.size());
+    edata.flags = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_ALIGN_4BYTES | IMAGE_SCN_MEM_READ | (overflow ? IMAGE_SCN_LNK_NRELOC_OVFL : 0);
+    append_record(out, edata);
+    append_record(out, stamp_section(stamp_offset, static_cast<dword>(stamp.size())));
+    out.insert(out.end(), stamp.begin(), stamp.end());
+
+    out.resize(edata_offset + dll_name, 0);
+    put_le<dword>(out, edata_offset + kDirName, dll_name);
+    put_le<dword>(out, edata_offset + kDirBase, table.base);
+    put_le<dword>(out, edata_offset + kDirFunctions, table.functions);
+    put_le<dword>(out, edata_offset + kDirNames, names);
+    put_le<dword>(out, edata_offset + kDirAddressOfFunctions, address_table);
+    put_le<dword>(out, edata_offset + kDirAddressOfNames, name_pointers);
+    put_le<dword>(out, edata_offset + kDirAddressOfNameOrdinals, name_ordinals);
+    out.insert(out.end(), options.dll_name.begin(), options.dll_name.end());
+    out.push_back(0);
+    for (std::uint32_t k = 0; k < names; k++)
+    {
+        const std::uint32_t i = table.by_name[k];
+        put_le<dword>(out, edata_offset + name_pointers + 4 * k, static_cast<dword>(out.size() - edata_offset));
+        put_le<word>(out, edata_offset + name_ordinals + 2 * k, static_cast<word>(table.ordinals[i] - table.base));
+        out.insert(out.end(), exports[i].name.begin(), exports[i].name.end());
+        out.push_back(0);
+    }
+
+    for (const Relocation& reloc : relocs)
+    {
+        append_record(out, reloc);
+    }
+
+    std::string strings(sizeof(dword), '\0');
+    Symbol section_symbol{};
+    set_coff_name(section_symbol.szName, ".edata", strings);
+    section_symbol.nSection = 1;
+    section_symbol.nStorageClass = IMAGE_SYM_CLASS_STATIC;
+    section_symbol.nAuxSymbols = 1;
+    append_record(out, section_symbol);
+    SectionDefinition definition{};
+    definition.dwSize = edata_size;
+    definition.nRelocs = edata.nRelocs;
+    append_record(out, definition);
+    std::string name;
+    for (const DefExport& e : exports)
+    {
+        Symbol symbol{};
+        def_symbol_name(e.name, options.machine, name);
+        set_coff_name(symbol.szName, name, strings);
+        symbol.nType = IMAGE_SYM_DTYPE_FUNCTION;
+        symbol.nStorageClass = IMAGE_SYM_CLASS_EXTERNAL;
+        append_record(out, symbol);
+    }
+    append_string_table(out, strings);
+    return Errc::Ok;
+}
+
+} // namespace
+
+Errc write_export_object(const std::filesystem::path& def_path, const std::filesystem::path& exp_path, const ExportObjectOptions& options,
+                         bool& unchanged, std::string& message)
+{
+    return write_def_output(def_path, exp_path, options, kStampTag, export_object_stamped, build_export_object, unchanged, message);
+}
+
+} // namespace defgen
@@ -0,0 +1,249 @@
+#include "defgen/defgen.hpp"
+#include "export_lines.hpp"
+#include "file_util.hpp"
+#include "ignore_matcher.hpp"
+#include "object_source.hpp"
+#include "parsers.hpp"
+#include "symbol_pool.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+namespace defgen
+{
+
+struct ExportSetBuilder::Impl
+{
+    /// Byte-wise name order, the same order `generate_def` sorts exports into.
+    struct NameLess
+    {
+        bool operator()(detail::SymbolHandle a, detail::SymbolHandle b) const { return a->view() < b->view(); }
+    };
+
+    Impl(ObjectFormat f, GenerateOptions o)
+        : format(f)
+        , options(std::move(o))
+        , ignores(options.ignore_substrings)
+    {
+    }
+
+    /// The pool is rebuilt from the live names once the dead ones (no longer contributed by any object, or never
+    /// functions) take more than this many bytes and outweigh the live ones, so churning names do not grow it forever.
+    static constexpr std::size_t kCompactMinDeadBytes = std::size_t{1} << 20;
+
+    ObjectFormat format;
+    GenerateOptions options;
+    detail::IgnoreMatcher ignores;
+    std::unique_ptr<detail::SymbolPool> pool = std::make_unique<detail::SymbolPool>();
+    /// Pool bytes of the names in `refs`.
+    std::size_t live_bytes = 0;
+    /// Per object: the distinct function names it contributes, sorted by handle for cheap diffs.
+    std::unordered_map<std::string, std::vector<detail::SymbolHandle>> objects;
+    /// Number of objects contributing each function name; a name is exported while its count is non-zero.
+    std::unordered_map<detail::SymbolHandle, std::uint32_t> refs;
+    std::set<detail::SymbolHandle, NameLess> exports;
+
+    [[nodiscard]] Errc parse(const std::filesystem::path& path, std::vector<detail::SymbolHandle>& funcs, std::string& message)
+    {
+        const ObjectFormat fmt = detail::resolve_object_format(path, format);
+        const std::unique_ptr<detail::ObjectSource> source = detail::open_object_source(path, options.load_mode, message);
+        if (!source)
+        {
+            return Errc::Parse;
+        }
+        std::vector<detail::TracedSymbol> traced;
+        detail::SymbolCollector collector(*pool);
+        collector.trace = &traced;
+        if (detail::parse_object(path, fmt, *source, collector, message) != 0)
+        {
+            return Errc::Parse;
+        }
+        funcs.clear();
+        for (const detail::TracedSymbol& s : traced)
+        {
+            if (s.kind == detail::SymbolFunction)
+            {
+                funcs.push_back(s.name);
+            }
+        }
+        std::sort(funcs.begin(), funcs.end(), std::less<>());
+        funcs.erase(std::unique(funcs.begin(), funcs.end()), funcs.end());
+        return Errc::Ok;
+    }
+
+    void retain(detail::SymbolHandle name)
+    {
+        if (refs[name]++ != 0)
+        {
+            return;
+        }
+        live_bytes += detail::SymbolPool::entry_bytes(name->size);
+        if (!ignores.matches(name->view()))
+        {
+            exports.insert(name);
+        }
+    }
+
+    void release(detail::SymbolHandle name)
+    {
+        const auto it = refs.find(name);
+        if (--it->second == 0)
+        {
+            live_bytes -= detail::SymbolPool::entry_bytes(name->size);
+            refs.erase(it);
+            exports.erase(name);
+        }
+    }
+
+    /// Re-intern the live names into a fresh pool and move every handle over to it.
+    void compact_if_mostly_dead()
+    {
+        const std::size_t dead_bytes = pool->bytes() - live_bytes;
+        if (dead_bytes < kCompactMinDeadBytes || dead_bytes < live_bytes)
+        {
+            return;
+        }
+        auto fresh = std::make_unique<detail::SymbolPool>();
+        std::unordered_map<detail::SymbolHandle, detail::SymbolHandle> moved;
+        moved.reserve(refs.size());
+        std::unordered_map<detail::SymbolHandle, std::uint32_t> fresh_refs;
+        fresh_refs.reserve(refs.size());
+        for (const auto& [name, count] : refs)
+        {
+            bool first = false;
+            const detail::SymbolHandle to = fresh->intern(name->view(), name->hash, detail::SymbolFunction, first);
+            moved.emplace(name, to);
+            fresh_refs.emplace(to, count);
+        }
+        std::set<detail::SymbolHandle, NameLess> fresh_exports;
+        for (const detail::SymbolHandle name : exports)
+        {
+            fresh_exports.insert(fresh_exports.end(), moved.at(name));
+        }
+        for (auto& [key, funcs] : objects)
+        {
+            for (detail::SymbolHandle& name : funcs)
+            {
+                name = moved.at(name);
+            }
+            std::sort(funcs.begin(), funcs.end(), std::less<>());
+        }
+        refs = std::move(fresh_refs);
+        exports = std::move(fresh_exports);
+        pool = std::move(fresh);
+    }
+};
+
+ExportSetBuilder::ExportSetBuilder(ObjectFormat format, GenerateOptions options)
+    : impl_(std::make_unique<Impl>(format, std::move(options)))
+{
+}
+
+ExportSetBuilder::~ExportSetBuilder() = default;
+ExportSetBuilder::ExportSetBuilder(ExportSetBuilder&&) noexcept = default;
+ExportSetBuilder& ExportSetBuilder::operator=(ExportSetBuilder&&) noexcept = default;
+
+Errc ExportSetBuilder::add_object(const std::filesystem::path& path, std::string& message)
+{
+    std::string key = detail::path_key(path);
+    if (impl_->objects.count(key) != 0)
+    {
+        message = "object already added: " + key;
+        return Errc::InvalidArgument;
+    }
+    std::vector<detail::SymbolHandle> funcs;
+    const Errc ec = impl_->parse(path, funcs, message);
+    if (ec != Errc::Ok)
+    {
+        return ec;
+    }
+    for (const detail::SymbolHandle name : funcs)
+    {
+        impl_->retain(name);
+    }
+    impl_->objects.emplace(std::move(key), std::move(funcs));
+    impl_->compact_if_mostly_dead();
+    return Errc::Ok;
+}
+
+Errc ExportSetBuilder::update_object(const std::filesystem::path& path, std::string& message)
+{
+    const auto it = impl_->objects.find(detail::path_key(path));
+    if (it == impl_->objects.end())
+    {
+        return add_object(path, message);
+    }
+    std::vector<detail::SymbolHandle> funcs;
+    const Errc ec = impl_->parse(path, funcs, message);
+    if (ec != Errc::Ok)
+    {
+        return ec;
+    }
+    // Both lists are sorted by handle: retain what is new, release what is gone, leave the rest alone.
+    const std::vector<detail::SymbolHandle>& old = it->second;
+    const std::less<> before;
+    auto a = old.begin();
+    auto b = funcs.begin();
+    while (a != old.end() || b != funcs.end())
+    {
+        if (b == funcs.end() || (a != old.end() && before(*a, *b)))
+        {
+            impl_->release(*a++);
+        }
+        else if (a == old.end() || before(*b, *a))
+        {
+            impl_->retain(*b++);
+        }
+        else
+        {
+            ++a;
+            ++b;
+        }
+    }
+    it->second = std::move(funcs);
+    impl_->compact_if_mostly_dead();
+    return Errc::Ok;
+}
+
+bool ExportSetBuilder::remove_object(const std::filesystem::path& path)
+{
+    const auto it = impl_->objects.find(detail::path_key(path));
+    if (it == impl_->objects.end())
+    {
+        return false;
+    }
+    for (const detail::SymbolHandle name : it->second)
+    {
+        impl_->release(name);
+    }
+    impl_->objects.erase(it);
+    impl_->compact_if_mostly_dead();
+    return true;
+}
+
+bool ExportSetBuilder::contains(const std::filesystem::path& path) const { return impl_->objects.count(detail::path_key(path)) != 0; }
+
+std::size_t ExportSetBuilder::object_count() const { return impl_->objects.size(); }
+
+std::size_t ExportSetBuilder::export_count() const { return impl_->exports.size(); }
+
+void ExportSetBuilder::set_object_count_line(std::optional<std::string> line) { impl_->options.object_count_line = std::move(line); }
+
+GenerateOutput ExportSetBuilder::snapshot() const
+{
+    std::vector<std::string_view> names;
+    names.reserve(impl_->exports.size());
+    for (const detail::SymbolHandle name : impl_->exports)
+    {
+        names.push_back(name->view());
+    }
+    GenerateOutput out;
+    detail::append_export_lines(names, impl_->options, out.lines);
+    return out;
+}
+
+} // namespace defgen
@@ -0,0 +1,368 @@
+#include "defgen/defgen.hpp"
+#include "dir_watcher.hpp"
+#include "file_util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+namespace defgen
+{
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+/// An object with file events that has not been parsed yet.
+struct PendingObject
+{
+    std::filesystem::path path;
+    Clock::time_point last_event;
+    /// The last event was a close after writing (or a rename into place).
+    bool closed = false;
+};
+
+} // namespace
+
+struct ExportWatcher::Impl
+{
+    explicit Impl(WatchOptions o)
+        : options(std::move(o))
+        , builder(options.format, options.options)
+    {
+    }
+
+    WatchOptions options;
+    ExportSetBuilder builder;
+    detail::DirectoryWatcher watcher;
+    WatchStats stats;
+    /// Parsed objects by path key, sorted as the manifest stores them.
+    std::map<std::string, ManifestEntry> manifest;
+    std::unordered_map<std::string, PendingObject> pending;
+    /// Lines of the output as last written (or found on disk at start).
+    std::vector<std::string> written;
+    bool exports_dirty = false;
+    bool manifest_dirty = false;
+
+    [[nodiscard]] bool is_object(const std::filesystem::path& path) const
+    {
+        const std::filesystem::path ext = path.extension();
+        return (options.format != ObjectFormat::Elf && ext == ".obj") || (options.format != ObjectFormat::Coff && ext == ".o");
+    }
+
+    [[nodiscard]] std::chrono::milliseconds settle_time(const PendingObject& p) const
+    {
+        return std::chrono::milliseconds(options.debounce_ms * (p.closed ? 1u : 4u));
+    }
+
+    /// The output settings for the current object count.
+    [[nodiscard]] GenerateOptions current_settings() const
+    {
+        GenerateOptions settings = options.options;
+        settings.object_count_line.reset();
+        // Snapshots export by name; the manifest must not claim otherwise.
+        settings.ordinal_database.clear();
+        settings.named_exports.clear();
+        if (!options.object_count_prefix.empty())
+        {
+            settings.object_count_line = options.object_count_prefix + std::to_string(builder.object_count());
+        }
+        return settings;
+    }
+
+    void refresh_stats()
+    {
+        stats.objects = builder.object_count();
+        stats.exports = builder.export_count();
+    }
+
+    void apply(const std::filesystem::path& path);
+    void remove(const std::string& key, const std::filesystem::path& path);
+    void remove_tree(const std::filesystem::path& dir);
+    void note(const detail::DirectoryEvent& ev);
+    void rescan();
+    void publish();
+};
+
+void ExportWatcher::Impl::apply(const std::filesystem::path& path)
+{
+    std::string key = detail::path_key(path);
+    detail::FileIdentity identity;
+    if (!detail::stat_file_identity(path, identity))
+    {
+        remove(key, path);
+        return;
+    }
+    ManifestEntry entry;
+    entry.size = identity.size;
+    entry.mtime = identity.mtime;
+    std::string err;
+    if (!detail::hash_file_content(path, entry.content_hash, err))
+    {
+        ++stats.parse_failures;
+        stats.last_error = std::move(err);
+        return;
+    }
+    const auto known = manifest.find(key);
+    if (known != manifest.end() && known->second.size == entry.size && known->second.content_hash == entry.content_hash)
+    {
+        // Rewritten with the same bytes (e.g. a no-op recompile): only the timestamp in the manifest moves.
+        known->second.mtime = entry.mtime;
+        ++stats.unchanged;
+        manifest_dirty = true;
+        return;
+    }
+    if (builder.update_object(path, err) != Errc::Ok)
+    {
+        ++stats.parse_failures;
+        stats.last_error = std::move(err);
+        return;
+    }
+    ++stats.parses;
+    entry.path = key;
+    manifest[std::move(key)] = std::move(entry);
+    exports_dirty = true;
+    manifest_dirty = true;
+}
+
+void ExportWatcher::Impl::remove(const std::string& key, const std::filesystem::path& path)
+{
+    pending.erase(key);
+    if (builder.remove_object(path))
+    {
+        manifest.erase(key);
+        exports_dirty = true;
+        manifest_dirty = true;
+    }
+}
+
+void ExportWatcher::Impl::remove_tree(const std::filesystem::path& dir)
+{
+    const std::string prefix = detail::path_key(dir) + '/';
+    std::vector<std::string> gone;
+    for (auto it = manifest.lower_bound(prefix); it != manifest.end() && it->first.starts_with(prefix); ++it)
+    {
+        gone.push_back(it->first);
+    }
+    for (auto it = pending.begin(); it != pending.end();)
+    {
+        it = it->first.starts_with(prefix) ? pending.erase(it) : std::next(it);
+    }
+    for (const std::string& key : gone)
+    {
+        remove(key, detail::path_from_key(key));
+    }
+}
+
+void ExportWatcher::Impl::note(const detail::DirectoryEvent& ev)
+{
+    switch (ev.kind)
+    {
+    case detail::DirectoryEvent::Rescan:
+        rescan();
+        break;
+    case detail::DirectoryEvent::Removed:
+        if (ev.directory)
+        {
+            remove_tree(ev.path);
+        }
+        else if (is_object(ev.path))
+        {
+            remove(detail::path_key(ev.path), ev.path);
+        }
+        break;
+    case detail::DirectoryEvent::Written:
+    case detail::DirectoryEvent::Modified:
+        if (is_object(ev.path))
+        {
+            PendingObject& p = pending[detail::path_key(ev.path)];
+            p.path = ev.path;
+            p.last_event = Clock::now();
+            p.closed = ev.kind == detail::DirectoryEvent::Written;
+        }
+        break;
+    }
+}
+
+/// After lost events: every object on disk is re-checked (unchanged content is not re-parsed) and vanished ones dropped.
+void ExportWatcher::Impl::rescan()
+{
+    std::vector<std::filesystem::path> files;
+    for (const auto& dir : options.directories)
+    {
+        std::string err;
+        (void)watcher.add_tree(dir, files, err);
+    }
+    std::map<std::string, std::filesystem::path> present;
+    for (auto& f : files)
+    {
+        if (is_object(f))
+        {
+            present.emplace(detail::path_key(f), std::move(f));
+        }
+    }
+    std::vector<std::string> gone;
+    for (const auto& [key, entry] : manifest)
+    {
+        if (present.count(key) == 0)
+        {
+            gone.push_back(key);
+        }
+    }
+    for (const std::string& key : gone)
+    {
+        remove(key, detail::path_from_key(key));
+    }
+    for (auto& [key, path] : present)
+    {
+        PendingObject& p = pending[key];
+        p.path = std::move(path);
+        p.last_event = Clock::now();
+    }
+}
+
+void ExportWatcher::Impl::publish()
+{
+    if (!exports_dirty && !manifest_dirty)
+    {
+        return;
+    }
+    const GenerateOptions settings = current_settings();
+    if (exports_dirty)
+    {
+        builder.set_object_count_line(settings.object_count_line);
+        GenerateOutput out = builder.snapshot();
+        if (out.lines != written)
+        {
+            std::string text;
+            for (const std::string& line : out.lines)
+            {
+                text += line;
+                text += '\n';
+            }
+            std::string err;
+            if (!detail::write_file_atomic(options.output, text.data(), text.size(), err))
+            {
+                stats.last_error = std::move(err);
+                return;
+            }
+            written = std::move(out.lines);
+            ++stats.outputs_written;
+        }
+    }
+    // Written after the export file, so a manifest never vouches for output that is not on disk yet.
+    InputManifest m;
+    m.settings_hash = manifest_settings_hash(options.format, settings);
+    m.entries.reserve(manifest.size());
+    for (const auto& [key, entry] : manifest)
+    {
+        m.entries.push_back(entry);
+    }
+    std::filesystem::path manifest_path = options.output;
+    manifest_path += ".manifest";
+    std::string err;
+    if (!write_input_manifest(manifest_path, m, err))
+    {
+        stats.last_error = std::move(err);
+        return;
+    }
+    exports_dirty = false;
+    manifest_dirty = false;
+}
+
+ExportWatcher::ExportWatcher(WatchOptions options)
+    : impl_(std::make_unique<Impl>(std::move(options)))
+{
+}
+
+ExportWatcher::~ExportWatcher() = default;
+
+bool ExportWatcher::start(std::string& err)
+{
+    std::vector<std::filesystem::path> files;
+    for (const auto& dir : impl_->options.directories)
+    {
+        if (!impl_->watcher.add_tree(dir, files, err))
+        {
+            return false;
+        }
+    }
+    std::sort(files.begin(), files.end());
+    for (const auto& f : files)
+    {
+        if (impl_->is_object(f))
+        {
+            impl_->apply(f);
+        }
+    }
+    // An existing output that already matches is kept as is (and not rewritten on the first publish).
+    impl_->builder.set_object_count_line(impl_->current_settings().object_count_line);
+    GenerateOutput out = impl_->builder.snapshot();
+    if (def_file_matches(impl_->options.output, out.lines))
+    {
+        impl_->written = std::move(out.lines);
+    }
+    impl_->exports_dirty = true;
+    impl_->manifest_dirty = true;
+    impl_->publish();
+    impl_->refresh_stats();
+    return true;
+}
+
+bool ExportWatcher::poll(int timeout_ms, std::string& err)
+{
+    Impl& im = *impl_;
+    // Wake up in time for the first pending object to settle.
+    int wait_ms = timeout_ms;
+    const Clock::time_point now = Clock::now();
+    for (const auto& [key, p] : im.pending)
+    {
+        const auto due = std::chrono::duration_cast<std::chrono::milliseconds>(p.last_event + im.settle_time(p) - now).count();
+        const int due_ms = static_cast<int>(std::max<long long>(due, 0));
+        if (wait_ms < 0 || due_ms < wait_ms)
+        {
+            wait_ms = due_ms;
+        }
+    }
+
+    std::vector<detail::DirectoryEvent> events;
+    if (!im.watcher.wait(wait_ms, events, err))
+    {
+        return false;
+    }
+    for (const detail::DirectoryEvent& ev : events)
+    {
+        im.note(ev);
+    }
+
+    // Objects are parsed once their writer has been quiet for the debounce time; a partial file just waits longer.
+    const Clock::time_point settled = Clock::now();
+    std::vector<std::filesystem::path> ready;
+    for (auto it = im.pending.begin(); it != im.pending.end();)
+    {
+        if (settled - it->second.last_event >= im.settle_time(it->second))
+        {
+            ready.push_back(std::move(it->second.path));
+            it = im.pending.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    std::sort(ready.begin(), ready.end());
+    for (const auto& path : ready)
+    {
+        im.apply(path);
+    }
+    im.publish();
+    im.refresh_stats();
+    return true;
+}
+
+const WatchStats& ExportWatcher::stats() const { return impl_->stats; }
+
+} // namespace defgen
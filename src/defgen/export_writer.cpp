@@ -0,0 +1,194 @@
+#include "defgen/defgen.hpp"
+#include "export_lines.hpp"
+#include "file_util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+namespace defgen
+{
+
+struct ExportFileWriter::Impl
+{
+    Impl(std::filesystem::path p, ExportCompare compare, std::size_t capacity)
+        : path(std::move(p))
+        , compare(compare)
+        , capacity(std::max<std::size_t>(capacity, 4096))
+        , existing(path, std::ios::binary)
+        , same(existing.is_open())
+    {
+        buffer.reserve(this->capacity + 4096);
+    }
+
+    std::filesystem::path path;
+    /// Empty until the text first differs from the existing file.
+    std::filesystem::path temp;
+    ExportCompare compare;
+    std::size_t capacity;
+    std::string buffer;
+    /// The current file, compared against while the new text still equals it.
+    std::ifstream existing;
+    bool same;
+    /// Bytes known to equal the start of `existing` (not written to `out`).
+    std::uint64_t matched = 0;
+    bool first_line = true;
+    /// The hashed first line equals the existing file's: the rest is taken as equal and ignored.
+    bool header_matched = false;
+    std::ofstream out;
+    bool failed = false;
+    bool committed = false;
+
+    /// Decide from the first line alone (`ExportCompare::Header`): equal headers end the compare, different ones start
+    /// the temporary file without reading the old text any further.
+    void compare_header(std::string_view text)
+    {
+        std::string current;
+        if (std::getline(existing, current) && !existing.eof() && current == text)
+        {
+            header_matched = true;
+            return;
+        }
+        start_temp();
+    }
+
+    /// Create the temporary file and copy the `matched` prefix over from the existing file.
+    void start_temp()
+    {
+        same = false;
+        temp = detail::temp_path_for(path);
+        out.open(temp, std::ios::binary | std::ios::trunc);
+        existing.clear();
+        existing.seekg(0);
+        std::string chunk(std::min<std::uint64_t>(matched, capacity), '\0');
+        for (std::uint64_t left = matched; left != 0 && out;)
+        {
+            const auto n = static_cast<std::streamsize>(std::min<std::uint64_t>(left, chunk.size()));
+            if (!existing.read(chunk.data(), n))
+            {
+                failed = true;
+                return;
+            }
+            out.write(chunk.data(), n);
+            left -= static_cast<std::uint64_t>(n);
+        }
+        existing.close();
+        failed = failed || !out;
+    }
+
+    void flush()
+    {
+        if (buffer.empty() || failed)
+        {
+            return;
+        }
+        if (same)
+        {
+            std::string current(buffer.size(), '\0');
+            existing.read(current.data(), static_cast<std::streamsize>(current.size()));
+            if (static_cast<std::size_t>(existing.gcount()) == buffer.size() && current == buffer)
+            {
+                matched += buffer.size();
+                buffer.clear();
+                return;
+            }
+            start_temp();
+        }
+        else if (!out.is_open())
+        {
+            start_temp();
+        }
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        failed = failed || !out;
+        buffer.clear();
+    }
+};
+
+ExportFileWriter::ExportFileWriter(std::filesystem::path path, ExportCompare compare, std::size_t buffer_size)
+    : impl_(std::make_unique<Impl>(std::move(path), compare, buffer_size))
+{
+}
+
+ExportFileWriter::~ExportFileWriter()
+{
+    if (!impl_->committed && !impl_->temp.empty())
+    {
+        impl_->out.close();
+        std::error_code ec;
+        std::filesystem::remove(impl_->temp, ec);
+    }
+}
+
+void ExportFileWriter::line(std::string_view text)
+{
+    Impl& im = *impl_;
+    if (im.header_matched)
+    {
+        return;
+    }
+    if (im.first_line)
+    {
+        im.first_line = false;
+        if (im.same && im.compare == ExportCompare::Header && detail::line_has_export_hash(text))
+        {
+            im.compare_header(text);
+            if (im.header_matched)
+            {
+                return;
+            }
+        }
+    }
+    im.buffer.append(text);
+    im.buffer.push_back('\n');
+    if (im.buffer.size() >= im.capacity)
+    {
+        im.flush();
+    }
+}
+
+bool ExportFileWriter::commit(bool& unchanged, std::string& err)
+{
+    Impl& im = *impl_;
+    if (im.header_matched)
+    {
+        im.committed = true;
+        unchanged = true;
+        return true;
+    }
+    im.flush();
+    unchanged = false;
+    if (im.same)
+    {
+        // Equal so far: unchanged only if the existing file ends here too.
+        if (im.existing.peek() == std::ifstream::traits_type::eof())
+        {
+            im.committed = true;
+            unchanged = true;
+            return true;
+        }
+        im.start_temp();
+    }
+    else if (!im.out.is_open() && !im.failed)
+    {
+        // No existing file and no text at all.
+        im.start_temp();
+    }
+    im.out.close();
+    if (im.failed || !im.out)
+    {
+        err = "cannot write " + detail::path_key(im.temp);
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(im.temp, im.path, ec);
+    if (ec)
+    {
+        err = "cannot replace " + detail::path_key(im.path);
+        return false;
+    }
+    im.committed = true;
+    return true;
+}
+
+} // namespace defgen
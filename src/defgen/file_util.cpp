@@ -0,0 +1,141 @@
+#include "file_util.hpp"
+#include "hash.hpp"
+#include "mapped_file.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+[[nodiscard]] unsigned long current_process_id()
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<unsigned long>(::getpid());
+#endif
+}
+
+/// `.<pid>-<tag>.tmp`, unique per call: the tag is a per-process random value (PIDs repeat across the machines sharing a
+/// cache directory) plus a counter (threads of one process may write the same entry).
+[[nodiscard]] std::string temp_suffix()
+{
+    static const std::uint64_t process_tag = (std::uint64_t{std::random_device{}()} << 32) ^ std::random_device{}();
+    static std::atomic<std::uint64_t> counter{0};
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), ".%lu-%016llx.tmp", current_process_id(), static_cast<unsigned long long>(process_tag + counter++));
+    return buf;
+}
+
+} // namespace
+
+#ifdef _WIN32
+
+bool stat_file_identity(const std::filesystem::path& path, FileIdentity& out)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data{};
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+    {
+        return false;
+    }
+    out.size = (static_cast<std::uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    out.mtime = static_cast<std::int64_t>((static_cast<std::uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) |
+                                          data.ftLastWriteTime.dwLowDateTime);
+    return true;
+}
+
+#else
+
+bool stat_file_identity(const std::filesystem::path& path, FileIdentity& out)
+{
+    struct stat st
+    {
+    };
+    if (::stat(path.c_str(), &st) != 0 || st.st_size < 0)
+    {
+        return false;
+    }
+    out.size = static_cast<std::uint64_t>(st.st_size);
+#ifdef __APPLE__
+    out.mtime = static_cast<std::int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    out.mtime = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+#endif
+
+std::string path_key(const std::filesystem::path& path)
+{
+    const std::u8string s = path.generic_u8string();
+    return {s.begin(), s.end()};
+}
+
+std::filesystem::path path_from_key(std::string_view key) { return std::filesystem::path(std::u8string(key.begin(), key.end())); }
+
+bool hash_file_content(const std::filesystem::path& path, std::uint64_t& out, std::string& err)
+{
+    MappedFile file;
+    if (!file.open(path, err))
+    {
+        return false;
+    }
+    out = Xxh64::hash(file.bytes().data(), file.bytes().size());
+    return true;
+}
+
+std::filesystem::path temp_path_for(const std::filesystem::path& path)
+{
+    // Unique temporary name: a watcher and the proxy, or several machines on a shared cache, may replace the same file
+    // at the same time.
+    std::filesystem::path temp = path;
+    temp += temp_suffix();
+    return temp;
+}
+
+bool write_file_atomic(const std::filesystem::path& path, const void* data, std::size_t size, std::string& err)
+{
+    const std::filesystem::path temp = temp_path_for(path);
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        out.close();
+        if (!out)
+        {
+            err = "cannot write " + path_key(temp);
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp, ec);
+        err = "cannot replace " + path_key(path);
+        return false;
+    }
+    return true;
+}
+
+} // namespace defgen::detail
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace defgen::detail
+{
+
+/// Size and modification time from a single `stat` / `GetFileAttributesEx`; the cheap half of a cache key.
+struct FileIdentity
+{
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+
+    friend bool operator==(const FileIdentity&, const FileIdentity&) = default;
+};
+
+[[nodiscard]] bool stat_file_identity(const std::filesystem::path& path, FileIdentity& out);
+
+/// Key for a path in the caches and manifests: its generic UTF-8 spelling, as given (relative paths stay relative).
+[[nodiscard]] std::string path_key(const std::filesystem::path& path);
+
+/// The path a `path_key` was made from (or any other generic UTF-8 spelling).
+[[nodiscard]] std::filesystem::path path_from_key(std::string_view key);
+
+/// XXH64 of the whole file, read through a read-only mapping.
+[[nodiscard]] bool hash_file_content(const std::filesystem::path& path, std::uint64_t& out, std::string& err);
+
+/// `<path>.<pid>-<tag>.tmp`, a name no other writer (thread, process or machine) uses, to be renamed over `path`.
+[[nodiscard]] std::filesystem::path temp_path_for(const std::filesystem::path& path);
+
+/// Write `size` bytes to a uniquely named `<path>.<pid>-<tag>.tmp` and rename it over `path`, so readers see either the
+/// old or the new file.
+[[nodiscard]] bool write_file_atomic(const std::filesystem::path& path, const void* data, std::size_t size, std::string& err);
+
+} // namespace defgen::detail
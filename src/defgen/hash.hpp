@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace defgen::detail
+{
+
+/// XXH64 (xxHash, 64-bit). Used for symbol interning and content fingerprints; not cryptographic.
+class Xxh64
+{
+  public:
+    [[nodiscard]] static std::uint64_t hash(const void* data, std::size_t len, std::uint64_t seed = 0)
+    {
+        const auto* p = static_cast<const std::uint8_t*>(data);
+        const std::uint8_t* const end = p + len;
+        std::uint64_t h = 0;
+        if (len >= 32)
+        {
+            std::uint64_t v1 = seed + kPrime1 + kPrime2;
+            std::uint64_t v2 = seed + kPrime2;
+            std::uint64_t v3 = seed;
+            std::uint64_t v4 = seed - kPrime1;
+            const std::uint8_t* const limit = end - 32;
+            do
+            {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge_round(h, v1);
+            h = merge_round(h, v2);
+            h = merge_round(h, v3);
+            h = merge_round(h, v4);
+        }
+        else
+        {
+            h = seed + kPrime5;
+        }
+        return finalize(h + static_cast<std::uint64_t>(len), p, end);
+    }
+
+    [[nodiscard]] static std::uint64_t hash(std::string_view s, std::uint64_t seed = 0) { return hash(s.data(), s.size(), seed); }
+
+    /// Incremental form: `update` any number of pieces, then `digest` equals `hash` of their concatenation.
+    class State
+    {
+      public:
+        explicit State(std::uint64_t seed = 0)
+            : seed_(seed)
+            , v_{seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1}
+        {
+        }
+
+        void update(const void* data, std::size_t len)
+        {
+            const auto* p = static_cast<const std::uint8_t*>(data);
+            const std::uint8_t* const end = p + len;
+            total_ += len;
+            if (buffered_ + len < sizeof(buffer_))
+            {
+                std::memcpy(buffer_ + buffered_, p, len);
+                buffered_ += len;
+                return;
+            }
+            if (buffered_ != 0)
+            {
+                const std::size_t fill = sizeof(buffer_) - buffered_;
+                std::memcpy(buffer_ + buffered_, p, fill);
+                p += fill;
+                stripe(buffer_);
+                buffered_ = 0;
+            }
+            if (end - p >= 32)
+            {
+                // Locals, not members: the compiler keeps the four lanes in registers across the loop.
+                std::uint64_t v1 = v_[0];
+                std::uint64_t v2 = v_[1];
+                std::uint64_t v3 = v_[2];
+                std::uint64_t v4 = v_[3];
+                do
+                {
+                    v1 = round(v1, read64(p));
+                    v2 = round(v2, read64(p + 8));
+                    v3 = round(v3, read64(p + 16));
+                    v4 = round(v4, read64(p + 24));
+                    p += 32;
+                } while (end - p >= 32);
+                v_[0] = v1;
+                v_[1] = v2;
+                v_[2] = v3;
+                v_[3] = v4;
+            }
+            buffered_ = static_cast<std::size_t>(end - p);
+            std::memcpy(buffer_, p, buffered_);
+        }
+
+        void update(std::string_view s) { update(s.data(), s.size()); }
+
+        [[nodiscard]] std::uint64_t digest() const
+        {
+            std::uint64_t h = seed_ + kPrime5;
+            if (total_ >= 32)
+            {
+                h = rotl(v_[0], 1) + rotl(v_[1], 7) + rotl(v_[2], 12) + rotl(v_[3], 18);
+                for (const std::uint64_t v : v_)
+                {
+                    h = merge_round(h, v);
+                }
+            }
+            return finalize(h + total_, buffer_, buffer_ + buffered_);
+        }
+
+      private:
+        void stripe(const std::uint8_t* p)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                v_[i] = round(v_[i], read64(p + 8 * i));
+            }
+        }
+
+        std::uint64_t seed_;
+        std::uint64_t v_[4];
+        std::uint64_t total_ = 0;
+        std::uint8_t buffer_[32] = {};
+        std::size_t buffered_ = 0;
+    };
+
+  private:
+    static constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+    static constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+    static constexpr std::uint64_t kPrime3 = 0x165667B19E3779F9ull;
+    static constexpr std::uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+    static constexpr std::uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+    [[nodiscard]] static std::uint64_t rotl(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    [[nodiscard]] static std::uint64_t read64(const std::uint8_t* p)
+    {
+        std::uint64_t v = 0;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    [[nodiscard]] static std::uint32_t read32(const std::uint8_t* p)
+    {
+        std::uint32_t v = 0;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    [[nodiscard]] static std::uint64_t round(std::uint64_t acc, std::uint64_t input)
+    {
+        acc += input * kPrime2;
+        acc = rotl(acc, 31);
+        return acc * kPrime1;
+    }
+
+    [[nodiscard]] static std::uint64_t merge_round(std::uint64_t acc, std::uint64_t val)
+    {
+        acc ^= round(0, val);
+        return acc * kPrime1 + kPrime4;
+    }
+
+    /// Fold the trailing `p..end` (fewer than 32 bytes) into `h` and avalanche.
+    [[nodiscard]] static std::uint64_t finalize(std::uint64_t h, const std::uint8_t* p, const std::uint8_t* end)
+    {
+        while (end - p >= 8)
+        {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * kPrime1 + kPrime4;
+            p += 8;
+        }
+        if (end - p >= 4)
+        {
+            h ^= static_cast<std::uint64_t>(read32(p)) * kPrime1;
+            h = rotl(h, 23) * kPrime2 + kPrime3;
+            p += 4;
+        }
+        while (p < end)
+        {
+            h ^= static_cast<std::uint64_t>(*p) * kPrime5;
+            h = rotl(h, 11) * kPrime1;
+            ++p;
+        }
+        h ^= h >> 33;
+        h *= kPrime2;
+        h ^= h >> 29;
+        h *= kPrime3;
+        h ^= h >> 32;
+        return h;
+    }
+};
+
+} // namespace defgen::detail
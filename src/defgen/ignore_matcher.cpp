@@ -0,0 +1,121 @@
+#include "ignore_matcher.hpp"
+
+#include <cstddef>
+#include <deque>
+
+namespace defgen::detail
+{
+
+IgnoreMatcher::IgnoreMatcher(const std::vector<std::string>& patterns)
+{
+    // Class 0 stands for every byte that appears in no pattern.
+    classes_ = 1;
+    for (const auto& p : patterns)
+    {
+        for (const char c : p)
+        {
+            auto& cls = byte_class_[static_cast<unsigned char>(c)];
+            if (cls == 0)
+            {
+                cls = static_cast<std::uint16_t>(classes_++);
+            }
+        }
+    }
+
+    // Trie over byte classes; -1 marks a missing edge.
+    std::vector<std::int32_t> trie(classes_, -1);
+    std::vector<char> terminal(1, 0);
+    bool any = false;
+    for (const auto& p : patterns)
+    {
+        if (p.empty())
+        {
+            continue;
+        }
+        any = true;
+        std::size_t node = 0;
+        for (const char c : p)
+        {
+            const std::size_t edge = node * classes_ + byte_class_[static_cast<unsigned char>(c)];
+            if (trie[edge] < 0)
+            {
+                trie[edge] = static_cast<std::int32_t>(terminal.size());
+                terminal.push_back(0);
+                trie.resize(terminal.size() * classes_, -1);
+            }
+            node = static_cast<std::size_t>(trie[node * classes_ + byte_class_[static_cast<unsigned char>(c)]]);
+        }
+        terminal[node] = 1;
+    }
+    if (!any)
+    {
+        return;
+    }
+
+    // Breadth-first: resolve failure links into full goto transitions and inherit terminal flags.
+    const std::size_t nodes = terminal.size();
+    std::vector<std::size_t> fail(nodes, 0);
+    std::vector<std::size_t> order;
+    order.reserve(nodes);
+    std::deque<std::size_t> queue;
+    for (std::uint32_t c = 0; c < classes_; c++)
+    {
+        std::int32_t& child = trie[c];
+        if (child < 0)
+        {
+            child = 0;
+        }
+        else
+        {
+            fail[static_cast<std::size_t>(child)] = 0;
+            queue.push_back(static_cast<std::size_t>(child));
+        }
+    }
+    while (!queue.empty())
+    {
+        const std::size_t node = queue.front();
+        queue.pop_front();
+        order.push_back(node);
+        terminal[node] = static_cast<char>(terminal[node] | terminal[fail[node]]);
+        for (std::uint32_t c = 0; c < classes_; c++)
+        {
+            std::int32_t& child = trie[node * classes_ + c];
+            const std::int32_t via_fail = trie[fail[node] * classes_ + c];
+            if (child < 0)
+            {
+                child = via_fail;
+            }
+            else
+            {
+                fail[static_cast<std::size_t>(child)] = static_cast<std::size_t>(via_fail);
+                queue.push_back(static_cast<std::size_t>(child));
+            }
+        }
+    }
+
+    // Compact numbering: root = 0, every accepting node collapses into kMatched, the rest follow.
+    std::vector<std::uint32_t> id(nodes, 0);
+    std::uint32_t states = kMatched + 1;
+    for (const std::size_t node : order)
+    {
+        id[node] = terminal[node] != 0 ? kMatched : states++;
+    }
+    next_.assign(static_cast<std::size_t>(states) * classes_, 0);
+    for (std::uint32_t c = 0; c < classes_; c++)
+    {
+        next_[kMatched * classes_ + c] = kMatched;
+    }
+    for (std::size_t node = 0; node < nodes; node++)
+    {
+        if (terminal[node] != 0)
+        {
+            continue;
+        }
+        for (std::uint32_t c = 0; c < classes_; c++)
+        {
+            next_[id[node] * classes_ + c] = id[static_cast<std::size_t>(trie[node * classes_ + c])];
+        }
+    }
+}
+
+} // namespace defgen::detail
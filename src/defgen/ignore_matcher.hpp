@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// `DefBuildIgnores` substrings compiled once into an Aho-Corasick automaton. `matches(name)` scans the name in a single
+/// pass and is true exactly when `name.find(pattern) != npos` for some non-empty pattern.
+/// Transitions are a dense `states x byte classes` table; bytes that occur in no pattern share one class.
+class IgnoreMatcher
+{
+  public:
+    IgnoreMatcher() = default;
+    explicit IgnoreMatcher(const std::vector<std::string>& patterns);
+
+    [[nodiscard]] bool empty() const { return next_.empty(); }
+
+    [[nodiscard]] bool matches(std::string_view name) const
+    {
+        if (empty())
+        {
+            return false;
+        }
+        std::uint32_t state = 0;
+        for (const char c : name)
+        {
+            state = next_[state * classes_ + byte_class_[static_cast<unsigned char>(c)]];
+            if (state == kMatched)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    /// Every accepting state is folded into this one absorbing state, so a hit ends the scan immediately.
+    static constexpr std::uint32_t kMatched = 1;
+
+    std::array<std::uint16_t, 256> byte_class_{};
+    std::uint32_t classes_ = 0;
+    std::vector<std::uint32_t> next_;
+};
+
+} // namespace defgen::detail
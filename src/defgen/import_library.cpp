@@ -0,0 +1,426 @@
+#include "defgen/defgen.hpp"
+#include "ar_archive.hpp"
+#include "coff_writer.hpp"
+#include "object_source.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <span>
+
+namespace defgen
+{
+
+namespace
+{
+
+using namespace detail;
+using namespace coff;
+
+using Header = SCoffImage::SCoffHeader;
+using Section = SCoffImage::SCoffSection;
+using Symbol = SCoffImage::SCoffSymbol;
+using Relocation = SCoffImage::SCoffRelocation;
+using ImportHeader = SCoffImage::SCoffImportHeader;
+
+constexpr std::string_view kStampTag = "defgen-lib 1";
+
+constexpr std::uint32_t kIdataFlags = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+/// IMAGE_IMPORT_DESCRIPTOR size and the fields relocated in it.
+constexpr std::uint32_t kImportDescriptorSize = 20;
+constexpr std::uint32_t kDescOriginalFirstThunk = 0;
+constexpr std::uint32_t kDescName = 12;
+constexpr std::uint32_t kDescFirstThunk = 16;
+
+/// Section of a small object: `header` carries name and flags, the rest is filled in by `append_object`.
+struct ObjectSection
+{
+    Section header;
+    std::vector<std::uint8_t> data;
+    std::vector<Relocation> relocs;
+};
+
+struct ObjectSymbol
+{
+    std::string name;
+    word section;
+    byte storage_class;
+};
+
+[[nodiscard]] Section section_header(std::string_view name, std::uint32_t flags)
+{
+    Section header{};
+    std::memcpy(header.szName, name.data(), std::min(name.size(), sizeof(SCoffName)));
+    header.flags = flags;
+    return header;
+}
+
+/// Header, section table, each section's data followed by its relocations, symbol table, string table; no timestamp.
+void append_object(std::vector<std::uint8_t>& out, word machine, std::span<ObjectSection> sections, std::span<const ObjectSymbol> symbols)
+{
+    std::uint32_t offset = static_cast<std::uint32_t>(sizeof(Header) + sections.size() * sizeof(Section));
+    for (ObjectSection& section : sections)
+    {
+        section.header.dwSize = static_cast<dword>(section.data.size());
+        section.header.pData = section.data.empty() ? 0 : offset;
+        offset += section.header.dwSize;
+        section.header.pRelocs = section.relocs.empty() ? 0 : offset;
+        section.header.nRelocs = static_cast<word>(section.relocs.size());
+        offset += static_cast<std::uint32_t>(section.relocs.size() * sizeof(Relocation));
+    }
+    Header header{};
+    header.machine = machine;
+    header.nSections = static_cast<word>(sections.size());
+    header.pSymbols = offset;
+    header.nSymbols = static_cast<dword>(symbols.size());
+    header.flags = machine == IMAGE_FILE_MACHINE_I386 ? IMAGE_FILE_32BIT_MACHINE : word{0};
+    append_record(out, header);
+    for (const ObjectSection& section : sections)
+    {
+        append_record(out, section.header);
+    }
+    for (const ObjectSection& section : sections)
+    {
+        out.insert(out.end(), section.data.begin(), section.data.end());
+        for (const Relocation& reloc : section.relocs)
+        {
+            append_record(out, reloc);
+        }
+    }
+    std::string strings(sizeof(dword), '\0');
+    for (const ObjectSymbol& s : symbols)
+    {
+        Symbol symbol{};
+        set_coff_name(symbol.szName, s.name, strings);
+        symbol.nSection = s.section;
+        symbol.nStorageClass = s.storage_class;
+        append_record(out, symbol);
+    }
+    append_string_table(out, strings);
+}
+
+/// One archive member: its bytes in `ImportLibrary::bodies` and the public symbols it defines.
+struct LibraryMember
+{
+    std::size_t begin = 0;
+    std::size_t size = 0;
+};
+
+struct LibrarySymbol
+{
+    std::string name;
+    std::uint32_t member;
+};
+
+struct ImportLibrary
+{
+    std::vector<std::uint8_t> bodies;
+    std::vector<LibraryMember> members;
+    std::vector<LibrarySymbol> symbols;
+
+    /// Start a member; what is appended to `bodies` until the next call belongs to it.
+    void begin_member()
+    {
+        if (!members.empty())
+        {
+            members.back().size = bodies.size() - members.back().begin;
+        }
+        members.push_back({bodies.size(), 0});
+    }
+
+    void add_symbol(std::string name) { symbols.push_back({std::move(name), static_cast<std::uint32_t>(members.size() - 1)}); }
+
+    void end() { members.back().size = bodies.size() - members.back().begin; }
+};
+
+/// `\x7f<stem>_NULL_THUNK_DATA`, defined by the null thunk object and referenced by the import descriptor.
+[[nodiscard]] std::string null_thunk_symbol(std::string_view stem)
+{
+    std::string name(1, '\x7f');
+    name += stem;
+    name += "_NULL_THUNK_DATA";
+    return name;
+}
+
+/// `IMPORT_DESCRIPTOR` object: the DLL's import directory entry, pointing at its name and (through the section
+/// symbols) at the lookup and address tables the linker gathers from `.idata$4` / `.idata$5`. Also carries the stamp.
+void add_import_descriptor(ImportLibrary& lib, const ExportObjectOptions& options, std::string_view stem, std::string_view stamp,
+                           word reloc_type)
+{
+    std::vector<std::uint8_t> dll_name(options.dll_name.begin(), options.dll_name.end());
+    dll_name.resize((dll_name.size() + 2) & ~std::size_t{1}, 0);
+    ObjectSection sections[] = {
+        {section_header(".idata$2", kIdataFlags | IMAGE_SCN_ALIGN_4BYTES), std::vector<std::uint8_t>(kImportDescriptorSize, 0),
+         {{kDescName, 2, reloc_type}, {kDescOriginalFirstThunk, 3, reloc_type}, {kDescFirstThunk, 4, reloc_type}}},
+        {section_header(".idata$6", kIdataFlags | IMAGE_SCN_ALIGN_2BYTES), std::move(dll_name), {}},
+        {stamp_section(0, 0), std::vector<std::uint8_t>(stamp.begin(), stamp.end()), {}},
+    };
+    const std::string descriptor = "__IMPORT_DESCRIPTOR_" + std::string(stem);
+    const ObjectSymbol symbols[] = {
+        {descriptor, 1, IMAGE_SYM_CLASS_EXTERNAL},
+        {".idata$2", 1, IMAGE_SYM_CLASS_SECTION},
+        {".idata$6", 2, IMAGE_SYM_CLASS_STATIC},
+        {".idata$4", 0, IMAGE_SYM_CLASS_SECTION},
+        {".idata$5", 0, IMAGE_SYM_CLASS_SECTION},
+        {"__NULL_IMPORT_DESCRIPTOR", 0, IMAGE_SYM_CLASS_EXTERNAL},
+        {null_thunk_symbol(stem), 0, IMAGE_SYM_CLASS_EXTERNAL},
+    };
+    lib.begin_member();
+    append_object(lib.bodies, options.machine, sections, symbols);
+    lib.add_symbol(descriptor);
+}
+
+/// All-zero import descriptor that ends the import directory.
+void add_null_import_descriptor(ImportLibrary& lib, word machine)
+{
+    ObjectSection sections[] = {
+        {section_header(".idata$3", kIdataFlags | IMAGE_SCN_ALIGN_4BYTES), std::vector<std::uint8_t>(kImportDescriptorSize, 0), {}},
+    };
+    const ObjectSymbol symbols[] = {{"__NULL_IMPORT_DESCRIPTOR", 1, IMAGE_SYM_CLASS_EXTERNAL}};
+    lib.begin_member();
+    append_object(lib.bodies, machine, sections, symbols);
+    lib.add_symbol(symbols[0].name);
+}
+
+/// Null entries that end this DLL's lookup and address tables.
+void add_null_thunk(ImportLibrary& lib, word machine, std::string_view stem)
+{
+    const bool x86 = machine == IMAGE_FILE_MACHINE_I386;
+    const std::size_t pointer = x86 ? 4 : 8;
+    const std::uint32_t flags = kIdataFlags | (x86 ? IMAGE_SCN_ALIGN_4BYTES : IMAGE_SCN_ALIGN_8BYTES);
+    ObjectSection sections[] = {
+        {section_header(".idata$5", flags), std::vector<std::uint8_t>(pointer, 0), {}},
+        {section_header(".idata$4", flags), std::vector<std::uint8_t>(pointer, 0), {}},
+    };
+    const ObjectSymbol symbols[] = {{null_thunk_symbol(stem), 1, IMAGE_SYM_CLASS_EXTERNAL}};
+    lib.begin_member();
+    append_object(lib.bodies, machine, sections, symbols);
+    lib.add_symbol(symbols[0].name);
+}
+
+/// Short import member for one export: the linker synthesizes the thunk and the `.idata` entries from it.
+void add_short_import(ImportLibrary& lib, const ExportObjectOptions& options, std::string_view symbol, word ordinal_or_hint,
+                      word name_type)
+{
+    ImportHeader header{};
+    header.Sig2 = 0xFFFF;
+    header.machine = options.machine;
+    header.sizeOfData = static_cast<dword>(symbol.size() + 1 + options.dll_name.size() + 1);
+    header.ordinalOrHint = ordinal_or_hint;
+    header.type = static_cast<word>(IMPORT_OBJECT_CODE | (name_type << 2));
+    lib.begin_member();
+    append_record(lib.bodies, header);
+    lib.bodies.insert(lib.bodies.end(), symbol.begin(), symbol.end());
+    lib.bodies.push_back(0);
+    lib.bodies.insert(lib.bodies.end(), options.dll_name.begin(), options.dll_name.end());
+    lib.bodies.push_back(0);
+    lib.add_symbol("__imp_" + std::string(symbol));
+    lib.add_symbol(std::string(symbol));
+}
+
+/// 60-byte member header; `mode` is empty for the linker members.
+void append_member_header(std::vector<std::uint8_t>& out, std::string_view name, std::size_t size, std::string_view mode)
+{
+    char header[ar::kHeaderSize + 1];
+    std::snprintf(header, sizeof(header), "%-16.*s%-12s%-6s%-6s%-8.*s%-10zu`\n", static_cast<int>(name.size()), name.data(), "0", "0",
+                  "0", static_cast<int>(mode.size()), mode.data(), size);
+    out.insert(out.end(), header, header + ar::kHeaderSize);
+}
+
+void pad_member(std::vector<std::uint8_t>& out)
+{
+    if (out.size() & 1)
+    {
+        out.push_back('\n');
+    }
+}
+
+void append_be32(std::vector<std::uint8_t>& out, std::uint32_t v)
+{
+    const std::uint8_t b[4] = {static_cast<std::uint8_t>(v >> 24), static_cast<std::uint8_t>(v >> 16), static_cast<std::uint8_t>(v >> 8),
+                               static_cast<std::uint8_t>(v)};
+    out.insert(out.end(), b, b + 4);
+}
+
+template <typename T> void append_le(std::vector<std::uint8_t>& out, T v)
+{
+    append_record(out, v);
+}
+
+/// `lib.exe` layout: signature, first linker member (SysV index, big-endian), second linker member (member offsets
+/// and a name-sorted symbol table), long name table when the DLL name needs it, then the members.
+[[nodiscard]] Errc write_archive(const ImportLibrary& lib, std::string_view dll_name, std::vector<std::uint8_t>& out, std::string& message)
+{
+    if (lib.members.size() > 0xFFFF)
+    {
+        message = std::to_string(lib.members.size()) + " archive members do not fit the linker member index";
+        return Errc::InvalidArgument;
+    }
+    std::size_t names_size = 0;
+    for (const LibrarySymbol& s : lib.symbols)
+    {
+        names_size += s.name.size() + 1;
+    }
+    const std::size_t symbols = lib.symbols.size();
+    const std::size_t first_size = 4 + 4 * symbols + names_size;
+    const std::size_t second_size = 4 + 4 * lib.members.size() + 4 + 2 * symbols + names_size;
+    // Every member is named after the DLL; names over 15 characters go to the long name table.
+    const bool long_name = dll_name.size() + 1 > 16;
+    const std::string member_name = long_name ? std::string("/0") : std::string(dll_name) + '/';
+    const std::size_t long_names_size = long_name ? dll_name.size() + 1 : 0;
+
+    auto padded = [](std::size_t size) { return ar::kHeaderSize + size + (size & 1); };
+    std::size_t at = ar::kSignatureSize + padded(first_size) + padded(second_size) + (long_name ? padded(long_names_size) : 0);
+    std::vector<std::uint32_t> offsets(lib.members.size());
+    for (std::size_t i = 0; i < lib.members.size(); i++)
+    {
+        offsets[i] = static_cast<std::uint32_t>(at);
+        at += padded(lib.members[i].size);
+    }
+
+    out.clear();
+    out.reserve(at);
+    const char signature[] = "!<arch>\n";
+    out.insert(out.end(), signature, signature + ar::kSignatureSize);
+
+    append_member_header(out, "/", first_size, "");
+    append_be32(out, static_cast<std::uint32_t>(symbols));
+    for (const LibrarySymbol& s : lib.symbols)
+    {
+        append_be32(out, offsets[s.member]);
+    }
+    for (const LibrarySymbol& s : lib.symbols)
+    {
+        out.insert(out.end(), s.name.begin(), s.name.end());
+        out.push_back(0);
+    }
+    pad_member(out);
+
+    std::vector<std::uint32_t> sorted(symbols);
+    std::iota(sorted.begin(), sorted.end(), 0u);
+    std::sort(sorted.begin(), sorted.end(), [&](std::uint32_t a, std::uint32_t b) { return lib.symbols[a].name < lib.symbols[b].name; });
+    append_member_header(out, "/", second_size, "");
+    append_le(out, static_cast<dword>(lib.members.size()));
+    for (const std::uint32_t offset : offsets)
+    {
+        append_le(out, offset);
+    }
+    append_le(out, static_cast<dword>(symbols));
+    for (const std::uint32_t i : sorted)
+    {
+        append_le(out, static_cast<word>(lib.symbols[i].member + 1));
+    }
+    for (const std::uint32_t i : sorted)
+    {
+        out.insert(out.end(), lib.symbols[i].name.begin(), lib.symbols[i].name.end());
+        out.push_back(0);
+    }
+    pad_member(out);
+
+    if (long_name)
+    {
+        append_member_header(out, "//", long_names_size, "");
+        out.insert(out.end(), dll_name.begin(), dll_name.end());
+        out.push_back(0);
+        pad_member(out);
+    }
+
+    for (const LibraryMember& member : lib.members)
+    {
+        append_member_header(out, member_name, member.size, "644");
+        out.insert(out.end(), lib.bodies.begin() + static_cast<std::ptrdiff_t>(member.begin),
+                   lib.bodies.begin() + static_cast<std::ptrdiff_t>(member.begin + member.size));
+        pad_member(out);
+    }
+    return Errc::Ok;
+}
+
+/// The stamp lives in the import descriptor, the first member after the bookkeeping ones.
+[[nodiscard]] bool import_library_stamped(const std::filesystem::path& lib_path, std::string_view stamp)
+{
+    std::string err;
+    const std::unique_ptr<ObjectSource> source = open_object_source(lib_path, LoadMode::Ranged, err);
+    if (!source || !ar::is_archive(*source))
+    {
+        return false;
+    }
+    ar::Member member;
+    for (std::uint64_t at = ar::kSignatureSize; at < source->size(); at = member.next())
+    {
+        if (!ar::read_member(*source, at, member, err))
+        {
+            return false;
+        }
+        if (!ar::is_special(member.name))
+        {
+            SliceObjectSource object(*source, member.data_offset, member.size);
+            return coff_stamp_matches(object, stamp);
+        }
+    }
+    return false;
+}
+
+/// Members: import descriptor, null import descriptor, null thunk, then one short import per export in `.def` order.
+[[nodiscard]] Errc build_import_library(const DefExports& def, const ExportObjectOptions& options, std::string_view stamp,
+                                        std::vector<std::uint8_t>& out, std::string& message)
+{
+    const word reloc_type = image_relative_relocation(options.machine);
+    if (reloc_type == 0)
+    {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "unsupported machine 0x%04x", options.machine);
+        message = buf;
+        return Errc::InvalidArgument;
+    }
+    ExportTable table;
+    const Errc ec = lay_out_export_table(def, table, message);
+    if (ec != Errc::Ok)
+    {
+        return ec;
+    }
+    // A by-name import carries its position in the name pointer table as hint, so the loader finds it without searching.
+    const std::vector<DefExport>& exports = def.exports;
+    std::vector<word> hints(exports.size(), 0);
+    for (std::size_t k = 0; k < table.by_name.size(); k++)
+    {
+        hints[table.by_name[k]] = static_cast<word>(k);
+    }
+
+    std::string_view stem = options.dll_name;
+    stem = stem.substr(0, stem.rfind('.'));
+    ImportLibrary lib;
+    lib.members.reserve(3 + exports.size());
+    lib.symbols.reserve(3 + 2 * exports.size());
+    lib.bodies.reserve(1024 + exports.size() * (sizeof(ImportHeader) + options.dll_name.size() + 24));
+    add_import_descriptor(lib, options, stem, stamp, reloc_type);
+    add_null_import_descriptor(lib, options.machine);
+    add_null_thunk(lib, options.machine, stem);
+    std::string symbol;
+    for (std::size_t i = 0; i < exports.size(); i++)
+    {
+        const DefExport& e = exports[i];
+        def_symbol_name(e.name, options.machine, symbol);
+        // On x86 the loader is given the `.def` name: the symbol without the underscore `def_symbol_name` added.
+        word name_type = symbol.size() != e.name.size() ? IMPORT_OBJECT_NAME_NO_PREFIX : IMPORT_OBJECT_NAME;
+        word ordinal_or_hint = hints[i];
+        if (e.noname)
+        {
+            name_type = IMPORT_OBJECT_ORDINAL;
+            ordinal_or_hint = static_cast<word>(table.ordinals[i]);
+        }
+        add_short_import(lib, options, symbol, ordinal_or_hint, name_type);
+    }
+    lib.end();
+    return write_archive(lib, options.dll_name, out, message);
+}
+
+} // namespace
+
+Errc write_import_library(const std::filesystem::path& def_path, const std::filesystem::path& lib_path, const ExportObjectOptions& options,
+                          bool& unchanged, std::string& message)
+{
+    return write_def_output(def_path, lib_path, options, kStampTag, import_library_stamped, build_import_library, unchanged, message);
+}
+
+} // namespace defgen
@@ -0,0 +1,235 @@
+#include "defgen/defgen.hpp"
+#include "ar_archive.hpp"
+#include "file_util.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <string_view>
+#include <utility>
+
+namespace defgen
+{
+
+namespace
+{
+
+constexpr std::string_view kManifestHeader = "defgen-manifest 1";
+
+/// Feeds length-prefixed fields into one buffer so that adjacent fields cannot run into each other.
+void add_field(std::string& buf, std::string_view field)
+{
+    buf += std::to_string(field.size());
+    buf += ':';
+    buf += field;
+}
+
+[[nodiscard]] bool parse_hex(std::string_view s, std::uint64_t& out)
+{
+    const auto r = std::from_chars(s.data(), s.data() + s.size(), out, 16);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+template <typename T> [[nodiscard]] bool parse_dec(std::string_view s, T& out)
+{
+    const auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+/// Next space-separated field of `line`; the remainder after the last field is the path (which may contain spaces).
+[[nodiscard]] std::string_view next_field(std::string_view& line)
+{
+    const std::size_t space = line.find(' ');
+    const std::string_view field = line.substr(0, space);
+    line = space == std::string_view::npos ? std::string_view{} : line.substr(space + 1);
+    return field;
+}
+
+[[nodiscard]] bool read_manifest(const std::filesystem::path& path, InputManifest& out)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f)
+    {
+        return false;
+    }
+    std::string line;
+    if (!std::getline(f, line) || line != kManifestHeader)
+    {
+        return false;
+    }
+    if (!std::getline(f, line))
+    {
+        return false;
+    }
+    std::string_view rest = line;
+    if (next_field(rest) != "settings" || !parse_hex(rest, out.settings_hash))
+    {
+        return false;
+    }
+    while (std::getline(f, line))
+    {
+        rest = line;
+        ManifestEntry e;
+        if (!parse_dec(next_field(rest), e.size) || !parse_dec(next_field(rest), e.mtime) || !parse_hex(next_field(rest), e.content_hash) ||
+            rest.empty())
+        {
+            return false;
+        }
+        e.path = rest;
+        out.entries.push_back(std::move(e));
+    }
+    return std::is_sorted(out.entries.begin(), out.entries.end(), [](const ManifestEntry& a, const ManifestEntry& b) { return a.path < b.path; });
+}
+
+} // namespace
+
+std::uint64_t manifest_settings_hash(ObjectFormat format, const GenerateOptions& options)
+{
+    std::string buf;
+    add_field(buf, std::to_string(static_cast<int>(format)));
+    add_field(buf, options.elf_style_export_block ? "emd" : "def");
+    add_field(buf, options.library_basename);
+    add_field(buf, options.object_count_line.value_or(std::string()));
+    add_field(buf, options.object_count_line.has_value() ? "1" : "0");
+    if (options.export_hash_in_header)
+    {
+        add_field(buf, "export-hash");
+    }
+    for (const std::string& s : options.ignore_substrings)
+    {
+        add_field(buf, s);
+    }
+    if (!options.ordinal_database.empty())
+    {
+        add_field(buf, "ordinals");
+        for (const std::string& s : options.named_exports)
+        {
+            add_field(buf, s);
+        }
+    }
+    return detail::Xxh64::hash(buf);
+}
+
+ManifestCheck check_input_manifest(const std::filesystem::path& manifest_path, const std::vector<std::filesystem::path>& object_files,
+                                   std::uint64_t settings_hash)
+{
+    ManifestCheck check;
+    InputManifest& current = check.current;
+    current.settings_hash = settings_hash;
+
+    // The output does not depend on input order or repeats, so the manifest holds the sorted set.
+    std::vector<std::pair<std::string, std::size_t>> inputs;
+    inputs.reserve(object_files.size());
+    for (std::size_t i = 0; i < object_files.size(); i++)
+    {
+        inputs.emplace_back(detail::path_key(object_files[i]), i);
+    }
+    std::sort(inputs.begin(), inputs.end());
+    inputs.erase(std::unique(inputs.begin(), inputs.end(), [](const auto& a, const auto& b) { return a.first == b.first; }), inputs.end());
+
+    InputManifest previous;
+    if (!read_manifest(manifest_path, previous))
+    {
+        check.reason = "no input manifest";
+    }
+    else if (previous.settings_hash != settings_hash)
+    {
+        check.reason = "settings changed";
+    }
+
+    auto note = [&check](const char* what, std::string_view path) {
+        if (check.reason.empty())
+        {
+            check.reason = std::string(what) + ": " + std::string(path);
+        }
+    };
+
+    // Merge walk over the two sorted lists: one stat per input, a hash only when the stat moved.
+    auto old = previous.entries.cbegin();
+    current.entries.reserve(inputs.size());
+    for (const auto& [key, index] : inputs)
+    {
+        while (old != previous.entries.cend() && old->path < key)
+        {
+            note("object removed", old->path);
+            ++old;
+        }
+        const bool known = old != previous.entries.cend() && old->path == key;
+
+        detail::FileIdentity identity;
+        if (!detail::stat_file_identity(object_files[index], identity))
+        {
+            check.reason = "cannot stat " + key;
+            check.stale = true;
+            return check;
+        }
+        ManifestEntry e;
+        e.path = key;
+        e.size = identity.size;
+        e.mtime = identity.mtime;
+        if (detail::ar::is_thin_archive_file(object_files[index]))
+        {
+            // Its members are other files the manifest does not list: always regenerate.
+            note("thin archive", key);
+        }
+        if (known && old->size == e.size && old->mtime == e.mtime)
+        {
+            e.content_hash = old->content_hash;
+        }
+        else
+        {
+            std::string err;
+            if (!detail::hash_file_content(object_files[index], e.content_hash, err))
+            {
+                check.reason = err;
+                check.stale = true;
+                return check;
+            }
+            if (!known)
+            {
+                note("object added", key);
+            }
+            else if (old->content_hash != e.content_hash || old->size != e.size)
+            {
+                note("object changed", key);
+            }
+            // Otherwise touched but identical: not a change, but the new mtime should be recorded.
+            check.stale = true;
+        }
+        if (known)
+        {
+            ++old;
+        }
+        current.entries.push_back(std::move(e));
+    }
+    if (old != previous.entries.cend())
+    {
+        note("object removed", old->path);
+    }
+
+    check.unchanged = check.reason.empty();
+    check.stale = check.stale || !check.unchanged;
+    return check;
+}
+
+bool write_input_manifest(const std::filesystem::path& manifest_path, const InputManifest& manifest, std::string& err)
+{
+    std::string text(kManifestHeader);
+    text += '\n';
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "settings %016llx\n", static_cast<unsigned long long>(manifest.settings_hash));
+    text += buf;
+    for (const ManifestEntry& e : manifest.entries)
+    {
+        std::snprintf(buf, sizeof(buf), "%llu %lld %016llx ", static_cast<unsigned long long>(e.size), static_cast<long long>(e.mtime),
+                      static_cast<unsigned long long>(e.content_hash));
+        text += buf;
+        text += e.path;
+        text += '\n';
+    }
+    return detail::write_file_atomic(manifest_path, text.data(), text.size(), err);
+}
+
+} // namespace defgen
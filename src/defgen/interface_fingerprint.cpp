@@ -0,0 +1,188 @@
+#include "defgen/defgen.hpp"
+#include "def_file.hpp"
+#include "file_util.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
+namespace defgen
+{
+
+namespace
+{
+
+using namespace detail;
+
+constexpr std::string_view kStatsHeader = "defgen-fingerprint 1";
+constexpr std::size_t kFingerprintDigits = 32;
+
+/// Same construction as the `ExportHash` header: two XXH64 lanes with different seeds, 128 bits.
+[[nodiscard]] std::string hash_hex(std::string_view text)
+{
+    char buf[kFingerprintDigits + 1] = {};
+    std::snprintf(buf, sizeof(buf), "%016llx%016llx", static_cast<unsigned long long>(Xxh64::hash(text, 0x9E3779B97F4A7C15ull)),
+                  static_cast<unsigned long long>(Xxh64::hash(text, 0)));
+    return buf;
+}
+
+/// What the last run recorded in `<fingerprint>.stats`.
+struct FingerprintState
+{
+    /// Hash of the export hash and target the fingerprint was derived from (empty: the export file had none).
+    std::string source;
+    std::string fingerprint;
+    FingerprintStats stats;
+};
+
+template <typename T> [[nodiscard]] bool parse_dec(std::string_view s, T& out)
+{
+    const auto r = std::from_chars(s.data(), s.data() + s.size(), out);
+    return r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+/// Missing or unreadable state starts over from zero.
+void read_state(const std::filesystem::path& path, FingerprintState& out)
+{
+    std::ifstream f(path, std::ios::binary);
+    std::string header;
+    std::string source;
+    std::string fingerprint;
+    std::string avoided;
+    std::string updates;
+    if (!std::getline(f, header) || header != kStatsHeader || !std::getline(f, source) || !std::getline(f, fingerprint) ||
+        !std::getline(f, avoided) || !std::getline(f, updates))
+    {
+        return;
+    }
+    FingerprintState state;
+    if (!parse_dec(avoided, state.stats.relinks_avoided) || !parse_dec(updates, state.stats.updates))
+    {
+        return;
+    }
+    state.source = source == "-" ? std::string() : source;
+    state.fingerprint = fingerprint;
+    out = std::move(state);
+}
+
+[[nodiscard]] bool write_state(const std::filesystem::path& path, const FingerprintState& state, std::string& err)
+{
+    std::string text(kStatsHeader);
+    text += '\n';
+    text += state.source.empty() ? "-" : state.source;
+    text += '\n';
+    text += state.fingerprint;
+    text += '\n';
+    text += std::to_string(state.stats.relinks_avoided);
+    text += '\n';
+    text += std::to_string(state.stats.updates);
+    text += '\n';
+    return write_file_atomic(path, text.data(), text.size(), err);
+}
+
+/// The fingerprint file holds the digits and a newline; anything else counts as a different fingerprint.
+[[nodiscard]] bool fingerprint_file_is(const std::filesystem::path& path, std::string_view fingerprint)
+{
+    std::ifstream f(path, std::ios::binary);
+    char buf[kFingerprintDigits + 2] = {};
+    f.read(buf, sizeof(buf));
+    return f.gcount() == static_cast<std::streamsize>(kFingerprintDigits + 1) && std::string_view(buf, kFingerprintDigits) == fingerprint &&
+           buf[kFingerprintDigits] == '\n';
+}
+
+/// Fingerprint of the exports as read: the target, then one `name[ @N[ NONAME]]` line per export in byte order, so
+/// neither the export file's layout nor the order of its entries matters.
+[[nodiscard]] Errc compute_fingerprint(const std::filesystem::path& export_path, ObjectFormat format, std::string_view target,
+                                       std::string& out, std::string& message)
+{
+    DefExports def;
+    const Errc ec = format == ObjectFormat::Elf ? read_emd_exports(export_path, def, message) : read_def_exports(export_path, def, message);
+    if (ec != Errc::Ok)
+    {
+        return ec;
+    }
+    std::vector<DefExport>& exports = def.exports;
+    std::sort(exports.begin(), exports.end(), [](const DefExport& a, const DefExport& b) { return a.name < b.name; });
+    std::string text(target);
+    text += '\n';
+    text.reserve(def.text.size() + text.size());
+    for (std::size_t i = 0; i < exports.size(); i++)
+    {
+        const DefExport& e = exports[i];
+        if (i != 0 && exports[i - 1].name == e.name)
+        {
+            message = path_key(export_path) + ": " + std::string(e.name) + " is exported twice";
+            return Errc::Parse;
+        }
+        text += e.name;
+        if (e.ordinal != 0)
+        {
+            text += " @";
+            text += std::to_string(e.ordinal);
+            if (e.noname)
+            {
+                text += " NONAME";
+            }
+        }
+        text += '\n';
+    }
+    out = hash_hex(text);
+    return Errc::Ok;
+}
+
+} // namespace
+
+Errc write_interface_fingerprint(const std::filesystem::path& export_path, ObjectFormat format,
+                                 const std::filesystem::path& fingerprint_path, std::string_view target, bool& unchanged,
+                                 FingerprintStats& stats, std::string& message)
+{
+    unchanged = false;
+    std::filesystem::path state_path = fingerprint_path;
+    state_path += ".stats";
+    FingerprintState state;
+    read_state(state_path, state);
+
+    std::string export_hash;
+    std::string source;
+    if (read_def_export_hash(export_path, export_hash))
+    {
+        source = hash_hex(export_hash + '\n' + std::string(target));
+    }
+
+    // The export hash stands for the whole export list: when the last run derived the current fingerprint from the
+    // same one, the exports need not be read again.
+    std::string fingerprint;
+    if (!source.empty() && source == state.source && fingerprint_file_is(fingerprint_path, state.fingerprint))
+    {
+        fingerprint = state.fingerprint;
+        unchanged = true;
+    }
+    else
+    {
+        const Errc ec = compute_fingerprint(export_path, format, target, fingerprint, message);
+        if (ec != Errc::Ok)
+        {
+            return ec;
+        }
+        unchanged = fingerprint_file_is(fingerprint_path, fingerprint);
+        if (!unchanged)
+        {
+            const std::string text = fingerprint + '\n';
+            if (!write_file_atomic(fingerprint_path, text.data(), text.size(), message))
+            {
+                return Errc::Io;
+            }
+        }
+    }
+
+    state.source = source;
+    state.fingerprint = fingerprint;
+    ++(unchanged ? state.stats.relinks_avoided : state.stats.updates);
+    stats = state.stats;
+    return write_state(state_path, state, message) ? Errc::Ok : Errc::Io;
+}
+
+} // namespace defgen
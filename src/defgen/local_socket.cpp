@@ -0,0 +1,647 @@
+#include "local_socket.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace defgen::detail
+{
+
+LocalStream::~LocalStream() { close(); }
+
+#ifdef _WIN32
+
+namespace
+{
+
+constexpr DWORD kPipeBufferSize = 64 * 1024;
+/// The daemon serves one client at a time; a client that connects and then stalls must not hold it forever.
+constexpr DWORD kServerIoTimeoutMs = 10 * 1000;
+/// A daemon that accepts and then never answers must not hang the link: the caller falls back to generating in-process.
+/// Long enough for a first request that parses every object.
+constexpr DWORD kClientIoTimeoutMs = 60 * 1000;
+
+[[nodiscard]] std::string win_error(const char* what)
+{
+    return std::string(what) + " (error " + std::to_string(GetLastError()) + ")";
+}
+
+/// `TOKEN_USER` of the account `process` runs as, in `out`. False on failure (e.g. another user's process).
+[[nodiscard]] bool process_user(HANDLE process, std::vector<std::uint8_t>& out)
+{
+    HANDLE token = nullptr;
+    if (!OpenProcessToken(process, TOKEN_QUERY, &token))
+    {
+        return false;
+    }
+    DWORD size = 0;
+    GetTokenInformation(token, TokenUser, nullptr, 0, &size);
+    out.resize(size);
+    const bool ok = size != 0 && GetTokenInformation(token, TokenUser, out.data(), size, &size) != FALSE;
+    CloseHandle(token);
+    return ok;
+}
+
+[[nodiscard]] PSID user_sid(std::vector<std::uint8_t>& token_user) { return reinterpret_cast<TOKEN_USER*>(token_user.data())->User.Sid; }
+
+/// Security descriptor owned by the current user whose DACL grants access to that user only.
+struct UserOnlySecurity
+{
+    std::vector<std::uint8_t> user;
+    std::vector<std::uint8_t> acl;
+    SECURITY_DESCRIPTOR descriptor{};
+    SECURITY_ATTRIBUTES attributes{};
+
+    [[nodiscard]] bool init()
+    {
+        if (!process_user(GetCurrentProcess(), user))
+        {
+            return false;
+        }
+        const PSID sid = user_sid(user);
+        const DWORD acl_size = sizeof(ACL) + sizeof(ACCESS_ALLOWED_ACE) - sizeof(DWORD) + GetLengthSid(sid);
+        acl.resize(acl_size);
+        auto* dacl = reinterpret_cast<PACL>(acl.data());
+        if (!InitializeAcl(dacl, acl_size, ACL_REVISION) || !AddAccessAllowedAce(dacl, ACL_REVISION, GENERIC_ALL, sid) ||
+            !InitializeSecurityDescriptor(&descriptor, SECURITY_DESCRIPTOR_REVISION) ||
+            !SetSecurityDescriptorOwner(&descriptor, sid, FALSE) || !SetSecurityDescriptorDacl(&descriptor, TRUE, dacl, FALSE))
+        {
+            return false;
+        }
+        attributes = {sizeof(SECURITY_ATTRIBUTES), &descriptor, FALSE};
+        return true;
+    }
+};
+
+[[nodiscard]] HANDLE create_pipe_instance(const std::filesystem::path& endpoint, bool first)
+{
+    // The default descriptor would let other local users open the pipe.
+    UserOnlySecurity security;
+    if (!security.init())
+    {
+        return INVALID_HANDLE_VALUE;
+    }
+    // Overlapped, so reads and writes on the server end can time out (see `timed_io`).
+    DWORD open_mode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED;
+    if (first)
+    {
+        open_mode |= FILE_FLAG_FIRST_PIPE_INSTANCE;
+    }
+    return CreateNamedPipeW(endpoint.c_str(), open_mode, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                            PIPE_UNLIMITED_INSTANCES, kPipeBufferSize, kPipeBufferSize, 0, &security.attributes);
+}
+
+/// True when both the pipe and the process serving it belong to the current user. Any user can create a pipe named
+/// `defgen-<user>` before the daemon does.
+[[nodiscard]] bool served_by_current_user(HANDLE pipe)
+{
+    std::vector<std::uint8_t> self;
+    if (!process_user(GetCurrentProcess(), self))
+    {
+        return false;
+    }
+    DWORD size = 0;
+    GetKernelObjectSecurity(pipe, OWNER_SECURITY_INFORMATION, nullptr, 0, &size);
+    std::vector<std::uint8_t> descriptor(size);
+    PSID owner = nullptr;
+    BOOL defaulted = FALSE;
+    if (size == 0 || !GetKernelObjectSecurity(pipe, OWNER_SECURITY_INFORMATION, descriptor.data(), size, &size) ||
+        !GetSecurityDescriptorOwner(descriptor.data(), &owner, &defaulted) || owner == nullptr || !EqualSid(owner, user_sid(self)))
+    {
+        return false;
+    }
+    ULONG pid = 0;
+    if (!GetNamedPipeServerProcessId(pipe, &pid))
+    {
+        return false;
+    }
+    const HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (process == nullptr)
+    {
+        return false;
+    }
+    std::vector<std::uint8_t> server;
+    const bool ok = process_user(process, server) && EqualSid(user_sid(server), user_sid(self));
+    CloseHandle(process);
+    return ok;
+}
+
+/// Run one overlapped operation on a pipe handle (`start` issues it) and wait for it, at most `timeout_ms`.
+/// A timed-out operation is cancelled; false with `GetLastError() == ERROR_TIMEOUT`.
+template <typename Start> [[nodiscard]] bool timed_io(HANDLE h, DWORD timeout_ms, DWORD& done, Start&& start)
+{
+    OVERLAPPED ov{};
+    ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (ov.hEvent == nullptr)
+    {
+        return false;
+    }
+    bool ok = start(&ov) != FALSE || GetLastError() == ERROR_IO_PENDING;
+    if (ok && WaitForSingleObject(ov.hEvent, timeout_ms) != WAIT_OBJECT_0)
+    {
+        // The operation may still complete before the cancel lands; either way it must be over before `ov` goes away.
+        CancelIoEx(h, &ov);
+        ok = GetOverlappedResult(h, &ov, &done, TRUE) != FALSE;
+        if (!ok)
+        {
+            SetLastError(ERROR_TIMEOUT);
+        }
+    }
+    else if (ok)
+    {
+        ok = GetOverlappedResult(h, &ov, &done, FALSE) != FALSE;
+    }
+    const DWORD error = GetLastError();
+    CloseHandle(ov.hEvent);
+    SetLastError(error);
+    return ok;
+}
+
+} // namespace
+
+LocalStream::LocalStream(LocalStream&& other) noexcept
+    : handle_(std::exchange(other.handle_, nullptr))
+    , server_(other.server_)
+{
+}
+
+LocalStream& LocalStream::operator=(LocalStream&& other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        handle_ = std::exchange(other.handle_, nullptr);
+        server_ = other.server_;
+    }
+    return *this;
+}
+
+bool LocalStream::connect(const std::filesystem::path& endpoint, std::string& err)
+{
+    close();
+    // Every instance can be busy for a moment while the daemon hands one to a client and creates the next.
+    for (int attempt = 0; attempt < 10; attempt++)
+    {
+        // Overlapped, so that a daemon that stops answering times out (see `timed_io`).
+        const HANDLE h =
+            CreateFileW(endpoint.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+        if (h != INVALID_HANDLE_VALUE)
+        {
+            if (!served_by_current_user(h))
+            {
+                CloseHandle(h);
+                err = "defgen daemon endpoint " + endpoint.string() + " is not served by the current user";
+                return false;
+            }
+            handle_ = h;
+            server_ = false;
+            return true;
+        }
+        if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(endpoint.c_str(), 1000))
+        {
+            break;
+        }
+    }
+    err = win_error("cannot connect to defgen daemon");
+    return false;
+}
+
+bool LocalStream::is_open() const { return handle_ != nullptr; }
+
+void LocalStream::close()
+{
+    if (handle_ == nullptr)
+    {
+        return;
+    }
+    if (server_)
+    {
+        FlushFileBuffers(handle_);
+        DisconnectNamedPipe(handle_);
+    }
+    CloseHandle(handle_);
+    handle_ = nullptr;
+}
+
+void LocalStream::abandon()
+{
+    // `close` would otherwise wait in `FlushFileBuffers` for a client that no longer reads.
+    if (server_)
+    {
+        DisconnectNamedPipe(handle_);
+    }
+}
+
+bool LocalStream::read_all(void* data, std::size_t size, std::string& err)
+{
+    auto* p = static_cast<char*>(data);
+    while (size > 0)
+    {
+        const DWORD chunk = static_cast<DWORD>(size < kPipeBufferSize ? size : kPipeBufferSize);
+        DWORD got = 0;
+        const bool ok = timed_io(handle_, server_ ? kServerIoTimeoutMs : kClientIoTimeoutMs, got,
+                                 [&](OVERLAPPED* ov) { return ReadFile(handle_, p, chunk, nullptr, ov); });
+        if (!ok || got == 0)
+        {
+            err = win_error(GetLastError() == ERROR_TIMEOUT ? "pipe read timed out" : "pipe read failed");
+            abandon();
+            return false;
+        }
+        p += got;
+        size -= got;
+    }
+    return true;
+}
+
+bool LocalStream::write_all(const void* data, std::size_t size, std::string& err)
+{
+    const auto* p = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const DWORD chunk = static_cast<DWORD>(size < kPipeBufferSize ? size : kPipeBufferSize);
+        DWORD put = 0;
+        const bool ok = timed_io(handle_, server_ ? kServerIoTimeoutMs : kClientIoTimeoutMs, put,
+                                 [&](OVERLAPPED* ov) { return WriteFile(handle_, p, chunk, nullptr, ov); });
+        if (!ok)
+        {
+            err = win_error(GetLastError() == ERROR_TIMEOUT ? "pipe write timed out" : "pipe write failed");
+            abandon();
+            return false;
+        }
+        p += put;
+        size -= put;
+    }
+    return true;
+}
+
+LocalListener::~LocalListener() { close(); }
+
+bool LocalListener::listen(const std::filesystem::path& endpoint, std::string& err)
+{
+    close();
+    const HANDLE h = create_pipe_instance(endpoint, true);
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        err = GetLastError() == ERROR_ACCESS_DENIED ? "a defgen daemon is already listening on " + endpoint.string()
+                                                    : win_error("cannot create pipe");
+        return false;
+    }
+    endpoint_ = endpoint;
+    pending_ = h;
+    return true;
+}
+
+bool LocalListener::accept(LocalStream& out, std::string& err)
+{
+    if (pending_ == nullptr)
+    {
+        const HANDLE h = create_pipe_instance(endpoint_, false);
+        if (h == INVALID_HANDLE_VALUE)
+        {
+            err = win_error("cannot create pipe");
+            return false;
+        }
+        pending_ = h;
+    }
+    DWORD unused = 0;
+    if (!timed_io(pending_, INFINITE, unused, [&](OVERLAPPED* ov) { return ConnectNamedPipe(pending_, ov); }) &&
+        GetLastError() != ERROR_PIPE_CONNECTED)
+    {
+        err = win_error("pipe connect failed");
+        CloseHandle(pending_);
+        pending_ = nullptr;
+        return false;
+    }
+    out.close();
+    out.handle_ = std::exchange(pending_, nullptr);
+    out.server_ = true;
+    const HANDLE next = create_pipe_instance(endpoint_, false);
+    pending_ = next == INVALID_HANDLE_VALUE ? nullptr : next;
+    return true;
+}
+
+void LocalListener::close()
+{
+    if (pending_ != nullptr)
+    {
+        CloseHandle(pending_);
+        pending_ = nullptr;
+    }
+}
+
+std::filesystem::path default_local_endpoint()
+{
+    std::wstring name = L"\\\\.\\pipe\\defgen";
+    wchar_t user[256] = {};
+    const DWORD len = GetEnvironmentVariableW(L"USERNAME", user, static_cast<DWORD>(std::size(user)));
+    if (len > 0 && len < std::size(user))
+    {
+        name += L'-';
+        name += user;
+    }
+    return name;
+}
+
+#else
+
+namespace
+{
+
+[[nodiscard]] std::string errno_error(const char* what) { return std::string(what) + ": " + std::strerror(errno); }
+
+/// A daemon that accepts and then never answers must not hang the link: the caller falls back to generating in-process.
+/// Long enough for a first request that parses every object.
+constexpr int kClientIoTimeoutSeconds = 60;
+/// The daemon serves one client at a time; a client that connects and then stalls must not hold it forever.
+constexpr int kServerIoTimeoutSeconds = 10;
+
+void set_io_timeout(int fd, int seconds)
+{
+    timeval timeout{};
+    timeout.tv_sec = seconds;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+/// True when the process at the other end of `fd` runs as the current user. The default endpoint may be in `/tmp`,
+/// where any user can bind `defgen-<uid>.sock` first; socket file modes are not honoured everywhere either.
+[[nodiscard]] bool peer_is_current_user(int fd)
+{
+#if defined(SO_PEERCRED)
+    ucred cred{};
+    socklen_t size = sizeof(cred);
+    return ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0 && size == sizeof(cred) && cred.uid == ::getuid();
+#else
+    uid_t uid = 0;
+    gid_t gid = 0;
+    return ::getpeereid(fd, &uid, &gid) == 0 && uid == ::getuid();
+#endif
+}
+
+[[nodiscard]] bool make_address(const std::filesystem::path& endpoint, sockaddr_un& addr, std::string& err)
+{
+    addr = sockaddr_un{};
+    addr.sun_family = AF_UNIX;
+    const std::string& s = endpoint.native();
+    if (s.empty() || s.size() >= sizeof(addr.sun_path))
+    {
+        err = "socket path too long: " + s;
+        return false;
+    }
+    std::memcpy(addr.sun_path, s.c_str(), s.size() + 1);
+    return true;
+}
+
+[[nodiscard]] int open_socket(std::string& err)
+{
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        err = errno_error("socket");
+        return -1;
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    const int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    return fd;
+}
+
+} // namespace
+
+LocalStream::LocalStream(LocalStream&& other) noexcept
+    : fd_(std::exchange(other.fd_, -1))
+{
+}
+
+LocalStream& LocalStream::operator=(LocalStream&& other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        fd_ = std::exchange(other.fd_, -1);
+    }
+    return *this;
+}
+
+bool LocalStream::connect(const std::filesystem::path& endpoint, std::string& err)
+{
+    close();
+    sockaddr_un addr;
+    if (!make_address(endpoint, addr, err))
+    {
+        return false;
+    }
+    const int fd = open_socket(err);
+    if (fd < 0)
+    {
+        return false;
+    }
+    int rc = 0;
+    do
+    {
+        rc = ::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    } while (rc != 0 && errno == EINTR);
+    if (rc != 0)
+    {
+        err = errno_error("cannot connect to defgen daemon");
+        ::close(fd);
+        return false;
+    }
+    if (!peer_is_current_user(fd))
+    {
+        err = "defgen daemon endpoint " + endpoint.string() + " is not served by the current user";
+        ::close(fd);
+        return false;
+    }
+    set_io_timeout(fd, kClientIoTimeoutSeconds);
+    fd_ = fd;
+    return true;
+}
+
+bool LocalStream::is_open() const { return fd_ >= 0; }
+
+void LocalStream::close()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool LocalStream::read_all(void* data, std::size_t size, std::string& err)
+{
+    auto* p = static_cast<char*>(data);
+    while (size > 0)
+    {
+        const ssize_t got = ::recv(fd_, p, size, 0);
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            if (got == 0)
+            {
+                err = "connection closed";
+            }
+            else
+            {
+                err = errno == EAGAIN || errno == EWOULDBLOCK ? std::string("socket read timed out") : errno_error("socket read failed");
+            }
+            return false;
+        }
+        p += got;
+        size -= static_cast<std::size_t>(got);
+    }
+    return true;
+}
+
+bool LocalStream::write_all(const void* data, std::size_t size, std::string& err)
+{
+#ifdef MSG_NOSIGNAL
+    constexpr int flags = MSG_NOSIGNAL;
+#else
+    constexpr int flags = 0;
+#endif
+    const auto* p = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        const ssize_t put = ::send(fd_, p, size, flags);
+        if (put < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (put <= 0)
+        {
+            const bool timed_out = put < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+            err = timed_out ? std::string("socket write timed out") : errno_error("socket write failed");
+            return false;
+        }
+        p += put;
+        size -= static_cast<std::size_t>(put);
+    }
+    return true;
+}
+
+LocalListener::~LocalListener() { close(); }
+
+bool LocalListener::listen(const std::filesystem::path& endpoint, std::string& err)
+{
+    close();
+    sockaddr_un addr;
+    if (!make_address(endpoint, addr, err))
+    {
+        return false;
+    }
+    {
+        LocalStream probe;
+        std::string probe_err;
+        if (probe.connect(endpoint, probe_err))
+        {
+            err = "a defgen daemon is already listening on " + endpoint.string();
+            return false;
+        }
+    }
+    // Nothing answers: a socket file that is still there was left by a daemon that did not shut down cleanly.
+    struct stat st
+    {
+    };
+    if (::lstat(endpoint.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+    {
+        ::unlink(endpoint.c_str());
+    }
+
+    const int fd = open_socket(err);
+    if (fd < 0)
+    {
+        return false;
+    }
+    const mode_t old_mask = ::umask(0077);
+    const int bound = ::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    ::umask(old_mask);
+    if (bound != 0 || ::listen(fd, 64) != 0)
+    {
+        err = errno_error(("cannot listen on " + endpoint.string()).c_str());
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    endpoint_ = endpoint;
+    return true;
+}
+
+bool LocalListener::accept(LocalStream& out, std::string& err)
+{
+    int fd = -1;
+    for (;;)
+    {
+        fd = ::accept(fd_, nullptr, nullptr);
+        if (fd < 0 && (errno == EINTR || errno == ECONNABORTED))
+        {
+            continue;
+        }
+        if (fd < 0)
+        {
+            err = errno_error("accept");
+            return false;
+        }
+        if (peer_is_current_user(fd))
+        {
+            break;
+        }
+        ::close(fd);
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    set_io_timeout(fd, kServerIoTimeoutSeconds);
+    out.close();
+    out.fd_ = fd;
+    return true;
+}
+
+void LocalListener::close()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+        ::unlink(endpoint_.c_str());
+    }
+}
+
+std::filesystem::path default_local_endpoint()
+{
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir != nullptr && runtime_dir[0] != '\0')
+    {
+        return std::filesystem::path(runtime_dir) / "defgen.sock";
+    }
+    return std::filesystem::path("/tmp") / ("defgen-" + std::to_string(::getuid()) + ".sock");
+}
+
+#endif
+
+} // namespace defgen::detail
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+namespace defgen::detail
+{
+
+/// One connected byte stream between a daemon and a client: a Unix domain socket, or a named pipe on Windows.
+class LocalStream
+{
+  public:
+    LocalStream() = default;
+    ~LocalStream();
+    LocalStream(LocalStream&& other) noexcept;
+    LocalStream& operator=(LocalStream&& other) noexcept;
+    LocalStream(const LocalStream&) = delete;
+    LocalStream& operator=(const LocalStream&) = delete;
+
+    /// Connect to a listening `endpoint`. Fails fast when nothing is listening, and fails when the endpoint is served by
+    /// another user. Reads and writes on the connected stream time out after 60 seconds.
+    [[nodiscard]] bool connect(const std::filesystem::path& endpoint, std::string& err);
+    [[nodiscard]] bool is_open() const;
+    void close();
+
+    /// Block until exactly `size` bytes are read; fails on EOF.
+    [[nodiscard]] bool read_all(void* data, std::size_t size, std::string& err);
+    [[nodiscard]] bool write_all(const void* data, std::size_t size, std::string& err);
+
+  private:
+    friend class LocalListener;
+#ifdef _WIN32
+    /// After a failed server-side read or write: drop the client so `close` does not wait for it.
+    void abandon();
+
+    void* handle_ = nullptr;
+    /// Server end of a pipe instance: flushed and disconnected before closing so the client sees every byte.
+    bool server_ = false;
+#else
+    int fd_ = -1;
+#endif
+};
+
+/// Listening endpoint. Only the current user can connect: the socket file is created mode 0600 and peers of other users
+/// are dropped on accept; the pipe's DACL admits the current user only, and remote clients are rejected.
+class LocalListener
+{
+  public:
+    LocalListener() = default;
+    ~LocalListener();
+    LocalListener(const LocalListener&) = delete;
+    LocalListener& operator=(const LocalListener&) = delete;
+
+    /// Fails if another process is already listening on `endpoint`; a stale socket file left by a crashed daemon is replaced.
+    [[nodiscard]] bool listen(const std::filesystem::path& endpoint, std::string& err);
+    /// Wait for the next client. Reads and writes on the accepted stream time out after 10 seconds.
+    [[nodiscard]] bool accept(LocalStream& out, std::string& err);
+    void close();
+
+  private:
+    std::filesystem::path endpoint_;
+#ifdef _WIN32
+    /// Pipe instance waiting for the next client; one always exists between accepts so clients never find no pipe.
+    void* pending_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+/// `$XDG_RUNTIME_DIR/defgen.sock` (else `/tmp/defgen-<uid>.sock`); `\\.\pipe\defgen-<user>` on Windows.
+[[nodiscard]] std::filesystem::path default_local_endpoint();
+
+} // namespace defgen::detail
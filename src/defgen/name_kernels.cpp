@@ -0,0 +1,246 @@
+#include "name_kernels.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || (defined(_M_IX86) && !defined(_M_ARM64EC))
+#define DEFGEN_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define DEFGEN_TARGET(isa)
+#else
+#define DEFGEN_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+struct Kernels
+{
+    SimdLevel level;
+    IdentifierKernel identifier;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Scalar
+
+struct IdentifierTable
+{
+    bool bytes[256]{};
+
+    constexpr IdentifierTable()
+    {
+        for (int c = '0'; c <= '9'; c++)
+        {
+            bytes[c] = true;
+        }
+        for (int c = 'A'; c <= 'Z'; c++)
+        {
+            bytes[c] = true;
+            bytes[c + ('a' - 'A')] = true;
+        }
+        bytes[static_cast<unsigned char>('_')] = true;
+    }
+};
+
+constexpr IdentifierTable kIdentifierBytes{};
+
+bool identifier_scalar(const char* s, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; i++)
+    {
+        if (!kIdentifierBytes.bytes[static_cast<unsigned char>(s[i])])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(DEFGEN_SIMD_X86)
+
+// ---------------------------------------------------------------------------------------------------------------------
+// SSE4.2: PCMPESTRI range match, 16 bytes per step.
+
+DEFGEN_TARGET("sse4.2") bool identifier_sse42(const char* s, std::size_t n)
+{
+    const __m128i ranges = _mm_setr_epi8('0', '9', 'A', 'Z', '_', '_', 'a', 'z', 0, 0, 0, 0, 0, 0, 0, 0);
+    constexpr int kMode = _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_MASKED_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT;
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        if (_mm_cmpestri(ranges, 8, chunk, 16, kMode) != 16)
+        {
+            return false;
+        }
+    }
+    // A tail of up to 15 bytes is cheaper byte by byte than copied out for one more compare (which must not read past
+    // the end of the string table).
+    return identifier_scalar(s + i, n - i);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// AVX-512 (F + BW): masked loads need no tail copy.
+
+DEFGEN_TARGET("avx512f,avx512bw") bool identifier_avx512(const char* s, std::size_t n)
+{
+    const __m512i caseBit = _mm512_set1_epi8(0x20);
+    const __m512i a = _mm512_set1_epi8('a');
+    const __m512i zero = _mm512_set1_epi8('0');
+    const __m512i underscore = _mm512_set1_epi8('_');
+    for (std::size_t i = 0; i < n; i += 64)
+    {
+        const std::size_t left = n - i;
+        const __mmask64 valid = left >= 64 ? ~__mmask64{0} : (__mmask64{1} << left) - 1;
+        const __m512i x = _mm512_maskz_loadu_epi8(valid, s + i);
+        const __mmask64 alpha = _mm512_cmple_epu8_mask(_mm512_sub_epi8(_mm512_or_si512(x, caseBit), a), _mm512_set1_epi8(25));
+        const __mmask64 digit = _mm512_cmple_epu8_mask(_mm512_sub_epi8(x, zero), _mm512_set1_epi8(9));
+        const __mmask64 good = alpha | digit | _mm512_cmpeq_epi8_mask(x, underscore);
+        if ((good & valid) != valid)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+[[nodiscard]] SimdLevel detect_cpu_level()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4]{};
+    __cpuid(regs, 0);
+    const int maxLeaf = regs[0];
+    __cpuid(regs, 1);
+    const bool sse42 = (regs[2] & (1 << 20)) != 0;
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const bool avx = (regs[2] & (1 << 28)) != 0;
+    if (!sse42)
+    {
+        return SimdLevel::Scalar;
+    }
+    if (!osxsave || !avx || maxLeaf < 7)
+    {
+        return SimdLevel::Sse42;
+    }
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(regs, 7, 0);
+    const bool avx512 = (regs[1] & (1 << 16)) != 0 && (regs[1] & (1 << 30)) != 0 && (xcr0 & 0xe6) == 0xe6;
+    return avx512 ? SimdLevel::Avx512 : SimdLevel::Sse42;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    {
+        return SimdLevel::Avx512;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return SimdLevel::Sse42;
+    }
+    return SimdLevel::Scalar;
+#endif
+}
+
+#else
+
+[[nodiscard]] SimdLevel detect_cpu_level() { return SimdLevel::Scalar; }
+
+#endif
+
+/// `DEFGEN_SIMD` override, or `Sse42` when unset or unrecognized.
+[[nodiscard]] SimdLevel environment_cap()
+{
+    std::string value;
+#if defined(_MSC_VER)
+    char* buffer = nullptr;
+    std::size_t length = 0;
+    if (_dupenv_s(&buffer, &length, "DEFGEN_SIMD") == 0 && buffer != nullptr)
+    {
+        value = buffer;
+        std::free(buffer);
+    }
+#else
+    if (const char* env = std::getenv("DEFGEN_SIMD"))
+    {
+        value = env;
+    }
+#endif
+    if (value == "scalar")
+    {
+        return SimdLevel::Scalar;
+    }
+    if (value == "avx512")
+    {
+        return SimdLevel::Avx512;
+    }
+    return SimdLevel::Sse42;
+}
+
+[[nodiscard]] Kernels pick_kernels()
+{
+    const SimdLevel cpu = detect_cpu_level();
+    const SimdLevel cap = environment_cap();
+    const SimdLevel level = cpu < cap ? cpu : cap;
+    switch (level)
+    {
+#if defined(DEFGEN_SIMD_X86)
+    case SimdLevel::Avx512:
+        return {level, identifier_avx512};
+    case SimdLevel::Sse42:
+        return {level, identifier_sse42};
+#endif
+    default:
+        return {SimdLevel::Scalar, identifier_scalar};
+    }
+}
+
+[[nodiscard]] const Kernels& kernels()
+{
+    static const Kernels selected = pick_kernels();
+    return selected;
+}
+
+} // namespace
+
+SimdLevel simd_level() { return kernels().level; }
+
+bool is_identifier(std::string_view name) { return kernels().identifier(name.data(), name.size()); }
+
+IdentifierKernel identifier_kernel(SimdLevel level)
+{
+    if (level > detect_cpu_level())
+    {
+        return nullptr;
+    }
+    switch (level)
+    {
+#if defined(DEFGEN_SIMD_X86)
+    case SimdLevel::Avx512:
+        return identifier_avx512;
+    case SimdLevel::Sse42:
+        return identifier_sse42;
+#endif
+    default:
+        return identifier_scalar;
+    }
+}
+
+void select_records_by_byte(const std::uint8_t* base, std::size_t stride, std::size_t count, std::uint8_t value,
+                            std::vector<std::uint32_t>& out)
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        if (base[i * stride] == value)
+        {
+            out.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+}
+
+} // namespace defgen::detail
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// Instruction sets the kernels below are compiled for; picked on first use from what the CPU and OS support.
+enum class SimdLevel
+{
+    Scalar,
+    Sse42,
+    Avx512
+};
+
+/// Level the kernels dispatch to: SSE4.2 when available, unless `DEFGEN_SIMD=scalar|sse4.2|avx512` in the environment
+/// says otherwise (read once). AVX-512 is opt-in: it only wins in tight loops (`defgen-bench kernels`).
+[[nodiscard]] SimdLevel simd_level();
+
+/// True when every byte of `name` is `[A-Za-z0-9_]` (`std::isalnum` in the "C" locale, or `_`); true for an empty name.
+/// The vector kernels check whole 16/64-byte blocks only: SSE4.2 finishes the last 0-15 bytes (all of a short name) with
+/// the scalar table, so it is never slower than scalar.
+[[nodiscard]] bool is_identifier(std::string_view name);
+
+using IdentifierKernel = bool (*)(const char* s, std::size_t n);
+
+/// The `is_identifier` kernel of `level`, or null when it is not compiled in or the CPU lacks it (for `defgen-bench`).
+[[nodiscard]] IdentifierKernel identifier_kernel(SimdLevel level);
+
+/// Append to `out` every index `i < count` whose record byte `base[i * stride] == value`.
+/// One byte compare per record instead of decoding bind and type separately. Deliberately not vectorized: with 16- or
+/// 24-byte ELF records a vector compare spends most of its lanes on bytes that are not `st_info`, and measured slower
+/// than this loop at every level.
+void select_records_by_byte(const std::uint8_t* base, std::size_t stride, std::size_t count, std::uint8_t value,
+                            std::vector<std::uint32_t>& out);
+
+} // namespace defgen::detail
@@ -0,0 +1,218 @@
+#include "name_sort.hpp"
+#include "work_stealing.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+constexpr std::size_t kInsertionSortSize = 16;
+
+struct Keyed
+{
+    /// Bytes `[depth, depth + 8)` of the name, big-endian, zero-padded past the end.
+    std::uint64_t key;
+    SymbolHandle name;
+};
+
+struct Range
+{
+    std::size_t begin;
+    std::size_t end;
+    std::size_t depth;
+};
+
+[[nodiscard]] std::uint64_t prefix_key(SymbolHandle h, std::size_t depth)
+{
+    const auto* s = reinterpret_cast<const unsigned char*>(h->c_str());
+    const std::size_t size = h->size;
+    std::uint64_t key = 0;
+    for (std::size_t i = 0; i < 8; i++)
+    {
+        const std::size_t pos = depth + i;
+        key = (key << 8) | (pos < size ? s[pos] : 0u);
+    }
+    return key;
+}
+
+/// A zero low byte means the name ended inside this key, so equal keys mean equal names.
+[[nodiscard]] bool ends_in(std::uint64_t key) { return (key & 0xffu) == 0; }
+
+[[nodiscard]] bool less_from(const Keyed& a, const Keyed& b, std::size_t depth)
+{
+    if (a.key != b.key)
+    {
+        return a.key < b.key;
+    }
+    if (ends_in(a.key))
+    {
+        return false;
+    }
+    return a.name->view().substr(depth + 8) < b.name->view().substr(depth + 8);
+}
+
+void insertion_sort(Keyed* items, std::size_t n, std::size_t depth)
+{
+    for (std::size_t i = 1; i < n; i++)
+    {
+        Keyed v = items[i];
+        std::size_t j = i;
+        while (j > 0 && less_from(v, items[j - 1], depth))
+        {
+            items[j] = items[j - 1];
+            --j;
+        }
+        items[j] = v;
+    }
+}
+
+[[nodiscard]] std::uint64_t median_of_three(std::uint64_t a, std::uint64_t b, std::uint64_t c)
+{
+    if (a < b)
+    {
+        return b < c ? b : (a < c ? c : a);
+    }
+    return a < c ? a : (b < c ? c : b);
+}
+
+/// One 3-way partition step on the current keys. Returns the equal range (`eq_begin`, `eq_end`) and whether its
+/// names still continue past this key (in which case their keys have been reloaded at `depth + 8`).
+[[nodiscard]] bool partition_step(Keyed* items, const Range& r, std::size_t& eq_begin, std::size_t& eq_end)
+{
+    const std::size_t n = r.end - r.begin;
+    Keyed* base = items + r.begin;
+    const std::uint64_t pivot = median_of_three(base[0].key, base[n / 2].key, base[n - 1].key);
+    std::size_t lt = 0;
+    std::size_t i = 0;
+    std::size_t gt = n;
+    while (i < gt)
+    {
+        if (base[i].key < pivot)
+        {
+            std::swap(base[lt++], base[i++]);
+        }
+        else if (base[i].key > pivot)
+        {
+            std::swap(base[i], base[--gt]);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    eq_begin = r.begin + lt;
+    eq_end = r.begin + gt;
+    if (ends_in(pivot))
+    {
+        return false;
+    }
+    for (std::size_t k = eq_begin; k < eq_end; k++)
+    {
+        items[k].key = prefix_key(items[k].name, r.depth + 8);
+    }
+    return true;
+}
+
+void multikey_sort(Keyed* items, Range r, int budget)
+{
+    while (r.end - r.begin > kInsertionSortSize)
+    {
+        if (budget-- <= 0)
+        {
+            // Degenerate pivots: finish with a comparison sort on the same keys.
+            const std::size_t depth = r.depth;
+            std::sort(items + r.begin, items + r.end, [depth](const Keyed& a, const Keyed& b) { return less_from(a, b, depth); });
+            return;
+        }
+        std::size_t eq_begin = 0;
+        std::size_t eq_end = 0;
+        const bool descend = partition_step(items, r, eq_begin, eq_end);
+        multikey_sort(items, {r.begin, eq_begin, r.depth}, budget);
+        multikey_sort(items, {eq_end, r.end, r.depth}, budget);
+        if (!descend)
+        {
+            return;
+        }
+        r = {eq_begin, eq_end, r.depth + 8};
+    }
+    insertion_sort(items + r.begin, r.end - r.begin, r.depth);
+}
+
+[[nodiscard]] int depth_budget(std::size_t n)
+{
+    int log2 = 0;
+    while (n > 1)
+    {
+        n >>= 1;
+        ++log2;
+    }
+    return 2 * log2 + 8;
+}
+
+} // namespace
+
+void sort_names(std::vector<SymbolHandle>& names, unsigned threads)
+{
+    const std::size_t n = names.size();
+    std::vector<Keyed> items(n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        items[i] = {prefix_key(names[i], 0), names[i]};
+    }
+
+    if (threads <= 1 || n < 2 * 4096)
+    {
+        multikey_sort(items.data(), {0, n, 0}, depth_budget(n));
+    }
+    else
+    {
+        // Partition serially until every range is small enough to hand out, then sort the ranges in parallel.
+        const std::size_t grain = std::max<std::size_t>(4096, n / (static_cast<std::size_t>(threads) * 8));
+        std::vector<Range> pending{{0, n, 0}};
+        std::vector<Range> ready;
+        while (!pending.empty())
+        {
+            const Range r = pending.back();
+            pending.pop_back();
+            if (r.end - r.begin <= grain)
+            {
+                if (r.end - r.begin > 1)
+                {
+                    ready.push_back(r);
+                }
+                continue;
+            }
+            std::size_t eq_begin = 0;
+            std::size_t eq_end = 0;
+            const bool descend = partition_step(items.data(), r, eq_begin, eq_end);
+            pending.push_back({r.begin, eq_begin, r.depth});
+            pending.push_back({eq_end, r.end, r.depth});
+            if (descend)
+            {
+                pending.push_back({eq_begin, eq_end, r.depth + 8});
+            }
+        }
+        std::sort(ready.begin(), ready.end(), [](const Range& a, const Range& b) { return a.end - a.begin > b.end - b.begin; });
+        std::vector<std::size_t> order(ready.size());
+        for (std::size_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+        run_work_stealing(order, threads, [&](unsigned, std::size_t i) {
+            const Range& r = ready[i];
+            multikey_sort(items.data(), r, depth_budget(r.end - r.begin));
+        });
+    }
+
+    for (std::size_t i = 0; i < n; i++)
+    {
+        names[i] = items[i].name;
+    }
+}
+
+} // namespace defgen::detail
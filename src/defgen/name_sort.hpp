@@ -0,0 +1,17 @@
+#pragma once
+
+#include "symbol_pool.hpp"
+
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// Sort handles by name in byte-wise lexicographic order (the order `std::sort` gives on `std::string`).
+/// Multikey quicksort over cached 8-byte big-endian prefix keys: long shared prefixes such as `?Foo@Bar@@` are
+/// compared eight bytes per integer compare instead of one `strcmp` per comparison. With `threads > 1` the array is
+/// first split into independent ranges that are sorted on a work-stealing pool.
+/// Names must not contain NUL bytes (true for every name the parsers produce).
+void sort_names(std::vector<SymbolHandle>& names, unsigned threads);
+
+} // namespace defgen::detail
@@ -0,0 +1,262 @@
+#include "object_source.hpp"
+#include "hash.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace defgen::detail
+{
+
+bool ObjectSource::check_range(std::uint64_t offset, std::size_t length, std::string& err) const
+{
+    const std::uint64_t total = size();
+    if (offset > total || length > total - offset)
+    {
+        err = "object file truncated (range outside of file)";
+        return false;
+    }
+    return true;
+}
+
+bool MemoryObjectSource::read(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out, std::string& err)
+{
+    if (!check_range(offset, length, err))
+    {
+        return false;
+    }
+    out = bytes_.subspan(static_cast<std::size_t>(offset), length);
+    bytes_read_ += length;
+    return true;
+}
+
+bool RecordingObjectSource::read(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out, std::string& err)
+{
+    if (!parent_.read(offset, length, out, err))
+    {
+        return false;
+    }
+    // Not merged with neighbours: `hash_ranges` must ask for exactly the ranges fetched, so `Ranged` serves them from memory.
+    if (ranges_.empty() || offset < ranges_.back().offset || offset + length > ranges_.back().offset + ranges_.back().length)
+    {
+        ranges_.push_back({offset, length});
+    }
+    return true;
+}
+
+bool MappedObjectSource::open(const std::filesystem::path& path, std::string& err)
+{
+    if (!file_.open(path, err))
+    {
+        return false;
+    }
+    bytes_ = file_.bytes();
+    return true;
+}
+
+bool RangedObjectSource::find_fetched(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out) const
+{
+    auto it = fetched_.upper_bound(offset);
+    if (it == fetched_.begin())
+    {
+        return false;
+    }
+    --it;
+    if (offset + length > it->first + it->second.size())
+    {
+        return false;
+    }
+    out = it->second.subspan(static_cast<std::size_t>(offset - it->first), length);
+    return true;
+}
+
+#ifdef _WIN32
+
+RangedObjectSource::~RangedObjectSource()
+{
+    if (handle_ != nullptr)
+    {
+        CloseHandle(handle_);
+    }
+}
+
+bool RangedObjectSource::open(const std::filesystem::path& path, std::string& err)
+{
+    const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE | FILE_SHARE_WRITE, nullptr,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        err = "cannot open object file";
+        return false;
+    }
+    LARGE_INTEGER sz{};
+    if (!GetFileSizeEx(file, &sz))
+    {
+        CloseHandle(file);
+        err = "cannot size object file";
+        return false;
+    }
+    handle_ = file;
+    size_ = static_cast<std::uint64_t>(sz.QuadPart);
+    return true;
+}
+
+bool RangedObjectSource::read(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out, std::string& err)
+{
+    if (!check_range(offset, length, err))
+    {
+        return false;
+    }
+    if (find_fetched(offset, length, out))
+    {
+        return true;
+    }
+    auto chunk = std::make_unique<std::uint8_t[]>(length == 0 ? 1 : length);
+    std::size_t done = 0;
+    while (done < length)
+    {
+        const std::uint64_t pos = offset + done;
+        OVERLAPPED ov{};
+        ov.Offset = static_cast<DWORD>(pos & 0xffffffffu);
+        ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+        const std::size_t left = length - done;
+        const DWORD want = left > 0x40000000u ? 0x40000000u : static_cast<DWORD>(left);
+        DWORD got = 0;
+        if (!ReadFile(handle_, chunk.get() + done, want, &got, &ov) || got == 0)
+        {
+            err = "cannot read object file";
+            return false;
+        }
+        done += got;
+    }
+    out = {chunk.get(), length};
+    chunks_.push_back(std::move(chunk));
+    std::span<const std::uint8_t>& known = fetched_[offset];
+    if (known.size() < length)
+    {
+        known = out;
+    }
+    bytes_read_ += length;
+    return true;
+}
+
+#else
+
+RangedObjectSource::~RangedObjectSource()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+    }
+}
+
+bool RangedObjectSource::open(const std::filesystem::path& path, std::string& err)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        err = "cannot open object file";
+        return false;
+    }
+    struct stat st
+    {
+    };
+    if (::fstat(fd, &st) != 0 || st.st_size < 0)
+    {
+        ::close(fd);
+        err = "cannot size object file";
+        return false;
+    }
+    fd_ = fd;
+    size_ = static_cast<std::uint64_t>(st.st_size);
+    return true;
+}
+
+bool RangedObjectSource::read(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out, std::string& err)
+{
+    if (!check_range(offset, length, err))
+    {
+        return false;
+    }
+    if (find_fetched(offset, length, out))
+    {
+        return true;
+    }
+    auto chunk = std::make_unique<std::uint8_t[]>(length == 0 ? 1 : length);
+    std::size_t done = 0;
+    while (done < length)
+    {
+        const ssize_t got = ::pread(fd_, chunk.get() + done, length - done, static_cast<off_t>(offset + done));
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            err = "cannot read object file";
+            return false;
+        }
+        done += static_cast<std::size_t>(got);
+    }
+    out = {chunk.get(), length};
+    chunks_.push_back(std::move(chunk));
+    std::span<const std::uint8_t>& known = fetched_[offset];
+    if (known.size() < length)
+    {
+        known = out;
+    }
+    bytes_read_ += length;
+    return true;
+}
+
+#endif
+
+bool hash_ranges(ObjectSource& source, std::span<const ByteRange> ranges, std::uint64_t& out, std::string& err)
+{
+    Xxh64::State state;
+    for (const ByteRange& range : ranges)
+    {
+        std::span<const std::uint8_t> bytes;
+        if (!source.read(range.offset, static_cast<std::size_t>(range.length), bytes, err))
+        {
+            return false;
+        }
+        state.update(&range, sizeof(range));
+        state.update(bytes.data(), bytes.size());
+    }
+    out = state.digest();
+    return true;
+}
+
+std::unique_ptr<ObjectSource> open_object_source(const std::filesystem::path& path, LoadMode mode, std::string& err)
+{
+    // `Batched` is driven by `batch_read_files`; a single file opened here is simply mapped.
+    if (mode == LoadMode::Ranged)
+    {
+        auto src = std::make_unique<RangedObjectSource>();
+        if (!src->open(path, err))
+        {
+            return nullptr;
+        }
+        return src;
+    }
+    auto src = std::make_unique<MappedObjectSource>();
+    if (!src->open(path, err))
+    {
+        return nullptr;
+    }
+    return src;
+}
+
+} // namespace defgen::detail
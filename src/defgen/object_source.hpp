@@ -0,0 +1,178 @@
+#pragma once
+
+#include "defgen/defgen.hpp"
+#include "mapped_file.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// `[offset, offset + length)` of an object file.
+struct ByteRange
+{
+    std::uint64_t offset;
+    std::uint64_t length;
+};
+
+/// Where the parsers get object bytes from. They only ask for the ranges they need (headers, section table,
+/// symbol and string tables); returned views stay valid for the lifetime of the source.
+class ObjectSource
+{
+  public:
+    virtual ~ObjectSource() = default;
+
+    [[nodiscard]] virtual std::uint64_t size() const = 0;
+
+    /// View of `[offset, offset + length)`. Fails if the range is not inside the file.
+    [[nodiscard]] virtual bool read(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out, std::string& err) = 0;
+
+    /// Bytes handed to the parser so far (for `Ranged`, exactly the bytes fetched from disk).
+    [[nodiscard]] std::uint64_t bytes_read() const { return bytes_read_; }
+
+  protected:
+    [[nodiscard]] bool check_range(std::uint64_t offset, std::size_t length, std::string& err) const;
+
+    std::uint64_t bytes_read_ = 0;
+};
+
+/// Source over bytes that are already in memory (a mapped file or a buffer owned elsewhere).
+class MemoryObjectSource : public ObjectSource
+{
+  public:
+    MemoryObjectSource() = default;
+    explicit MemoryObjectSource(std::span<const std::uint8_t> bytes)
+        : bytes_(bytes)
+    {
+    }
+
+    [[nodiscard]] std::uint64_t size() const override { return bytes_.size(); }
+    [[nodiscard]] bool read(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out, std::string& err) override;
+
+  protected:
+    std::span<const std::uint8_t> bytes_;
+};
+
+/// Owns a whole-file buffer read elsewhere (e.g. by the batched reader); the whole buffer counts as read.
+class BufferObjectSource : public MemoryObjectSource
+{
+  public:
+    BufferObjectSource(std::unique_ptr<std::uint8_t[]> bytes, std::size_t size)
+        : MemoryObjectSource({bytes.get(), size})
+        , owned_(std::move(bytes))
+    {
+        bytes_read_ = size;
+    }
+
+    [[nodiscard]] bool read(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out, std::string& err) override
+    {
+        if (!check_range(offset, length, err))
+        {
+            return false;
+        }
+        out = bytes_.subspan(static_cast<std::size_t>(offset), length);
+        return true;
+    }
+
+  private:
+    std::unique_ptr<std::uint8_t[]> owned_;
+};
+
+/// Window `[offset, offset + size)` of another source, e.g. one archive member. Reads are forwarded (and counted) by the
+/// parent, so a mapped archive is parsed in place without copying.
+class SliceObjectSource : public ObjectSource
+{
+  public:
+    SliceObjectSource(ObjectSource& parent, std::uint64_t offset, std::uint64_t size)
+        : parent_(parent)
+        , offset_(offset)
+        , size_(size)
+    {
+    }
+
+    [[nodiscard]] std::uint64_t size() const override { return size_; }
+
+    [[nodiscard]] bool read(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out, std::string& err) override
+    {
+        return check_range(offset, length, err) && parent_.read(offset_ + offset, length, out, err);
+    }
+
+  private:
+    ObjectSource& parent_;
+    std::uint64_t offset_;
+    std::uint64_t size_;
+};
+
+/// Forwards reads to `parent` and records the ranges asked for (skipping one inside the range before it), so a cache can
+/// later check exactly the bytes the parser saw. Reads are counted by the parent.
+class RecordingObjectSource : public ObjectSource
+{
+  public:
+    RecordingObjectSource(ObjectSource& parent, std::vector<ByteRange>& ranges)
+        : parent_(parent)
+        , ranges_(ranges)
+    {
+    }
+
+    [[nodiscard]] std::uint64_t size() const override { return parent_.size(); }
+    [[nodiscard]] bool read(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out, std::string& err) override;
+
+  private:
+    ObjectSource& parent_;
+    std::vector<ByteRange>& ranges_;
+};
+
+/// Maps the whole file; only pages the parser touches are faulted in.
+class MappedObjectSource : public MemoryObjectSource
+{
+  public:
+    [[nodiscard]] bool open(const std::filesystem::path& path, std::string& err);
+
+  private:
+    MappedFile file_;
+};
+
+/// Positioned reads (`pread` / `ReadFile` with an offset) of just the requested ranges. A range inside one already fetched
+/// is served from memory (and not counted again), so checking a cache entry's ranges before parsing costs no extra I/O.
+class RangedObjectSource : public ObjectSource
+{
+  public:
+    RangedObjectSource() = default;
+    ~RangedObjectSource() override;
+
+    RangedObjectSource(const RangedObjectSource&) = delete;
+    RangedObjectSource& operator=(const RangedObjectSource&) = delete;
+
+    [[nodiscard]] bool open(const std::filesystem::path& path, std::string& err);
+
+    [[nodiscard]] std::uint64_t size() const override { return size_; }
+    [[nodiscard]] bool read(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out, std::string& err) override;
+
+  private:
+    [[nodiscard]] bool find_fetched(std::uint64_t offset, std::size_t length, std::span<const std::uint8_t>& out) const;
+
+    std::vector<std::unique_ptr<std::uint8_t[]>> chunks_;
+    /// Longest chunk fetched at each offset.
+    std::map<std::uint64_t, std::span<const std::uint8_t>> fetched_;
+    std::uint64_t size_ = 0;
+#ifdef _WIN32
+    void* handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+/// XXH64 over `ranges` of `source` (each range's offset and length, then its bytes). False if a range cannot be read.
+[[nodiscard]] bool hash_ranges(ObjectSource& source, std::span<const ByteRange> ranges, std::uint64_t& out, std::string& err);
+
+/// Open `path` with the requested loader. Returns null and sets `err` on failure.
+[[nodiscard]] std::unique_ptr<ObjectSource> open_object_source(const std::filesystem::path& path, LoadMode mode, std::string& err);
+
+} // namespace defgen::detail
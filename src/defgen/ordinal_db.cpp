@@ -0,0 +1,174 @@
+#include "ordinal_db.hpp"
+#include "file_util.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <unordered_set>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+constexpr std::string_view kHeader = "defgen-ordinals 1";
+
+} // namespace
+
+bool OrdinalDatabase::load(const std::filesystem::path& path, std::string& err)
+{
+    text_.clear();
+    ordinals_.clear();
+    added_.clear();
+    last_ = 0;
+    std::ifstream f(path, std::ios::binary);
+    if (!f)
+    {
+        std::error_code ec;
+        if (!std::filesystem::exists(path, ec))
+        {
+            return true;
+        }
+        err = "cannot read ordinal database " + path_key(path);
+        return false;
+    }
+    text_.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+
+    std::string_view rest = text_;
+    std::size_t line_no = 0;
+    while (!rest.empty())
+    {
+        const std::size_t eol = rest.find('\n');
+        std::string_view line = rest.substr(0, eol);
+        rest = eol == std::string_view::npos ? std::string_view{} : rest.substr(eol + 1);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        if (line_no++ == 0)
+        {
+            if (line != kHeader)
+            {
+                err = path_key(path) + ": not an ordinal database";
+                return false;
+            }
+            continue;
+        }
+        if (line.empty())
+        {
+            continue;
+        }
+        // Ordinals are written in increasing order; anything else (or a repeated name) is a damaged or hand-broken file.
+        std::uint32_t ordinal = 0;
+        const auto r = std::from_chars(line.data(), line.data() + line.size(), ordinal);
+        if (r.ec != std::errc() || r.ptr == line.data() + line.size() || *r.ptr != ' ' || ordinal <= last_ || ordinal > kMaxOrdinal ||
+            !ordinals_.emplace(line.substr(static_cast<std::size_t>(r.ptr - line.data()) + 1), static_cast<std::uint16_t>(ordinal)).second)
+        {
+            err = path_key(path) + ": invalid entry on line " + std::to_string(line_no);
+            return false;
+        }
+        last_ = ordinal;
+    }
+    return true;
+}
+
+bool OrdinalDatabase::assign(const std::vector<std::string_view>& names, std::vector<std::uint16_t>& out, std::string& err)
+{
+    out.assign(names.size(), 0);
+    std::vector<std::size_t> fresh;
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        const auto it = ordinals_.find(names[i]);
+        if (it != ordinals_.end())
+        {
+            out[i] = it->second;
+        }
+        else
+        {
+            fresh.push_back(i);
+        }
+    }
+    if (fresh.size() > kMaxOrdinal - last_)
+    {
+        const std::size_t retired = ordinals_.size() - (names.size() - fresh.size());
+        err = std::to_string(fresh.size()) + " new export(s) do not fit below ordinal " + std::to_string(kMaxOrdinal) + " (" +
+              std::to_string(last_) + " in use)";
+        if (retired != 0)
+        {
+            err += "; " + std::to_string(retired) +
+                   " are reserved by exports that no longer exist, delete the ordinal database to renumber";
+        }
+        out.clear();
+        return false;
+    }
+    added_.clear();
+    added_.reserve(fresh.size());
+    for (const std::size_t i : fresh)
+    {
+        out[i] = static_cast<std::uint16_t>(++last_);
+        added_.push_back(names[i]);
+    }
+    return true;
+}
+
+bool OrdinalDatabase::save(const std::filesystem::path& path, std::string& err) const
+{
+    std::string text;
+    text.reserve(text_.size() + added_.size() * 64 + kHeader.size() + 1);
+    if (text_.empty())
+    {
+        text += kHeader;
+        text += '\n';
+    }
+    else
+    {
+        text += text_;
+        if (text.back() != '\n')
+        {
+            text += '\n';
+        }
+    }
+    std::uint32_t ordinal = last_ - static_cast<std::uint32_t>(added_.size());
+    for (const std::string_view name : added_)
+    {
+        text += std::to_string(++ordinal);
+        text += ' ';
+        text += name;
+        text += '\n';
+    }
+    return write_file_atomic(path, text.data(), text.size(), err);
+}
+
+bool assign_export_ordinals(const std::vector<std::string_view>& names, const GenerateOptions& options, std::vector<ExportOrdinal>& out,
+                            std::size_t& added, std::string& err)
+{
+    out.clear();
+    added = 0;
+    if (options.ordinal_database.empty() || options.elf_style_export_block)
+    {
+        return true;
+    }
+    OrdinalDatabase db;
+    std::vector<std::uint16_t> ordinals;
+    if (!db.load(options.ordinal_database, err) || !db.assign(names, ordinals, err))
+    {
+        return false;
+    }
+    if (db.added() != 0 && !db.save(options.ordinal_database, err))
+    {
+        return false;
+    }
+    added = db.added();
+
+    const std::unordered_set<std::string_view> named(options.named_exports.begin(), options.named_exports.end());
+    out.resize(names.size());
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        out[i].ordinal = ordinals[i];
+        out[i].named = !named.empty() && named.contains(names[i]);
+    }
+    return true;
+}
+
+} // namespace defgen::detail
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "defgen/defgen.hpp"
+#include "export_lines.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// Name -> ordinal map behind `GenerateOptions::ordinal_database`. Text, one `<ordinal> <name>` line per export ever
+/// assigned, in ordinal order, so it can be reviewed and kept under version control. Entries are never removed:
+/// an export that disappears keeps its ordinal reserved, and an importer built against an older DLL can never bind to a
+/// different function.
+class OrdinalDatabase
+{
+  public:
+    /// PE ordinals are 16-bit; 0 is not a valid ordinal.
+    static constexpr std::uint32_t kMaxOrdinal = 0xFFFF;
+
+    /// Read `path`. A missing file is an empty database; a malformed one fails.
+    [[nodiscard]] bool load(const std::filesystem::path& path, std::string& err);
+
+    /// Ordinal of every name in `names` (sorted, unique), in order. Names without one get the next ordinals after the
+    /// highest ever assigned, in name order. False if the 16-bit ordinal space is exhausted; nothing is assigned then.
+    [[nodiscard]] bool assign(const std::vector<std::string_view>& names, std::vector<std::uint16_t>& out, std::string& err);
+
+    /// Names `assign` added since `load`.
+    [[nodiscard]] std::size_t added() const { return added_.size(); }
+
+    /// Rewrite `path` (temporary file + rename) with the loaded entries plus the added ones.
+    [[nodiscard]] bool save(const std::filesystem::path& path, std::string& err) const;
+
+  private:
+    std::string text_;
+    std::unordered_map<std::string_view, std::uint16_t> ordinals_;
+    std::uint32_t last_ = 0;
+    /// Added names in ordinal order (views into the names last passed to `assign`).
+    std::vector<std::string_view> added_;
+};
+
+/// Ordinal mode for `names` (sorted, filtered) when `options.ordinal_database` is set and the output is a `.def`:
+/// fills `out` (empty otherwise), marks `options.named_exports`, and saves the database if names were added
+/// (`added` = how many). Shared by `generate_def` and the daemon.
+[[nodiscard]] bool assign_export_ordinals(const std::vector<std::string_view>& names, const GenerateOptions& options,
+                                          std::vector<ExportOrdinal>& out, std::size_t& added, std::string& err);
+
+} // namespace defgen::detail
@@ -0,0 +1,56 @@
+#include "parsers.hpp"
+#include "ar_archive.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+[[nodiscard]] std::string lower_extension(const std::filesystem::path& path)
+{
+    const auto ext = path.extension().string();
+    std::string lower;
+    lower.resize(ext.size());
+    std::transform(ext.begin(), ext.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return lower;
+}
+
+} // namespace
+
+ObjectFormat resolve_object_format(const std::filesystem::path& path, ObjectFormat format)
+{
+    if (format != ObjectFormat::Auto)
+    {
+        return format;
+    }
+    const std::string ext = lower_extension(path);
+    if (ext == ".o" || ext == ".a")
+    {
+        return ObjectFormat::Elf;
+    }
+    return ObjectFormat::Coff;
+}
+
+int parse_object(const std::filesystem::path& path, ObjectFormat format, ObjectSource& source, SymbolCollector& out, std::string& err)
+{
+    if (format == ObjectFormat::Coff)
+    {
+        // Only `.lib` inputs are probed, so plain objects do not pay for an extra read of the signature.
+        if (lower_extension(path) == ".lib" && ar::is_archive(source))
+        {
+            return process_coff_archive(source, path.filename().string(), out, err);
+        }
+        return process_coff_object(source, path.filename().string(), out, err);
+    }
+    if (lower_extension(path) == ".a" && (ar::is_archive(source) || ar::is_thin_archive(source)))
+    {
+        return process_elf_archive(path, source, out, err);
+    }
+    return process_elf_object(source, out, err);
+}
+
+} // namespace defgen::detail
@@ -1,14 +1,32 @@
 #pragma once
 
+#include "object_source.hpp"
+#include "symbol_pool.hpp"
+
 #include <filesystem>
 #include <string>
-#include <vector>
+#include <string_view>
 
 namespace defgen::detail {
 
-[[nodiscard]] int process_coff_object(const std::filesystem::path& path, std::vector<std::string>& export_funcs,
-                                      std::vector<std::string>& export_data, std::string& err);
+[[nodiscard]] int process_coff_object(ObjectSource& source, std::string_view label, SymbolCollector& out, std::string& err);
+
+/// MSVC static library (`!<arch>` with linker members): members that define symbols are parsed in place with
+/// `process_coff_object`; short import members are skipped.
+[[nodiscard]] int process_coff_archive(ObjectSource& source, std::string_view label, SymbolCollector& out, std::string& err);
+
+[[nodiscard]] int process_elf_object(ObjectSource& source, SymbolCollector& out, std::string& err);
+
+/// GNU/SysV `ar` archive (`!<arch>`) or thin archive (`!<thin>`) of ELF objects: members listed in the symbol index are
+/// parsed in place with `process_elf_object`; thin members are read from their files, relative to `path`'s directory.
+[[nodiscard]] int process_elf_archive(const std::filesystem::path& path, ObjectSource& source, SymbolCollector& out, std::string& err);
+
+/// `format` unless it is `Auto`; then by extension: `.o` and `.a` -> ELF, otherwise COFF.
+[[nodiscard]] ObjectFormat resolve_object_format(const std::filesystem::path& path, ObjectFormat format);
 
-[[nodiscard]] int process_elf_object(const std::filesystem::path& path, std::vector<std::string>& export_funcs, std::string& err);
+/// Run the parser for `format` (already resolved) over `source`. Files named `.lib` (COFF) or `.a` (ELF) that start
+/// with an archive signature are read as static libraries.
+[[nodiscard]] int parse_object(const std::filesystem::path& path, ObjectFormat format, ObjectSource& source, SymbolCollector& out,
+                               std::string& err);
 
 } // namespace defgen::detail
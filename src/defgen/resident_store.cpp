@@ -0,0 +1,57 @@
+#include "resident_store.hpp"
+
+#include <utility>
+
+namespace defgen::detail
+{
+
+std::uint64_t ResidentObject::bytes() const
+{
+    // Payload plus a rough allowance for the map node, key and LRU node.
+    return text.capacity() + names.capacity() * sizeof(Name) + sizeof(ResidentObject) + 128;
+}
+
+const ResidentObject* ResidentStore::find(const std::string& key, const FileIdentity& identity)
+{
+    const auto it = entries_.find(key);
+    if (it == entries_.end() || !(it->second.object.identity == identity))
+    {
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    return &it->second.object;
+}
+
+const ResidentObject& ResidentStore::insert(const std::string& key, ResidentObject object)
+{
+    object.generation = ++generation_;
+    auto [it, inserted] = entries_.try_emplace(key);
+    Slot& slot = it->second;
+    if (inserted)
+    {
+        lru_.push_front(&it->first);
+        slot.lru = lru_.begin();
+    }
+    else
+    {
+        bytes_ -= slot.object.bytes();
+        lru_.splice(lru_.begin(), lru_, slot.lru);
+    }
+    slot.object = std::move(object);
+    bytes_ += slot.object.bytes();
+    return slot.object;
+}
+
+void ResidentStore::trim()
+{
+    while (bytes_ > budget_ && !lru_.empty())
+    {
+        const auto it = entries_.find(*lru_.back());
+        bytes_ -= it->second.object.bytes();
+        lru_.pop_back();
+        entries_.erase(it);
+        ++evictions_;
+    }
+}
+
+} // namespace defgen::detail
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "file_util.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// Function names one object contributed, packed into a single buffer with their precomputed hashes so a resident
+/// object is interned into a request's pool without rehashing.
+struct ResidentObject
+{
+    struct Name
+    {
+        std::uint64_t hash;
+        std::uint32_t offset;
+        std::uint32_t size;
+    };
+
+    FileIdentity identity;
+    /// Value of `ResidentStore::generation()` when the object was parsed; a result built at generation G is still valid
+    /// for a set of objects that are all resident with generations <= G.
+    std::uint64_t generation = 0;
+    std::string text;
+    std::vector<Name> names;
+
+    [[nodiscard]] std::string_view name(const Name& n) const { return {text.data() + n.offset, n.size}; }
+    [[nodiscard]] std::uint64_t bytes() const;
+};
+
+/// In-memory objects keyed by format and absolute path, with least-recently-used eviction once the total size
+/// exceeds the budget. References returned by `find` / `insert` stay valid until the next `trim`.
+class ResidentStore
+{
+  public:
+    explicit ResidentStore(std::uint64_t budget)
+        : budget_(budget)
+    {
+    }
+
+    /// The entry for `key` if it was parsed from a file with the same `identity`; marks it most recently used.
+    [[nodiscard]] const ResidentObject* find(const std::string& key, const FileIdentity& identity);
+    /// Add or replace the entry for `key`, stamping it with a new generation.
+    const ResidentObject& insert(const std::string& key, ResidentObject object);
+    /// Evict least recently used entries until the total is within the budget.
+    void trim();
+
+    [[nodiscard]] std::uint64_t generation() const { return generation_; }
+    [[nodiscard]] std::size_t size() const { return entries_.size(); }
+    [[nodiscard]] std::uint64_t bytes() const { return bytes_; }
+    [[nodiscard]] std::uint64_t budget() const { return budget_; }
+    [[nodiscard]] std::size_t evictions() const { return evictions_; }
+
+  private:
+    struct Slot
+    {
+        ResidentObject object;
+        std::list<const std::string*>::iterator lru;
+    };
+
+    std::uint64_t budget_;
+    std::uint64_t bytes_ = 0;
+    std::uint64_t generation_ = 0;
+    std::size_t evictions_ = 0;
+    std::unordered_map<std::string, Slot> entries_;
+    /// Most recently used at the front; points at the map's keys.
+    std::list<const std::string*> lru_;
+};
+
+} // namespace defgen::detail
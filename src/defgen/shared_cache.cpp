@@ -0,0 +1,328 @@
+#include "shared_cache.hpp"
+#include "file_util.hpp"
+#include "object_source.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <system_error>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+constexpr char kMagic[8] = {'D', 'G', 'S', 'Y', 'M', 'C', 'A', 'S'};
+/// Bump whenever the file layout or what the parsers emit for an object changes.
+constexpr std::uint32_t kVersion = 2;
+constexpr unsigned kSubdirs = 256;
+/// Object bytes at each end that name its entry: the COFF header and first section header or the ELF64 header, and the
+/// end of the string table (COFF) or section table (ELF).
+constexpr std::size_t kEndSize = 64;
+/// A hit refreshes an entry's mtime (its LRU age) at most this often, to keep metadata writes to the share rare.
+constexpr auto kTouchInterval = std::chrono::hours(1);
+/// Temporary files this old were left behind by a writer that died before its rename.
+constexpr auto kStaleTempAge = std::chrono::hours(1);
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t format;
+    std::uint64_t object_size;
+    std::uint64_t ends_hash;
+    std::uint64_t tables_hash;
+    /// `ByteRange`s right after the header; the symbols follow them.
+    std::uint64_t range_count;
+    std::uint64_t file_size;
+};
+
+/// Followed by `size` name bytes, padded to 8.
+struct SymbolRecord
+{
+    std::uint64_t hash;
+    std::uint32_t size;
+    std::uint32_t kind;
+};
+
+static_assert(sizeof(Header) == 56);
+static_assert(sizeof(ByteRange) == 16);
+static_assert(sizeof(SymbolRecord) == 16);
+
+[[nodiscard]] std::size_t padded(std::size_t n) { return (n + 7) & ~std::size_t{7}; }
+
+void append(std::vector<std::uint8_t>& buf, const void* data, std::size_t size)
+{
+    const auto* p = static_cast<const std::uint8_t*>(data);
+    buf.insert(buf.end(), p, p + size);
+    buf.resize(padded(buf.size()), 0);
+}
+
+[[nodiscard]] bool hash_ends(ObjectSource& object, std::uint64_t& out)
+{
+    std::string err;
+    const std::size_t length = static_cast<std::size_t>(std::min<std::uint64_t>(object.size(), kEndSize));
+    std::span<const std::uint8_t> head;
+    std::span<const std::uint8_t> tail;
+    if (!object.read(0, length, head, err) || !object.read(object.size() - length, length, tail, err))
+    {
+        return false;
+    }
+    Xxh64::State state;
+    state.update(head.data(), head.size());
+    state.update(tail.data(), tail.size());
+    out = state.digest();
+    return true;
+}
+
+[[nodiscard]] std::filesystem::path subdir_path(const std::filesystem::path& dir, unsigned index)
+{
+    char name[3];
+    std::snprintf(name, sizeof(name), "%02x", index);
+    return dir / name;
+}
+
+/// Drop dead temporaries, then the oldest entries while `sub` holds more than `budget` bytes (0 = no limit); trimming
+/// goes 10% below the budget so that a full store is not rescanned on every write. Adds what remains to `out`.
+void trim_subdir(const std::filesystem::path& sub, std::uint64_t budget, SharedCacheStats& out)
+{
+    struct Item
+    {
+        std::filesystem::file_time_type mtime;
+        std::uint64_t size;
+        std::filesystem::path path;
+    };
+    std::vector<Item> items;
+    std::uint64_t total = 0;
+    const auto now = std::filesystem::file_time_type::clock::now();
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(sub, ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+    {
+        std::error_code item_ec;
+        if (!it->is_regular_file(item_ec))
+        {
+            continue;
+        }
+        Item item{it->last_write_time(item_ec), it->file_size(item_ec), it->path()};
+        if (item_ec)
+        {
+            continue;
+        }
+        if (item.path.extension() == ".tmp")
+        {
+            if (now - item.mtime > kStaleTempAge)
+            {
+                std::filesystem::remove(item.path, item_ec);
+            }
+            continue;
+        }
+        total += item.size;
+        items.push_back(std::move(item));
+    }
+    if (budget != 0 && total > budget)
+    {
+        std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.mtime < b.mtime; });
+        const std::uint64_t target = budget - budget / 10;
+        std::size_t removed = 0;
+        while (removed < items.size() && total > target)
+        {
+            std::error_code rm_ec;
+            // Another machine may have evicted it already; either way it is gone.
+            std::filesystem::remove(items[removed].path, rm_ec);
+            total -= items[removed].size;
+            out.evicted_bytes += items[removed].size;
+            ++out.evicted;
+            ++removed;
+        }
+        items.erase(items.begin(), items.begin() + static_cast<std::ptrdiff_t>(removed));
+    }
+    out.entries += items.size();
+    out.bytes += total;
+}
+
+} // namespace
+
+SharedSymbolCache::SharedSymbolCache(std::filesystem::path dir, std::uint64_t max_bytes)
+    : dir_(std::move(dir))
+    , max_bytes_(max_bytes)
+{
+}
+
+std::filesystem::path SharedSymbolCache::entry_path(ObjectFormat format, std::uint64_t size, std::uint64_t ends_hash) const
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx-%llx.%s", static_cast<unsigned long long>(ends_hash), static_cast<unsigned long long>(size),
+                  format == ObjectFormat::Elf ? "elf" : "coff");
+    return subdir_path(dir_, static_cast<unsigned>(ends_hash >> 56)) / name;
+}
+
+bool SharedSymbolCache::replay(ObjectFormat format, ObjectSource& object, std::vector<ByteRange>& ranges, std::uint64_t& tables_hash,
+                               SymbolCollector& out)
+{
+    std::uint64_t ends_hash = 0;
+    if (!hash_ends(object, ends_hash))
+    {
+        return false;
+    }
+    const std::uint64_t size = object.size();
+    const std::filesystem::path path = entry_path(format, size, ends_hash);
+    std::vector<std::uint8_t> bytes;
+    {
+        std::string err;
+        const std::unique_ptr<ObjectSource> file = open_object_source(path, LoadMode::Ranged, err);
+        std::span<const std::uint8_t> content;
+        if (!file || !file->read(0, static_cast<std::size_t>(file->size()), content, err))
+        {
+            return false;
+        }
+        bytes.assign(content.begin(), content.end());
+    }
+    Header header{};
+    if (bytes.size() < sizeof(Header))
+    {
+        return false;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.format != static_cast<std::uint32_t>(format) || header.object_size != size || header.ends_hash != ends_hash ||
+        header.file_size != bytes.size() || header.range_count > (bytes.size() - sizeof(Header)) / sizeof(ByteRange))
+    {
+        return false;
+    }
+    // Several objects can share both ends; only the one whose fetched ranges still hash the same is this entry's object.
+    std::vector<ByteRange> entry_ranges(static_cast<std::size_t>(header.range_count));
+    if (!entry_ranges.empty())
+    {
+        std::memcpy(entry_ranges.data(), bytes.data() + sizeof(Header), entry_ranges.size() * sizeof(ByteRange));
+    }
+    std::uint64_t object_hash = 0;
+    std::string err;
+    if (!hash_ranges(object, entry_ranges, object_hash, err) || object_hash != header.tables_hash)
+    {
+        return false;
+    }
+    // Validate the whole entry before adding anything, so a damaged file cannot leave a partial symbol set behind.
+    std::vector<std::pair<SymbolRecord, std::string_view>> symbols;
+    for (std::size_t at = sizeof(Header) + entry_ranges.size() * sizeof(ByteRange); at < bytes.size();)
+    {
+        SymbolRecord rec{};
+        if (bytes.size() - at < sizeof(rec))
+        {
+            return false;
+        }
+        std::memcpy(&rec, bytes.data() + at, sizeof(rec));
+        at += sizeof(rec);
+        if (rec.size > bytes.size() - at || (rec.kind != SymbolFunction && rec.kind != SymbolData))
+        {
+            return false;
+        }
+        const std::string_view name(reinterpret_cast<const char*>(bytes.data() + at), rec.size);
+        // Other writers share the directory: a stored hash that does not match its name would put the name in the wrong
+        // pool shard and export it twice.
+        if (Xxh64::hash(name) != rec.hash)
+        {
+            return false;
+        }
+        symbols.emplace_back(rec, name);
+        at = std::min(bytes.size(), at + padded(rec.size));
+    }
+    for (const auto& [rec, name] : symbols)
+    {
+        out.add(name, rec.hash, static_cast<SymbolKind>(rec.kind));
+    }
+    ranges = std::move(entry_ranges);
+    tables_hash = header.tables_hash;
+
+    std::error_code ec;
+    const auto now = std::filesystem::file_time_type::clock::now();
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (!ec && now - mtime > kTouchInterval)
+    {
+        std::filesystem::last_write_time(path, now, ec);
+    }
+    return true;
+}
+
+void SharedSymbolCache::store(ObjectFormat format, ObjectSource& object, const std::vector<ByteRange>& ranges, std::uint64_t tables_hash,
+                              const std::vector<TracedSymbol>& symbols)
+{
+    std::uint64_t ends_hash = 0;
+    if (!hash_ends(object, ends_hash))
+    {
+        return;
+    }
+    std::vector<std::uint8_t> buf(sizeof(Header), 0);
+    if (!ranges.empty())
+    {
+        append(buf, ranges.data(), ranges.size() * sizeof(ByteRange));
+    }
+    for (const TracedSymbol& s : symbols)
+    {
+        const SymbolRecord rec{s.name->hash, s.name->size, s.kind};
+        append(buf, &rec, sizeof(rec));
+        append(buf, s.name->c_str(), s.name->size);
+    }
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.format = static_cast<std::uint32_t>(format);
+    header.object_size = object.size();
+    header.ends_hash = ends_hash;
+    header.tables_hash = tables_hash;
+    header.range_count = ranges.size();
+    header.file_size = buf.size();
+    std::memcpy(buf.data(), &header, sizeof(header));
+
+    const unsigned index = static_cast<unsigned>(ends_hash >> 56);
+    std::error_code ec;
+    std::filesystem::create_directories(subdir_path(dir_, index), ec);
+    std::string err;
+    if (!write_file_atomic(entry_path(format, object.size(), ends_hash), buf.data(), buf.size(), err))
+    {
+        return;
+    }
+    ++writes_;
+    const std::lock_guard<std::mutex> guard(lock_);
+    written_dirs_.insert(index);
+}
+
+std::size_t SharedSymbolCache::trim()
+{
+    if (max_bytes_ == 0)
+    {
+        return 0;
+    }
+    SharedCacheStats stats;
+    for (const unsigned index : written_dirs_)
+    {
+        trim_subdir(subdir_path(dir_, index), max_bytes_ / kSubdirs, stats);
+    }
+    written_dirs_.clear();
+    return stats.evicted;
+}
+
+} // namespace defgen::detail
+
+namespace defgen
+{
+
+bool trim_shared_symbol_cache(const std::filesystem::path& dir, std::uint64_t max_bytes, SharedCacheStats& out, std::string& err)
+{
+    out = {};
+    std::error_code ec;
+    if (!std::filesystem::is_directory(dir, ec))
+    {
+        err = "not a directory: " + detail::path_key(dir);
+        return false;
+    }
+    for (unsigned index = 0; index < detail::kSubdirs; index++)
+    {
+        detail::trim_subdir(detail::subdir_path(dir, index), max_bytes / detail::kSubdirs, out);
+    }
+    return true;
+}
+
+} // namespace defgen
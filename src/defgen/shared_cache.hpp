@@ -0,0 +1,55 @@
+#pragma once
+
+#include "defgen/defgen.hpp"
+#include "object_source.hpp"
+#include "symbol_pool.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// Content-addressed symbol store in a plain (possibly shared, network-mounted) directory. One file per object:
+/// `<dir>/<hh>/<xxh64 of its first and last 64 bytes>-<size>.<coff|elf>`, holding the ranges its parse fetched, their
+/// `hash_ranges` and the object's symbols with their name hashes. A lookup hits only if those ranges still hash the same,
+/// so it reads no more of the object than a parse would. Entries are replaced only by rename, so any number of processes
+/// on any number of machines can read and write the directory without locks; a reader sees either no entry or a complete
+/// one. Safe to call from parser threads.
+class SharedSymbolCache
+{
+  public:
+    /// `max_bytes` (0 = unbounded) is enforced per subdirectory (`max_bytes / 256` each) by `trim`.
+    SharedSymbolCache(std::filesystem::path dir, std::uint64_t max_bytes);
+
+    /// Replay the entry for `object` into `out` (and `out.trace`, when set), and return the ranges it covers and their hash.
+    /// False on a miss, a changed object or a damaged entry, including one whose stored name hashes do not match the names.
+    [[nodiscard]] bool replay(ObjectFormat format, ObjectSource& object, std::vector<ByteRange>& ranges, std::uint64_t& tables_hash,
+                              SymbolCollector& out);
+
+    /// Publish the symbols of a parsed object and the ranges its parse fetched. Failures (read-only share, full disk) are
+    /// ignored: the cache is optional.
+    void store(ObjectFormat format, ObjectSource& object, const std::vector<ByteRange>& ranges, std::uint64_t tables_hash,
+               const std::vector<TracedSymbol>& symbols);
+
+    /// Evict least recently used entries from the subdirectories this instance wrote to, down to their share of
+    /// `max_bytes`. Returns the number of entries removed.
+    std::size_t trim();
+
+    [[nodiscard]] std::size_t writes() const { return writes_.load(); }
+
+  private:
+    [[nodiscard]] std::filesystem::path entry_path(ObjectFormat format, std::uint64_t size, std::uint64_t ends_hash) const;
+
+    std::filesystem::path dir_;
+    std::uint64_t max_bytes_;
+    std::atomic<std::size_t> writes_{0};
+    std::mutex lock_;
+    std::set<unsigned> written_dirs_;
+};
+
+} // namespace defgen::detail
@@ -0,0 +1,184 @@
+#include "symbol_cache.hpp"
+
+#include <cstring>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+constexpr char kMagic[8] = {'D', 'G', 'S', 'Y', 'M', 'C', 'A', 'C'};
+/// Bump whenever the file layout or what the parsers emit for an object changes.
+constexpr std::uint32_t kVersion = 2;
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t entry_count;
+    std::uint64_t file_size;
+};
+
+/// Followed by `size` name bytes, padded to 8.
+struct SymbolRecord
+{
+    std::uint64_t hash;
+    std::uint32_t size;
+    std::uint32_t kind;
+};
+
+static_assert(sizeof(Header) == 24);
+static_assert(sizeof(SymbolCache::Entry) == 72);
+static_assert(sizeof(ByteRange) == 16);
+static_assert(sizeof(SymbolRecord) == 16);
+
+[[nodiscard]] std::size_t padded(std::size_t n) { return (n + 7) & ~std::size_t{7}; }
+
+void append(std::vector<std::uint8_t>& buf, const void* data, std::size_t size)
+{
+    const auto* p = static_cast<const std::uint8_t*>(data);
+    buf.insert(buf.end(), p, p + size);
+    buf.resize(padded(buf.size()), 0);
+}
+
+} // namespace
+
+void SymbolCache::open(const std::filesystem::path& path)
+{
+    close();
+    std::string err;
+    if (!file_.open(path, err))
+    {
+        return;
+    }
+    const std::span<const std::uint8_t> bytes = file_.bytes();
+    Header header{};
+    if (bytes.size() < sizeof(Header))
+    {
+        close();
+        return;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(Header));
+    const std::size_t table_end = sizeof(Header) + static_cast<std::size_t>(header.entry_count) * sizeof(Entry);
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.file_size != bytes.size() ||
+        table_end > bytes.size())
+    {
+        close();
+        return;
+    }
+    const auto* entries = reinterpret_cast<const Entry*>(bytes.data() + sizeof(Header));
+    entries_.reserve(header.entry_count);
+    for (std::uint32_t i = 0; i < header.entry_count; i++)
+    {
+        const Entry& e = entries[i];
+        if (e.key_offset > bytes.size() || e.key_size > bytes.size() - e.key_offset || e.symbols_offset > bytes.size() ||
+            e.symbols_size > bytes.size() - e.symbols_offset || e.symbols_offset % 8 != 0 || e.ranges_offset > bytes.size() ||
+            e.ranges_count > (bytes.size() - e.ranges_offset) / sizeof(ByteRange) || e.ranges_offset % 8 != 0)
+        {
+            close();
+            return;
+        }
+        entries_.emplace(std::string_view(reinterpret_cast<const char*>(bytes.data() + e.key_offset), e.key_size), &e);
+    }
+}
+
+void SymbolCache::close()
+{
+    entries_.clear();
+    file_.close();
+}
+
+const SymbolCache::Entry* SymbolCache::find(std::string_view key, ObjectFormat format) const
+{
+    const auto it = entries_.find(key);
+    if (it == entries_.end() || it->second->format != static_cast<std::uint32_t>(format))
+    {
+        return nullptr;
+    }
+    return it->second;
+}
+
+std::span<const ByteRange> SymbolCache::ranges(const Entry& entry) const
+{
+    return {reinterpret_cast<const ByteRange*>(file_.bytes().data() + entry.ranges_offset), static_cast<std::size_t>(entry.ranges_count)};
+}
+
+void SymbolCache::replay(const Entry& entry, SymbolCollector& out) const
+{
+    const std::uint8_t* p = file_.bytes().data() + entry.symbols_offset;
+    const std::uint8_t* const end = p + entry.symbols_size;
+    while (static_cast<std::size_t>(end - p) >= sizeof(SymbolRecord))
+    {
+        SymbolRecord rec{};
+        std::memcpy(&rec, p, sizeof(rec));
+        p += sizeof(rec);
+        if (rec.size > static_cast<std::size_t>(end - p))
+        {
+            return;
+        }
+        out.add(std::string_view(reinterpret_cast<const char*>(p), rec.size), rec.hash, static_cast<SymbolKind>(rec.kind));
+        p += padded(rec.size);
+    }
+}
+
+bool SymbolCache::write(const std::filesystem::path& path, const std::vector<std::string>& keys, const std::vector<SymbolCacheRecord>& records,
+                        std::string& err)
+{
+    std::uint32_t count = 0;
+    for (const SymbolCacheRecord& r : records)
+    {
+        count += r.valid ? 1 : 0;
+    }
+
+    // Header and entry table first; keys and symbol blocks are appended behind them and patched into the entries.
+    std::vector<std::uint8_t> buf(sizeof(Header) + static_cast<std::size_t>(count) * sizeof(Entry), 0);
+    std::vector<Entry> entries;
+    entries.reserve(count);
+    for (std::size_t i = 0; i < records.size(); i++)
+    {
+        const SymbolCacheRecord& r = records[i];
+        if (!r.valid)
+        {
+            continue;
+        }
+        Entry e{};
+        e.key_offset = buf.size();
+        e.key_size = static_cast<std::uint32_t>(keys[i].size());
+        append(buf, keys[i].data(), keys[i].size());
+        e.format = static_cast<std::uint32_t>(r.format);
+        e.size = r.identity.size;
+        e.mtime = r.identity.mtime;
+        e.tables_hash = r.tables_hash;
+        e.ranges_offset = buf.size();
+        e.ranges_count = r.ranges.size();
+        if (!r.ranges.empty())
+        {
+            append(buf, r.ranges.data(), r.ranges.size() * sizeof(ByteRange));
+        }
+        e.symbols_offset = buf.size();
+        for (const TracedSymbol& s : r.symbols)
+        {
+            const SymbolRecord rec{s.name->hash, s.name->size, s.kind};
+            append(buf, &rec, sizeof(rec));
+            append(buf, s.name->c_str(), s.name->size);
+        }
+        e.symbols_size = buf.size() - e.symbols_offset;
+        entries.push_back(e);
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.entry_count = count;
+    header.file_size = buf.size();
+    std::memcpy(buf.data(), &header, sizeof(header));
+    if (!entries.empty())
+    {
+        std::memcpy(buf.data() + sizeof(Header), entries.data(), entries.size() * sizeof(Entry));
+    }
+
+    return write_file_atomic(path, buf.data(), buf.size(), err);
+}
+
+} // namespace defgen::detail
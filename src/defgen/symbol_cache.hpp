@@ -0,0 +1,78 @@
+#pragma once
+
+#include "defgen/defgen.hpp"
+#include "file_util.hpp"
+#include "mapped_file.hpp"
+#include "object_source.hpp"
+#include "symbol_pool.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// What the cache needs to write an entry back: the object's identity, the ranges its parse fetched and their hash, and
+/// every symbol it contributed.
+struct SymbolCacheRecord
+{
+    /// False when the object could not be stat'ed; such objects are not cached.
+    bool valid = false;
+    ObjectFormat format = ObjectFormat::Coff;
+    FileIdentity identity;
+    std::vector<ByteRange> ranges;
+    std::uint64_t tables_hash = 0;
+    std::vector<TracedSymbol> symbols;
+};
+
+/// On-disk per-object symbol cache. One file, mapped read-only: a header, a fixed-size entry per object (key, format,
+/// size, mtime, the byte ranges the parser fetched and their `hash_ranges`) and each object's symbols with their
+/// precomputed name hashes, so a hit is replayed into the pool without rehashing. Native byte order; any header or bounds
+/// mismatch makes the whole file a miss.
+class SymbolCache
+{
+  public:
+    struct Entry
+    {
+        std::uint64_t key_offset;
+        std::uint32_t key_size;
+        std::uint32_t format;
+        std::uint64_t size;
+        std::int64_t mtime;
+        std::uint64_t tables_hash;
+        std::uint64_t ranges_offset;
+        std::uint64_t ranges_count;
+        std::uint64_t symbols_offset;
+        std::uint64_t symbols_size;
+    };
+
+    /// Map `path`. A missing, unreadable or invalid file leaves the cache empty (every lookup misses).
+    void open(const std::filesystem::path& path);
+    /// Unmap the file (required on Windows before it can be replaced).
+    void close();
+
+    [[nodiscard]] std::size_t size() const { return entries_.size(); }
+
+    [[nodiscard]] const Entry* find(std::string_view key, ObjectFormat format) const;
+
+    /// Ranges of the object that `entry.tables_hash` covers.
+    [[nodiscard]] std::span<const ByteRange> ranges(const Entry& entry) const;
+
+    /// Add every symbol of `entry` to `out` (and to `out.trace`, when set).
+    void replay(const Entry& entry, SymbolCollector& out) const;
+
+    /// Write `records` (one entry per valid record; `keys` parallel to it) to a temporary file and rename it over `path`.
+    [[nodiscard]] static bool write(const std::filesystem::path& path, const std::vector<std::string>& keys,
+                                    const std::vector<SymbolCacheRecord>& records, std::string& err);
+
+  private:
+    MappedFile file_;
+    std::unordered_map<std::string_view, const Entry*> entries_;
+};
+
+} // namespace defgen::detail
@@ -0,0 +1,105 @@
+#include "symbol_pool.hpp"
+
+#include <cstring>
+
+namespace defgen::detail
+{
+
+InternedName* SymbolPool::Shard::allocate(std::string_view name, std::uint64_t hash)
+{
+    // Header + characters + NUL, rounded up to whole 8-byte words so every entry stays aligned.
+    const std::size_t words = entry_bytes(name.size()) / 8;
+    if (chunk_used + words > chunk_capacity)
+    {
+        const std::size_t capacity = words > kChunkSize / 8 ? words : kChunkSize / 8;
+        chunks.push_back(std::make_unique<std::uint64_t[]>(capacity));
+        chunk_used = 0;
+        chunk_capacity = capacity;
+    }
+    auto* entry = reinterpret_cast<InternedName*>(chunks.back().get() + chunk_used);
+    chunk_used += words;
+    bytes += words * 8;
+    entry->hash = hash;
+    entry->size = static_cast<std::uint32_t>(name.size());
+    entry->kinds = 0;
+    char* chars = reinterpret_cast<char*>(entry + 1);
+    std::memcpy(chars, name.data(), name.size());
+    chars[name.size()] = '\0';
+    return entry;
+}
+
+void SymbolPool::Shard::grow()
+{
+    std::vector<InternedName*> bigger(slots.empty() ? 1024 : slots.size() * 2, nullptr);
+    const std::size_t mask = bigger.size() - 1;
+    for (InternedName* e : slots)
+    {
+        if (e == nullptr)
+        {
+            continue;
+        }
+        std::size_t i = static_cast<std::size_t>(e->hash) & mask;
+        while (bigger[i] != nullptr)
+        {
+            i = (i + 1) & mask;
+        }
+        bigger[i] = e;
+    }
+    slots.swap(bigger);
+}
+
+SymbolHandle SymbolPool::intern(std::string_view name, std::uint64_t hash, SymbolKind kind, bool& first)
+{
+    Shard& shard = shards_[static_cast<std::size_t>(hash >> (64 - kShardBits))];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    if ((shard.count + 1) * 4 > shard.slots.size() * 3)
+    {
+        shard.grow();
+    }
+    const std::size_t mask = shard.slots.size() - 1;
+    std::size_t i = static_cast<std::size_t>(hash) & mask;
+    for (;;)
+    {
+        InternedName* e = shard.slots[i];
+        if (e == nullptr)
+        {
+            e = shard.allocate(name, hash);
+            shard.slots[i] = e;
+            ++shard.count;
+            e->kinds = kind;
+            first = true;
+            return e;
+        }
+        if (e->hash == hash && e->view() == name)
+        {
+            first = (e->kinds & kind) == 0;
+            e->kinds |= kind;
+            return e;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+std::size_t SymbolPool::size() const
+{
+    std::size_t total = 0;
+    for (const Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        total += shard.count;
+    }
+    return total;
+}
+
+std::size_t SymbolPool::bytes() const
+{
+    std::size_t total = 0;
+    for (const Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        total += shard.bytes;
+    }
+    return total;
+}
+
+} // namespace defgen::detail
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "hash.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace defgen::detail
+{
+
+enum SymbolKind : std::uint8_t
+{
+    SymbolFunction = 1,
+    SymbolData = 2
+};
+
+/// A symbol name stored once in a `SymbolPool` arena. The characters (NUL-terminated) follow the header in memory.
+struct InternedName
+{
+    std::uint64_t hash;
+    std::uint32_t size;
+    /// `SymbolKind` bits of the export lists this name has been added to.
+    std::uint8_t kinds;
+
+    [[nodiscard]] const char* c_str() const { return reinterpret_cast<const char*>(this + 1); }
+    [[nodiscard]] std::string_view view() const { return {c_str(), size}; }
+};
+
+/// Compact handle to an interned name; stable for the lifetime of the pool.
+using SymbolHandle = const InternedName*;
+
+/// Concurrent string-interning set: names live in per-shard bump arenas, the hash is computed once by the caller,
+/// and the shard is picked from its top bits so parallel parsers rarely contend.
+class SymbolPool
+{
+  public:
+    SymbolPool() = default;
+    SymbolPool(const SymbolPool&) = delete;
+    SymbolPool& operator=(const SymbolPool&) = delete;
+
+    /// Intern `name` and tag it with `kind`. `first` is true when this call is the first to add `name` as `kind`,
+    /// so callers can collect each (name, kind) exactly once without a second dedupe pass.
+    [[nodiscard]] SymbolHandle intern(std::string_view name, std::uint64_t hash, SymbolKind kind, bool& first);
+
+    [[nodiscard]] std::size_t size() const;
+    /// Arena bytes taken by the interned names.
+    [[nodiscard]] std::size_t bytes() const;
+
+    /// Arena bytes one interned name of `size` characters takes.
+    [[nodiscard]] static constexpr std::size_t entry_bytes(std::size_t size) { return (sizeof(InternedName) + size + 1 + 7) / 8 * 8; }
+
+  private:
+    static constexpr unsigned kShardBits = 6;
+    static constexpr std::size_t kChunkSize = 64 * 1024;
+
+    struct Shard
+    {
+        mutable std::mutex lock;
+        std::vector<InternedName*> slots;
+        std::size_t count = 0;
+        std::size_t bytes = 0;
+        std::vector<std::unique_ptr<std::uint64_t[]>> chunks;
+        std::size_t chunk_used = 0;
+        std::size_t chunk_capacity = 0;
+
+        [[nodiscard]] InternedName* allocate(std::string_view name, std::uint64_t hash);
+        void grow();
+    };
+
+    std::array<Shard, std::size_t{1} << kShardBits> shards_;
+};
+
+/// One symbol as an object contributed it (before cross-object deduplication).
+struct TracedSymbol
+{
+    SymbolHandle name;
+    SymbolKind kind;
+};
+
+/// Per-thread front end of a `SymbolPool`: hashes each name once and keeps the handles it added first.
+/// The union of all collectors' lists is the deduplicated export set.
+struct SymbolCollector
+{
+    explicit SymbolCollector(SymbolPool& p)
+        : pool(&p)
+    {
+    }
+
+    void add(std::string_view name, SymbolKind kind) { add(name, Xxh64::hash(name), kind); }
+
+    void add(std::string_view name, std::uint64_t hash, SymbolKind kind)
+    {
+        bool first = false;
+        const SymbolHandle h = pool->intern(name, hash, kind, first);
+        if (first)
+        {
+            (kind == SymbolFunction ? funcs : data).push_back(h);
+        }
+        if (trace != nullptr)
+        {
+            trace->push_back({h, kind});
+        }
+    }
+
+    SymbolPool* pool;
+    std::vector<SymbolHandle> funcs;
+    std::vector<SymbolHandle> data;
+    /// When set, every symbol added is also appended here (the symbol cache records one object at a time).
+    std::vector<TracedSymbol>* trace = nullptr;
+};
+
+} // namespace defgen::detail
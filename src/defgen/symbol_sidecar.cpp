@@ -0,0 +1,183 @@
+#include "symbol_sidecar.hpp"
+#include "ar_archive.hpp"
+#include "name_sort.hpp"
+#include "object_source.hpp"
+#include "parsers.hpp"
+
+#include <cstring>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+constexpr char kMagic[8] = {'D', 'G', 'S', 'Y', 'M', 'S', 'I', 'D'};
+/// Bump whenever the file layout or what the parsers emit for an object changes.
+constexpr std::uint32_t kVersion = 1;
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t format;
+    std::uint64_t object_size;
+    std::int64_t object_mtime;
+    std::uint32_t function_count;
+    std::uint32_t data_count;
+    std::uint64_t file_size;
+};
+
+static_assert(sizeof(Header) == 48);
+
+/// Decode `count` records starting at `at`; each name must sort strictly after the previous one.
+[[nodiscard]] bool read_run(std::span<const std::uint8_t> bytes, std::size_t& at, std::uint32_t count, std::vector<std::string_view>& out)
+{
+    out.clear();
+    out.reserve(count);
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        std::uint32_t size = 0;
+        if (bytes.size() - at < sizeof(size))
+        {
+            return false;
+        }
+        std::memcpy(&size, bytes.data() + at, sizeof(size));
+        at += sizeof(size);
+        if (size > bytes.size() - at)
+        {
+            return false;
+        }
+        const std::string_view name(reinterpret_cast<const char*>(bytes.data() + at), size);
+        at += size;
+        if (!out.empty() && !(out.back() < name))
+        {
+            return false;
+        }
+        out.push_back(name);
+    }
+    return true;
+}
+
+void append_run(std::vector<SymbolHandle>& names, std::vector<std::uint8_t>& buf)
+{
+    sort_names(names, 1);
+    for (const SymbolHandle h : names)
+    {
+        const std::uint32_t size = h->size;
+        const auto* p = reinterpret_cast<const std::uint8_t*>(&size);
+        buf.insert(buf.end(), p, p + sizeof(size));
+        buf.insert(buf.end(), h->c_str(), h->c_str() + size);
+    }
+}
+
+} // namespace
+
+std::filesystem::path sidecar_path_for(const std::filesystem::path& object)
+{
+    std::filesystem::path p = object;
+    p += ".sym";
+    return p;
+}
+
+bool SymbolSidecar::open(const std::filesystem::path& path, std::string& err)
+{
+    close();
+    {
+        const std::unique_ptr<ObjectSource> file = open_object_source(path, LoadMode::Ranged, err);
+        std::span<const std::uint8_t> content;
+        if (!file || !file->read(0, static_cast<std::size_t>(file->size()), content, err))
+        {
+            return false;
+        }
+        bytes_.assign(content.begin(), content.end());
+    }
+    const std::span<const std::uint8_t> bytes = bytes_;
+    Header header{};
+    if (bytes.size() >= sizeof(Header))
+    {
+        std::memcpy(&header, bytes.data(), sizeof(Header));
+    }
+    std::size_t at = sizeof(Header);
+    if (bytes.size() < sizeof(Header) || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+        header.file_size != bytes.size() || (header.format != static_cast<std::uint32_t>(ObjectFormat::Coff) &&
+                                             header.format != static_cast<std::uint32_t>(ObjectFormat::Elf)) ||
+        !read_run(bytes, at, header.function_count, functions_) || !read_run(bytes, at, header.data_count, data_) || at != bytes.size())
+    {
+        close();
+        err = "invalid symbol sidecar " + path_key(path);
+        return false;
+    }
+    format_ = static_cast<ObjectFormat>(header.format);
+    object_.size = header.object_size;
+    object_.mtime = header.object_mtime;
+    return true;
+}
+
+void SymbolSidecar::close()
+{
+    functions_.clear();
+    data_.clear();
+    bytes_.clear();
+}
+
+} // namespace defgen::detail
+
+namespace defgen
+{
+
+Errc extract_symbol_sidecar(const std::filesystem::path& object, ObjectFormat format, const std::filesystem::path& sidecar,
+                            std::string& message)
+{
+    const ObjectFormat fmt = detail::resolve_object_format(object, format);
+    detail::FileIdentity before;
+    if (!detail::stat_file_identity(object, before))
+    {
+        message = "cannot open " + detail::path_key(object);
+        return Errc::Io;
+    }
+    if (detail::ar::is_thin_archive_file(object))
+    {
+        message = detail::path_key(object) + ": thin archive members are separate files; a sidecar could not track them";
+        return Errc::InvalidArgument;
+    }
+    detail::SymbolPool pool;
+    detail::SymbolCollector collector(pool);
+    {
+        const std::unique_ptr<detail::ObjectSource> source = detail::open_object_source(object, LoadMode::Mapped, message);
+        if (!source || detail::parse_object(object, fmt, *source, collector, message) != 0)
+        {
+            return Errc::Parse;
+        }
+    }
+    // The sidecar vouches for this size and mtime, so the object must not have changed while it was parsed.
+    detail::FileIdentity after;
+    if (!detail::stat_file_identity(object, after) || after != before)
+    {
+        message = detail::path_key(object) + " changed while it was read";
+        return Errc::Io;
+    }
+
+    std::vector<std::uint8_t> buf(sizeof(detail::Header), 0);
+    detail::append_run(collector.funcs, buf);
+    detail::append_run(collector.data, buf);
+    detail::Header header{};
+    std::memcpy(header.magic, detail::kMagic, sizeof(detail::kMagic));
+    header.version = detail::kVersion;
+    header.format = static_cast<std::uint32_t>(fmt);
+    header.object_size = before.size;
+    header.object_mtime = before.mtime;
+    header.function_count = static_cast<std::uint32_t>(collector.funcs.size());
+    header.data_count = static_cast<std::uint32_t>(collector.data.size());
+    header.file_size = buf.size();
+    std::memcpy(buf.data(), &header, sizeof(header));
+
+    const std::filesystem::path out = sidecar.empty() ? detail::sidecar_path_for(object) : sidecar;
+    if (!detail::write_file_atomic(out, buf.data(), buf.size(), message))
+    {
+        return Errc::Io;
+    }
+    return Errc::Ok;
+}
+
+} // namespace defgen
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "defgen/defgen.hpp"
+#include "file_util.hpp"
+#include "symbol_pool.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// `<object>.sym`: where `extract_symbol_sidecar` writes an object's sidecar by default and where `generate_def`
+/// looks for it.
+[[nodiscard]] std::filesystem::path sidecar_path_for(const std::filesystem::path& object);
+
+/// Read side of a `.sym` sidecar: a header (format, size and mtime of the object it was extracted from) followed by the
+/// object's function names and data names, each run sorted byte-wise without duplicates, as `u32 length + bytes`
+/// records. Native byte order. Sidecars are small, so the whole file is copied into memory with one positioned read
+/// (cheaper than a mapping, and no handle stays open) and the names are views into that copy.
+class SymbolSidecar
+{
+  public:
+    /// Read and validate `path` (bounds, order and uniqueness of both runs). False with `err` if it is not a sidecar.
+    [[nodiscard]] bool open(const std::filesystem::path& path, std::string& err);
+    void close();
+
+    [[nodiscard]] ObjectFormat format() const { return format_; }
+    /// The object as it was when the sidecar was written; a different size or mtime now means the sidecar is stale.
+    [[nodiscard]] const FileIdentity& object_identity() const { return object_; }
+
+    [[nodiscard]] const std::vector<std::string_view>& names(SymbolKind kind) const
+    {
+        return kind == SymbolFunction ? functions_ : data_;
+    }
+
+  private:
+    std::vector<std::uint8_t> bytes_;
+    ObjectFormat format_ = ObjectFormat::Coff;
+    FileIdentity object_;
+    std::vector<std::string_view> functions_;
+    std::vector<std::string_view> data_;
+};
+
+} // namespace defgen::detail
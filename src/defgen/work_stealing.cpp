@@ -0,0 +1,119 @@
+#include "work_stealing.hpp"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace defgen::detail
+{
+
+namespace
+{
+
+struct WorkerQueue
+{
+    std::mutex lock;
+    std::deque<std::size_t> items;
+
+    [[nodiscard]] bool pop_front(std::size_t& item)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (items.empty())
+        {
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+
+    [[nodiscard]] bool steal_back(std::size_t& item)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (items.empty())
+        {
+            return false;
+        }
+        item = items.back();
+        items.pop_back();
+        return true;
+    }
+};
+
+} // namespace
+
+unsigned resolve_thread_count(unsigned requested)
+{
+    if (requested != 0)
+    {
+        return requested;
+    }
+    const unsigned hw = std::thread::hardware_concurrency();
+    return hw == 0 ? 1 : hw;
+}
+
+void run_work_stealing(const std::vector<std::size_t>& order, unsigned threads,
+                       const std::function<void(unsigned worker, std::size_t item)>& task)
+{
+    if (threads > order.size())
+    {
+        threads = static_cast<unsigned>(order.size());
+    }
+    if (threads <= 1)
+    {
+        for (const std::size_t item : order)
+        {
+            task(0, item);
+        }
+        return;
+    }
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    queues.reserve(threads);
+    for (unsigned w = 0; w < threads; w++)
+    {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (std::size_t i = 0; i < order.size(); i++)
+    {
+        queues[i % threads]->items.push_back(order[i]);
+    }
+
+    // Nothing is ever added after start-up, so a worker that finds every deque empty is done.
+    const auto worker_main = [&](unsigned self) {
+        std::size_t item = 0;
+        for (;;)
+        {
+            if (queues[self]->pop_front(item))
+            {
+                task(self, item);
+                continue;
+            }
+            bool stole = false;
+            for (unsigned k = 1; k < threads && !stole; k++)
+            {
+                stole = queues[(self + k) % threads]->steal_back(item);
+            }
+            if (!stole)
+            {
+                return;
+            }
+            task(self, item);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned w = 1; w < threads; w++)
+    {
+        pool.emplace_back(worker_main, w);
+    }
+    worker_main(0);
+    for (std::thread& t : pool)
+    {
+        t.join();
+    }
+}
+
+} // namespace defgen::detail
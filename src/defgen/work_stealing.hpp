@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace defgen::detail
+{
+
+/// `requested` threads, or the hardware concurrency when 0 (at least 1).
+[[nodiscard]] unsigned resolve_thread_count(unsigned requested);
+
+/// Run `task(worker, item)` for every item in `order` on `threads` workers (the caller is worker 0).
+/// Items are dealt round-robin in `order` to per-worker deques, so each worker starts with the front of the list
+/// (put the most expensive items first). An idle worker steals from the back of another worker's deque.
+void run_work_stealing(const std::vector<std::size_t>& order, unsigned threads,
+                       const std::function<void(unsigned worker, std::size_t item)>& task);
+
+} // namespace defgen::detail
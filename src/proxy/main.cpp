@@ -9,6 +9,8 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdio>
+#include <cwchar>
+#include <cwctype>
 #include <filesystem>
 #include <fstream>
 #include <string>
@@ -24,6 +26,37 @@ constexpr int kMaxCmdLine = 32768;
 /// Full path to the real `link.exe`. When set, `/lorig:` is optional.
 constexpr wchar_t kEnvOriginalLinker[] = L"LINK_EXPORT_ALL_LINKER";
 
+/// Opt-in resident server: `1` for the default pipe, otherwise the pipe name of a running `defgend`.
+constexpr wchar_t kEnvDaemon[] = L"LINK_EXPORT_ALL_DAEMON";
+
+/// Opt-in content-addressed symbol store shared by several machines (a directory, typically on a network share), and
+/// its size bound in MiB (unbounded when unset).
+constexpr wchar_t kEnvSharedCache[] = L"LINK_EXPORT_ALL_SHARED_CACHE";
+constexpr wchar_t kEnvSharedCacheMb[] = L"LINK_EXPORT_ALL_SHARED_CACHE_MB";
+
+/// `1`: load objects with positioned reads of just their headers and tables (`LoadMode::Ranged`) instead of mapping
+/// them, for objects on network shares.
+constexpr wchar_t kEnvRanged[] = L"LINK_EXPORT_ALL_RANGED";
+
+/// `1`: decide "def unchanged" by comparing the whole file instead of its `ExportHash` header line.
+constexpr wchar_t kEnvVerifyDef[] = L"LINK_EXPORT_ALL_VERIFY_DEF";
+
+/// `1`: export by stable ordinal (`name @N NONAME`), numbered through `<def>.ordinals`; names listed in
+/// `DefNamedExports.txt` keep their export name.
+constexpr wchar_t kEnvOrdinals[] = L"LINK_EXPORT_ALL_ORDINALS";
+
+/// `1`: build the export table into `<def>.exp` and link that instead of passing `/DEF:`. The linker writes no import
+/// library then, so the proxy writes it from the `.def` as well (`/IMPLIB:`, else `<out>.lib`).
+constexpr wchar_t kEnvExportObject[] = L"LINK_EXPORT_ALL_EXP";
+
+/// `1`: write the import library from the `.def` before the linker runs, so DLLs that import from this one need not
+/// wait for its link; the linker's own import library goes to `<lib>.link.lib`.
+constexpr wchar_t kEnvImportLibrary[] = L"LINK_EXPORT_ALL_IMPLIB";
+
+/// `1`: keep `<def>.fingerprint`, a hash of the exported interface whose mtime moves only when the interface does, for
+/// build systems that relink importers on it (Ninja `restat`, MSBuild inputs) instead of on the DLL.
+constexpr wchar_t kEnvFingerprint[] = L"LINK_EXPORT_ALL_FINGERPRINT";
+
 void trim_surrounding_ws_and_quotes(std::wstring& s)
 {
     while (!s.empty() && (s.front() == L' ' || s.front() == L'\t'))
@@ -40,10 +73,10 @@ void trim_surrounding_ws_and_quotes(std::wstring& s)
     }
 }
 
-[[nodiscard]] std::wstring read_original_linker_from_env()
+[[nodiscard]] std::wstring read_env(const wchar_t* name)
 {
     wchar_t buf[kMaxCmdLine]{};
-    const DWORD n = GetEnvironmentVariableW(kEnvOriginalLinker, buf, static_cast<DWORD>(std::size(buf)));
+    const DWORD n = GetEnvironmentVariableW(name, buf, static_cast<DWORD>(std::size(buf)));
     if (n == 0 || n >= std::size(buf))
     {
         return {};
@@ -53,6 +86,8 @@ void trim_surrounding_ws_and_quotes(std::wstring& s)
     return s;
 }
 
+[[nodiscard]] std::wstring read_original_linker_from_env() { return read_env(kEnvOriginalLinker); }
+
 /// Prefer `/lorig:` from the command line; otherwise `LINK_EXPORT_ALL_LINKER`.
 [[nodiscard]] std::wstring resolve_original_linker_path(const std::wstring& from_cmdline)
 {
@@ -67,6 +102,20 @@ bool verbose_out = false;
 
 bool is_quote(wchar_t c) { return c == L'\"'; }
 
+/// True if `param` starts with `option` (given in upper case) in any case: CMake writes `/out:`, `/implib:` and
+/// `/machine:x64`, and `link.exe` takes them as `/OUT:`, `/IMPLIB:` and `/MACHINE:X64`.
+[[nodiscard]] bool has_option(const wchar_t* param, const wchar_t* option)
+{
+    for (; *option != L'\0'; ++param, ++option)
+    {
+        if (static_cast<wchar_t>(std::towupper(static_cast<wint_t>(*param))) != *option)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 struct ImportantParams
 {
     std::vector<std::wstring> obj_list;
@@ -74,6 +123,9 @@ struct ImportantParams
     std::wstring def_name;
     std::wstring linker_path;
     std::wstring obj_list_path;
+    std::wstring out_name;
+    std::wstring implib_name;
+    std::wstring machine;
     bool has_def = false;
     bool has_emd = false;
     bool gen_obj_list = false;
@@ -94,6 +146,9 @@ enum class PrmKind
     ObjListFile = 9,
     OFile = 10,
     EmdFile = 11,
+    ExportLib = 12,
+    Out = 13,
+    Machine = 14,
 };
 
 [[nodiscard]] PrmKind classify_param(const wchar_t* raw_param)
@@ -123,6 +178,10 @@ enum class PrmKind
             {
                 return PrmKind::Defgen;
             }
+            if (n > 8 && wcsncmp(&param[4], L"LIB:", 4) == 0)
+            {
+                return PrmKind::ExportLib;
+            }
         }
         if (wcsncmp(&param[1], L"lorig:", 6) == 0)
         {
@@ -132,10 +191,18 @@ enum class PrmKind
         {
             return PrmKind::GenerateObjectList;
         }
-        if (wcsncmp(&param[1], L"IMPLIB:", 7) == 0)
+        if (has_option(&param[1], L"IMPLIB:"))
         {
             return PrmKind::Implib;
         }
+        if (has_option(&param[1], L"OUT:"))
+        {
+            return PrmKind::Out;
+        }
+        if (has_option(&param[1], L"MACHINE:"))
+        {
+            return PrmKind::Machine;
+        }
     }
     else
     {
@@ -225,6 +292,8 @@ void extract_important_params(std::vector<std::wstring>& command_line_params, Im
             const int start_pos = (param.size() > 8 && param[8] == L'\"') ? 9 : 8;
             prm.obj_list_path = param.substr(static_cast<size_t>(start_pos));
             has_obj_path = true;
+            prm.implib_name = param.substr(8);
+            prm.implib_name.erase(std::remove_if(prm.implib_name.begin(), prm.implib_name.end(), is_quote), prm.implib_name.end());
         }
         break;
 
@@ -250,6 +319,29 @@ void extract_important_params(std::vector<std::wstring>& command_line_params, Im
         }
         break;
 
+        case PrmKind::ExportLib:
+        {
+            // `/DEFLIB:<lib>`: export the library's public symbols too, and hand it to the linker as a plain input.
+            // Other libraries on the command line (CRT, system, import libraries) are linked but never exported from.
+            // A quoted path (response file lines keep their quotes) is forwarded quoted, so one with spaces stays one input.
+            std::wstring cleaned = param;
+            cleaned.erase(std::remove(cleaned.begin(), cleaned.end(), L'\"'), cleaned.end());
+            cleaned.erase(0, 8);
+            prm.obj_list.push_back(cleaned);
+            *it = param.find(L'\"') != std::wstring::npos ? L"\"" + cleaned + L"\"" : std::move(cleaned);
+        }
+        break;
+
+        case PrmKind::Out:
+            prm.out_name = param.substr(5);
+            prm.out_name.erase(std::remove_if(prm.out_name.begin(), prm.out_name.end(), is_quote), prm.out_name.end());
+            break;
+
+        case PrmKind::Machine:
+            prm.machine = param.substr(9);
+            prm.machine.erase(std::remove_if(prm.machine.begin(), prm.machine.end(), is_quote), prm.machine.end());
+            break;
+
         case PrmKind::ObjListFile:
         {
             std::wstring cleaned = param;
@@ -447,9 +539,10 @@ void parse_response_file_ansi(const char* rsp_text, DWORD chars_count, std::vect
     return parse_response_file_buffer(buf.data(), read_bytes, lines, is_ansi);
 }
 
-void load_def_build_ignores(defgen::GenerateOptions& opt)
+/// Non-empty lines of `path` in the current working directory; nothing when it does not exist.
+void load_name_list(const char* path, std::vector<std::string>& out)
 {
-    std::ifstream f("DefBuildIgnores.txt");
+    std::ifstream f(path);
     if (!f)
     {
         return;
@@ -463,11 +556,13 @@ void load_def_build_ignores(defgen::GenerateOptions& opt)
         }
         if (!line.empty())
         {
-            opt.ignore_substrings.push_back(line);
+            out.push_back(line);
         }
     }
 }
 
+void load_def_build_ignores(defgen::GenerateOptions& opt) { load_name_list("DefBuildIgnores.txt", opt.ignore_substrings); }
+
 [[nodiscard]] std::vector<fs::path> to_paths(const std::vector<std::wstring>& w)
 {
     std::vector<fs::path> out;
@@ -479,51 +574,28 @@ void load_def_build_ignores(defgen::GenerateOptions& opt)
     return out;
 }
 
-[[nodiscard]] bool should_regenerate_def(const fs::path& def_path, std::string_view object_count_line,
-                                         const std::vector<std::wstring>& obj_wpaths)
+void write_manifest(const fs::path& manifest_path, const defgen::InputManifest& manifest)
 {
-    if (!fs::exists(def_path))
-    {
-        return true;
-    }
-    if (!defgen::def_first_line_is(def_path, object_count_line))
+    std::string err;
+    if (!defgen::write_input_manifest(manifest_path, manifest, err))
     {
-        return true;
+        std::printf("DEFGEN: Warning: %s\n", err.c_str());
     }
-    const auto def_time = fs::last_write_time(def_path);
-    for (const auto& w : obj_wpaths)
-    {
-        const fs::path p(w);
-        std::error_code ec;
-        if (!fs::exists(p, ec))
-        {
-            std::printf("Warning: can't stat object file '%ls'\n", w.c_str());
-            return true;
-        }
-        const auto t = fs::last_write_time(p, ec);
-        if (ec)
-        {
-            return true;
-        }
-        if (t > def_time)
-        {
-            return true;
-        }
-    }
-    return false;
 }
 
-[[nodiscard]] int write_def_lines(const fs::path& def_path, const std::vector<std::string>& lines)
+[[nodiscard]] int write_def_lines(const fs::path& def_path, const std::vector<std::string>& lines, defgen::ExportCompare compare)
 {
-    std::ofstream out(def_path, std::ios::binary);
-    if (!out)
+    defgen::ExportFileWriter writer(def_path, compare);
+    for (const auto& line : lines)
     {
-        std::printf("Can't create def file '%ls'\n", def_path.c_str());
-        return -1;
+        writer.line(line);
     }
-    for (const auto& line : lines)
+    bool unchanged = false;
+    std::string err;
+    if (!writer.commit(unchanged, err))
     {
-        out << line << '\n';
+        std::printf("Can't create def file '%ls' (%s)\n", def_path.c_str(), err.c_str());
+        return -1;
     }
     return 0;
 }
@@ -543,12 +615,6 @@ void load_def_build_ignores(defgen::GenerateOptions& opt)
     }
     const std::string object_count_line(obj_count_buf);
 
-    if (!should_regenerate_def(def_path, object_count_line, obj_wpaths))
-    {
-        std::printf("DEFGEN: Skip def file update\n");
-        return 0;
-    }
-
     defgen::GenerateOptions opt;
     load_def_build_ignores(opt);
     opt.elf_style_export_block = use_elf_style;
@@ -560,25 +626,256 @@ void load_def_build_ignores(defgen::GenerateOptions& opt)
         }
     }
     opt.object_count_line = object_count_line;
+    opt.export_hash_in_header = true;
+    opt.symbol_cache_path = def_path;
+    opt.symbol_cache_path += ".symcache";
+    opt.use_symbol_sidecars = true;
+    opt.shared_cache_dir = read_env(kEnvSharedCache);
+    opt.shared_cache_max_bytes = std::wcstoull(read_env(kEnvSharedCacheMb).c_str(), nullptr, 10) << 20;
+    if (read_env(kEnvRanged) == L"1")
+    {
+        opt.load_mode = defgen::LoadMode::Ranged;
+    }
+    if (!use_elf_style && read_env(kEnvOrdinals) == L"1")
+    {
+        opt.ordinal_database = def_path;
+        opt.ordinal_database += ".ordinals";
+        load_name_list("DefNamedExports.txt", opt.named_exports);
+    }
+
+    // The header line carries a hash of the export set, so an up-to-date file is recognized by its first line.
+    const defgen::ExportCompare compare = read_env(kEnvVerifyDef) == L"1" ? defgen::ExportCompare::Full : defgen::ExportCompare::Header;
 
     const auto obj_paths = to_paths(obj_wpaths);
     const defgen::ObjectFormat fmt = use_elf_style ? defgen::ObjectFormat::Elf : defgen::ObjectFormat::Coff;
 
-    const defgen::GenerateResult gr = defgen::generate_def(obj_paths, fmt, opt);
+    const std::wstring daemon = read_env(kEnvDaemon);
+    if (!daemon.empty())
+    {
+        const fs::path endpoint = daemon == L"1" ? defgen::default_daemon_endpoint() : fs::path(daemon);
+        const defgen::DaemonResult dr =
+            defgen::query_daemon(endpoint, obj_paths, fmt, opt, compare == defgen::ExportCompare::Full ? fs::path() : def_path);
+        if (dr.ec == defgen::Errc::Ok)
+        {
+            std::printf("DEFGEN: Daemon: %zu resident, %zu parsed\n", dr.objects_resident, dr.objects_parsed);
+            if (dr.unchanged)
+            {
+                std::printf("DEFGEN: No new exports (def unchanged)\n");
+                return 0;
+            }
+            std::printf("DEFGEN: Write to DEF\n");
+            return write_def_lines(def_path, dr.out.lines, compare);
+        }
+        if (dr.ec != defgen::Errc::Io)
+        {
+            std::printf("DEFGEN: %s\n", dr.message.c_str());
+            return -800;
+        }
+        std::printf("DEFGEN: Daemon unavailable (%s), generating locally\n", dr.message.c_str());
+    }
+
+    // The manifest records the input set and each object's content hash, so swapped objects are caught and touched ones
+    // are not; only a real input or settings change regenerates.
+    fs::path manifest_path = def_path;
+    manifest_path += ".manifest";
+    const defgen::ManifestCheck check = defgen::check_input_manifest(manifest_path, obj_paths, defgen::manifest_settings_hash(fmt, opt));
+    // A deleted ordinal database must be rebuilt (renumbering everything) even when the objects did not change.
+    std::error_code exists_ec;
+    if (check.unchanged && fs::exists(def_path, exists_ec) && (opt.ordinal_database.empty() || fs::exists(opt.ordinal_database, exists_ec)))
+    {
+        if (check.stale)
+        {
+            write_manifest(manifest_path, check.current);
+        }
+        std::printf("DEFGEN: Skip def file update\n");
+        return 0;
+    }
+    if (!check.reason.empty())
+    {
+        std::printf("DEFGEN: Regenerate (%s)\n", check.reason.c_str());
+    }
+
+    // The text streams straight into the new file (compared against the old one on the way), never held as lines.
+    defgen::ExportFileWriter writer(def_path, compare);
+    const defgen::GenerateResult gr = defgen::generate_def(obj_paths, fmt, opt, writer);
     if (gr.ec != defgen::Errc::Ok)
     {
         std::printf("DEFGEN: %s\n", gr.message.c_str());
         return -800;
     }
+    std::printf("DEFGEN: Symbol cache: %zu hit(s), %zu content hit(s), %zu miss(es); %zu sidecar(s)\n", gr.stats.cache_hits,
+                gr.stats.cache_content_hits, gr.stats.cache_misses, gr.stats.sidecar_hits);
+    std::printf("DEFGEN: Read %llu of %llu object byte(s)\n", static_cast<unsigned long long>(gr.stats.total_bytes_read),
+                static_cast<unsigned long long>(gr.stats.total_file_size));
+    if (!opt.shared_cache_dir.empty())
+    {
+        const std::size_t lookups = gr.stats.shared_cache_hits + gr.stats.cache_misses;
+        std::printf("DEFGEN: Shared cache: %zu of %zu hit (%.0f%%), %zu published, %zu evicted\n", gr.stats.shared_cache_hits, lookups,
+                    lookups == 0 ? 100.0 : 100.0 * static_cast<double>(gr.stats.shared_cache_hits) / static_cast<double>(lookups),
+                    gr.stats.shared_cache_writes, gr.stats.shared_cache_evictions);
+    }
+    if (!gr.stats.cache_error.empty())
+    {
+        std::printf("DEFGEN: Warning: %s\n", gr.stats.cache_error.c_str());
+    }
+    if (gr.stats.ordinals_added != 0)
+    {
+        std::printf("DEFGEN: %zu new ordinal(s) assigned\n", gr.stats.ordinals_added);
+    }
 
-    if (defgen::def_file_matches(def_path, gr.out.lines))
+    bool unchanged = false;
+    std::string err;
+    if (!writer.commit(unchanged, err))
     {
-        std::printf("DEFGEN: No new exports (def unchanged)\n");
-        return 0;
+        std::printf("Can't create def file '%ls' (%s)\n", def_path.c_str(), err.c_str());
+        return -1;
     }
+    std::printf(unchanged ? "DEFGEN: No new exports (def unchanged)\n" : "DEFGEN: Write to DEF\n");
+    write_manifest(manifest_path, check.current);
+    return 0;
+}
 
-    std::printf("DEFGEN: Write to DEF\n");
-    return write_def_lines(def_path, gr.out.lines);
+/// Machine and DLL name for the files built from the `.def`, as the linker will see them: the machine of the input
+/// objects (`inputs`, else `/MACHINE:`) and the `/OUT:` file. False, with the reason in `guess`, when either is only a guess;
+/// `options` then holds the guess (AMD64, the first input with `.dll`).
+[[nodiscard]] bool export_object_options(const ImportantParams& prms, const defgen::CoffLinkInputs& inputs,
+                                         defgen::ExportObjectOptions& options, std::string& guess)
+{
+    options.machine = inputs.machine;
+    if (options.machine == 0)
+    {
+        std::wstring machine = prms.machine;
+        std::transform(machine.begin(), machine.end(), machine.begin(),
+                       [](wchar_t c) { return static_cast<wchar_t>(std::towupper(static_cast<wint_t>(c))); });
+        if (machine == L"X86")
+        {
+            options.machine = 0x014c;
+        }
+        else if (machine == L"ARM64")
+        {
+            options.machine = 0xAA64;
+        }
+        else
+        {
+            options.machine = 0x8664;
+            if (machine != L"X64")
+            {
+                guess = "machine unknown (no COFF object or /MACHINE:)";
+            }
+        }
+    }
+    fs::path dll = prms.out_name;
+    if (dll.empty())
+    {
+        if (!prms.obj_list.empty())
+        {
+            dll = fs::path(prms.obj_list.front()).filename().replace_extension(L".dll");
+        }
+        guess = "DLL name unknown (no /OUT:)";
+    }
+    options.dll_name = dll.filename().string();
+    return guess.empty();
+}
+
+/// Where `link.exe` would write the import library: `/IMPLIB:`, else the `/OUT:` file with `.lib`.
+[[nodiscard]] fs::path import_library_path(const ImportantParams& prms)
+{
+    if (!prms.implib_name.empty())
+    {
+        return prms.implib_name;
+    }
+    return fs::path(prms.out_name).replace_extension(L".lib");
+}
+
+/// Build `exp_path` from the current `.def` (see `kEnvExportObject`). False when it cannot be built; the link then
+/// gets the `.def` as usual.
+[[nodiscard]] bool write_export_object_file(const fs::path& def_path, const fs::path& exp_path,
+                                            const defgen::ExportObjectOptions& options)
+{
+    bool unchanged = false;
+    std::string err;
+    if (defgen::write_export_object(def_path, exp_path, options, unchanged, err) != defgen::Errc::Ok)
+    {
+        std::printf("DEFGEN: Warning: no export object (%s), linking with the def file\n", err.c_str());
+        return false;
+    }
+    std::printf(unchanged ? "DEFGEN: Export object unchanged\n" : "DEFGEN: Write export object\n");
+    return true;
+}
+
+/// Build `lib_path` from the current `.def` (see `kEnvImportLibrary`). False when it cannot be built; the linker then
+/// writes the import library as usual.
+[[nodiscard]] bool write_import_library_file(const fs::path& def_path, const fs::path& lib_path,
+                                             const defgen::ExportObjectOptions& options)
+{
+    bool unchanged = false;
+    std::string err;
+    if (defgen::write_import_library(def_path, lib_path, options, unchanged, err) != defgen::Errc::Ok)
+    {
+        std::printf("DEFGEN: Warning: no import library (%s), left to the linker\n", err.c_str());
+        return false;
+    }
+    std::printf(unchanged ? "DEFGEN: Import library unchanged\n" : "DEFGEN: Write import library\n");
+    return true;
+}
+
+/// Bring `<def>.fingerprint` in line with the current export file (see `kEnvFingerprint`) and report the relinks it
+/// spared. Failure only costs the importers a relink, so it is a warning.
+void write_fingerprint_file(const fs::path& def_path, const ImportantParams& prms, bool use_elf_style)
+{
+    fs::path fingerprint_path = def_path;
+    fingerprint_path += ".fingerprint";
+    std::string target;
+    if (use_elf_style)
+    {
+        target = "elf " + def_path.stem().string();
+    }
+    else
+    {
+        // A guessed target still identifies the interface; it only has to be stable between runs.
+        defgen::ExportObjectOptions options;
+        std::string guess;
+        (void)export_object_options(prms, defgen::inspect_coff_inputs(to_paths(prms.obj_list), false), options, guess);
+        char machine[8] = {};
+        std::snprintf(machine, sizeof(machine), "%04x", options.machine);
+        target = "coff " + std::string(machine) + ' ' + options.dll_name;
+    }
+    bool unchanged = false;
+    defgen::FingerprintStats stats;
+    std::string err;
+    if (defgen::write_interface_fingerprint(def_path, use_elf_style ? defgen::ObjectFormat::Elf : defgen::ObjectFormat::Coff,
+                                            fingerprint_path, target, unchanged, stats, err) != defgen::Errc::Ok)
+    {
+        std::printf("DEFGEN: Warning: no interface fingerprint (%s)\n", err.c_str());
+        return;
+    }
+    std::printf(unchanged ? "DEFGEN: Interface unchanged, importers need no relink (%llu relink(s) avoided, %llu update(s))\n"
+                          : "DEFGEN: Interface changed, write fingerprint (%llu relink(s) avoided, %llu update(s))\n",
+                static_cast<unsigned long long>(stats.relinks_avoided), static_cast<unsigned long long>(stats.updates));
+}
+
+/// Point every `/IMPLIB:` in `params` at `lib_path` (quoted for response file lines).
+void redirect_import_library(std::vector<std::wstring>& params, const fs::path& lib_path, bool quote)
+{
+    for (std::wstring& param : params)
+    {
+        if (classify_param(param.c_str()) == PrmKind::Implib)
+        {
+            param = quote ? L"/IMPLIB:\"" + lib_path.wstring() + L"\"" : L"/IMPLIB:" + lib_path.wstring();
+        }
+    }
+}
+
+/// Hand the linker `exp_path` in place of every `/DEF:` in `params` (quoted for response file lines).
+void replace_def_with_export_object(std::vector<std::wstring>& params, const fs::path& exp_path, bool quote)
+{
+    for (std::wstring& param : params)
+    {
+        if (classify_param(param.c_str()) == PrmKind::DefFile)
+        {
+            param = quote ? L"\"" + exp_path.wstring() + L"\"" : exp_path.wstring();
+        }
+    }
 }
 
 void join_lines_mbs(const std::vector<std::wstring>& lines, std::vector<std::byte>& content)
@@ -758,6 +1055,61 @@ int wmain(int argc, wchar_t* argv[])
         {
             std::printf("DEFGEN: failed (%d)\n", err);
         }
+        else if (read_env(kEnvFingerprint) == L"1")
+        {
+            write_fingerprint_file(def_path, prms, prms.has_emd);
+        }
+        if (err == 0 && prms.has_def)
+        {
+            const bool export_object = read_env(kEnvExportObject) == L"1";
+            const bool early_library = read_env(kEnvImportLibrary) == L"1" && !prms.implib_name.empty();
+            if (read_env(kEnvImportLibrary) == L"1" && prms.implib_name.empty() && !export_object)
+            {
+                std::printf("DEFGEN: No /IMPLIB:, import library left to the linker\n");
+            }
+            // The import library is complete once the `.def` is: publish it now. `link.exe` writes none when it gets
+            // the `.exp`, so EXP mode needs it too; if it cannot be written, the `.def` stays and the linker writes it.
+            defgen::ExportObjectOptions options;
+            std::string guess;
+            bool library_written = false;
+            if (early_library || export_object)
+            {
+                const defgen::CoffLinkInputs inputs = defgen::inspect_coff_inputs(to_paths(prms.obj_list), true);
+                if (inputs.export_directives)
+                {
+                    // The `.def` does not carry those exports (nor their `DATA` type), so files built from it alone
+                    // would miss or mistype them.
+                    std::printf("DEFGEN: Objects pass /EXPORT:, export object and import library left to the linker\n");
+                }
+                else if (!export_object_options(prms, inputs, options, guess))
+                {
+                    // Files naming the wrong DLL or machine would break every importer; leave both to the linker.
+                    std::printf("DEFGEN: Warning: %s, export object and import library left to the linker\n", guess.c_str());
+                }
+                else
+                {
+                    library_written = write_import_library_file(def_path, import_library_path(prms), options);
+                }
+            }
+            if (library_written && early_library)
+            {
+                // Keep the linker from replacing it (and its timestamp) with its own copy.
+                fs::path link_lib = prms.implib_name;
+                link_lib += ".link.lib";
+                redirect_import_library(cmd_line_params, link_lib, false);
+                redirect_import_library(response_params, link_lib, true);
+            }
+            if (library_written && export_object)
+            {
+                fs::path exp_path = def_path;
+                exp_path += ".exp";
+                if (write_export_object_file(def_path, exp_path, options))
+                {
+                    replace_def_with_export_object(cmd_line_params, exp_path, false);
+                    replace_def_with_export_object(response_params, exp_path, true);
+                }
+            }
+        }
         const auto sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
         std::printf("DefGen time %3.2f sec\n", sec);
     }
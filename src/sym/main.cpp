@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: MIT
+// Symbol sidecar extractor: run right after each compile to write `<object>.sym`, the object's export candidates in
+// sorted form. A link with sidecars then merges these small files instead of opening and parsing every object.
+
+#include "defgen/defgen.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+void print_usage()
+{
+    std::printf("usage:\n"
+                "  defgen-sym [--elf] <objects>...          writes <object>.sym next to each object\n"
+                "  defgen-sym [--elf] -o <out.sym> <object>\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    defgen::ObjectFormat format = defgen::ObjectFormat::Auto;
+    fs::path out_path;
+    std::vector<fs::path> objects;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (std::strcmp(arg, "-o") == 0 && i + 1 < argc)
+        {
+            out_path = argv[++i];
+        }
+        else if (std::strcmp(arg, "--elf") == 0)
+        {
+            format = defgen::ObjectFormat::Elf;
+        }
+        else if (arg[0] == '-')
+        {
+            print_usage();
+            return 2;
+        }
+        else
+        {
+            objects.emplace_back(arg);
+        }
+    }
+    if (objects.empty() || (!out_path.empty() && objects.size() != 1))
+    {
+        print_usage();
+        return 2;
+    }
+
+    for (const fs::path& object : objects)
+    {
+        std::string message;
+        if (defgen::extract_symbol_sidecar(object, format, out_path, message) != defgen::Errc::Ok)
+        {
+            std::printf("defgen-sym: %s\n", message.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}